@@ -1,75 +1,432 @@
+#include <limits>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <algorithm>
+#define KAGUYA_DEFINE_COUNTING_OPERATOR_NEW
 #include "kaguya/kaguya.hpp"
 
 #include "benchmark_function.hpp"
 
+using benchmark_harness::Run;
+using kaguya::AllocationCount;
 
-
-typedef void(*benchmark_function_t)(kaguya::State&);
-typedef std::vector<std::pair<std::string, benchmark_function_t> > benchmark_function_map_t;
-void empty(kaguya::State&)
+namespace
 {
+	struct Scenario
+	{
+		Scenario(const std::string& g, const std::string& n, benchmark_harness::scenario_function_t f, size_t i) :group(g), name(n), function(f), iterations(i) {}
+		std::string group;
+		std::string name;
+		benchmark_harness::scenario_function_t function;
+		size_t iterations;//!< default number of operations of one repetition
 
-}
+		std::string fullname()const { return group + "/" + name; }
+	};
+	typedef std::vector<Scenario> scenario_list_t;
 
-void execute_benchmark(const benchmark_function_map_t& testmap)
-{
-	for (benchmark_function_map_t::const_iterator it = testmap.begin(); it != testmap.end(); ++it)
+	struct Options
 	{
-		const std::string& test_name = it->first;
+		Options() :format("text"), repetitions(10), iterations_scale(1.0), list(false) {}
+		std::vector<std::string> filters;
+		std::string format;
+		int repetitions;
+		double iterations_scale;
+		bool list;
+		std::string output;
+	};
 
+	struct Result
+	{
+		Result() :iterations(0), failed(false), min(0), p50(0), p90(0), max(0), mean(0), stddev(0), setup_ms(0), cxx_allocs(0), lua_allocs(0), lua_bytes(0) {}
+		std::string name;
+		size_t iterations;
+		bool failed;
+		std::string error;
+		//ns/op across repetitions
+		double min;
+		double p50;
+		double p90;
+		double max;
+		double mean;
+		double stddev;
+		double setup_ms;
+		//per op in fastest repetition
+		double cxx_allocs;
+		double lua_allocs;
+		double lua_bytes;
+		std::map<std::string, double> counters;
+	};
 
-		double mintime = std::numeric_limits<double>::max();
+	bool scenario_failed = false;
+	std::string scenario_error;
+	void record_error(int status, const char* message)
+	{
+		if (!scenario_failed)
+		{
+			scenario_error = message ? message : "";
+		}
+		scenario_failed = true;
+	}
 
-		kaguya::State clockstate;
+	double percentile(const std::vector<double>& sorted, double p)
+	{
+		size_t index = std::min(size_t(p * sorted.size()), sorted.size() - 1);
+		return sorted[index];
+	}
 
-		static const int N = 20;
-		for (int i = 0; i < N; ++i)
+	Result execute_scenario(const Scenario& scenario, const Options& options)
+	{
+		Result result;
+		result.name = scenario.fullname();
+		result.iterations = std::max(size_t(1), size_t(scenario.iterations * options.iterations_scale));
+
+		std::vector<double> ns_per_op;
+		double setup_ns = std::numeric_limits<double>::max();
+		for (int i = 0; i < options.repetitions; ++i)
 		{
-			double start = clockstate["os"]["clock"]();
+			scenario_failed = false;
+			Run run(result.iterations);
+			double start = benchmark_harness::now_ns();
+			try
+			{
+				kaguya::State state(kaguya::standard::shared_ptr<kaguya::CountingAllocator>(new kaguya::CountingAllocator()));
+				state.setErrorHandler(record_error);
+				scenario.function(state, run);
+			}
+			catch (const std::exception& e)
 			{
-				kaguya::State state;
-				it->second(state);
+				record_error(0, e.what());
+			}
+			if (!scenario_failed && !run.measured())
+			{
+				record_error(0, "not measured");
+			}
+			if (scenario_failed)
+			{
+				result.failed = true;
+				result.error = scenario_error;
+				return result;
 			}
 
-			double end = clockstate["os"]["clock"]();
-			mintime = std::min(mintime, end - start);
+			double op = run.elapsed() / result.iterations;
+			if (ns_per_op.empty() || op < *std::min_element(ns_per_op.begin(), ns_per_op.end()))
+			{
+				AllocationCount allocations = run.allocations();
+				result.cxx_allocs = double(allocations.cxx) / result.iterations;
+				result.lua_allocs = double(allocations.lua) / result.iterations;
+				result.lua_bytes = double(allocations.luaBytes) / result.iterations;
+				result.counters = run.counters();
+			}
+			ns_per_op.push_back(op);
+			setup_ns = std::min(setup_ns, run.startTime() - start);
 		}
 
-		std::cout << test_name << " min time:" << mintime<< std::endl;
+		std::sort(ns_per_op.begin(), ns_per_op.end());
+		result.min = ns_per_op.front();
+		result.p50 = percentile(ns_per_op, 0.5);
+		result.p90 = percentile(ns_per_op, 0.9);
+		result.max = ns_per_op.back();
+		double sum = 0;
+		for (size_t i = 0; i < ns_per_op.size(); ++i)
+		{
+			sum += ns_per_op[i];
+		}
+		result.mean = sum / ns_per_op.size();
+		double variance = 0;
+		for (size_t i = 0; i < ns_per_op.size(); ++i)
+		{
+			variance += (ns_per_op[i] - result.mean) * (ns_per_op[i] - result.mean);
+		}
+		result.stddev = std::sqrt(variance / ns_per_op.size());
+		result.setup_ms = setup_ns / 1e6;
+		return result;
+	}
+
+	void report_header(std::ostream& os, const Options& options)
+	{
+		if (options.format == "json")
+		{
+			os << "{\"repetitions\":" << options.repetitions << ",\"benchmarks\":[" << std::endl;
+		}
+		else if (options.format == "csv")
+		{
+			os << "name,iterations,min_ns,p50_ns,p90_ns,max_ns,mean_ns,stddev_ns,setup_ms,cxx_allocs_per_op,lua_allocs_per_op,lua_bytes_per_op,error" << std::endl;
+		}
+	}
+	void report(std::ostream& os, const Options& options, const Result& result, bool first)
+	{
+		if (options.format == "json")
+		{
+			os << (first ? "" : ",\n") << "{\"name\":\"" << result.name << "\",\"iterations\":" << result.iterations;
+			if (result.failed)
+			{
+				os << ",\"error\":\"failed\"}";
+				return;
+			}
+			os << ",\"min_ns\":" << result.min << ",\"p50_ns\":" << result.p50 << ",\"p90_ns\":" << result.p90
+				<< ",\"max_ns\":" << result.max << ",\"mean_ns\":" << result.mean << ",\"stddev_ns\":" << result.stddev
+				<< ",\"setup_ms\":" << result.setup_ms
+				<< ",\"cxx_allocs_per_op\":" << result.cxx_allocs << ",\"lua_allocs_per_op\":" << result.lua_allocs
+				<< ",\"lua_bytes_per_op\":" << result.lua_bytes << ",\"counters\":{";
+			for (std::map<std::string, double>::const_iterator it = result.counters.begin(); it != result.counters.end(); ++it)
+			{
+				os << (it == result.counters.begin() ? "" : ",") << "\"" << it->first << "\":" << it->second;
+			}
+			os << "}}";
+		}
+		else if (options.format == "csv")
+		{
+			os << result.name << "," << result.iterations;
+			if (result.failed)
+			{
+				os << ",,,,,,,,,,,failed" << std::endl;
+				return;
+			}
+			os << "," << result.min << "," << result.p50 << "," << result.p90 << "," << result.max << "," << result.mean << "," << result.stddev
+				<< "," << result.setup_ms << "," << result.cxx_allocs << "," << result.lua_allocs << "," << result.lua_bytes << "," << std::endl;
+		}
+		else
+		{
+			os << result.name << " iterations:" << result.iterations;
+			if (result.failed)
+			{
+				os << " FAILED " << result.error << std::endl;
+				return;
+			}
+			os << " min:" << result.min << "ns/op p50:" << result.p50 << "ns/op p90:" << result.p90 << "ns/op max:" << result.max
+				<< "ns/op stddev:" << result.stddev << " setup:" << result.setup_ms << "ms"
+				<< " allocs/op(c++:" << result.cxx_allocs << " lua:" << result.lua_allocs << " lua bytes:" << result.lua_bytes << ")" << std::endl;
+			for (std::map<std::string, double>::const_iterator it = result.counters.begin(); it != result.counters.end(); ++it)
+			{
+				os << "  " << it->first << ":" << it->second << std::endl;
+			}
+		}
+	}
+	void report_footer(std::ostream& os, const Options& options)
+	{
+		if (options.format == "json")
+		{
+			os << "\n]}" << std::endl;
+		}
+	}
+
+	bool match(const Scenario& scenario, const Options& options)
+	{
+		if (options.filters.empty())
+		{
+			return true;
+		}
+		std::string name = scenario.fullname();
+		for (size_t i = 0; i < options.filters.size(); ++i)
+		{
+			if (name.find(options.filters[i]) != std::string::npos)
+			{
+				return true;
+			}
+		}
+		return false;
 	}
-}
 
+	bool parse_options(int argc, char** argv, Options& options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string arg = argv[i];
+			std::string::size_type eq = arg.find('=');
+			std::string key = arg.substr(0, eq);
+			std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+			if (key == "--filter")
+			{
+				std::string::size_type start = 0;
+				while (start <= value.size())
+				{
+					std::string::size_type end = value.find(',', start);
+					if (end == std::string::npos) { end = value.size(); }
+					if (end > start) { options.filters.push_back(value.substr(start, end - start)); }
+					start = end + 1;
+				}
+			}
+			else if (key == "--format" && (value == "text" || value == "json" || value == "csv"))
+			{
+				options.format = value;
+			}
+			else if (key == "--repetitions" && std::atoi(value.c_str()) > 0)
+			{
+				options.repetitions = std::atoi(value.c_str());
+			}
+			else if (key == "--iterations-scale" && std::atof(value.c_str()) > 0)
+			{
+				options.iterations_scale = std::atof(value.c_str());
+			}
+			else if (key == "--output" && !value.empty())
+			{
+				options.output = value;
+			}
+			else if (key == "--list")
+			{
+				options.list = true;
+			}
+			else
+			{
+				std::cerr << "unknown option: " << arg << "\n"
+					"usage: benchmark [--filter=name[,name...]] [--format=text|json|csv] [--repetitions=N]\n"
+					"                 [--iterations-scale=X] [--output=file] [--list]" << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+}
 
-int main()
+int main(int argc, char** argv)
 {
-	benchmark_function_map_t functionmap;
-#define ADD_BENCHMARK(function) functionmap.push_back(std::make_pair(#function,&function));
-	ADD_BENCHMARK(empty);
-	ADD_BENCHMARK(original_api_no_type_check::simple_get_set);
-	ADD_BENCHMARK(kaguya_api_benchmark______::simple_get_set);
-	ADD_BENCHMARK(kaguya_api_benchmark______::overloaded_get_set);	
-	ADD_BENCHMARK(kaguya_api_benchmark______::property_access);
-	ADD_BENCHMARK(kaguya_api_benchmark______::simple_get_set_contain_propery_member);
-	ADD_BENCHMARK(kaguya_api_benchmark______::object_pointer_register_get_set);
-	ADD_BENCHMARK(kaguya_api_benchmark______::call_native_function);
-	ADD_BENCHMARK(original_api_no_type_check::call_native_function);
-	ADD_BENCHMARK(kaguya_api_benchmark______::call_lua_function);
-	ADD_BENCHMARK(original_api_no_type_check::call_lua_function);
-	ADD_BENCHMARK(kaguya_api_benchmark______::call_lua_function_operator_functional);
-	ADD_BENCHMARK(kaguya_api_benchmark______::lua_table_access);
-	ADD_BENCHMARK(original_api_no_type_check::lua_table_access);
-	ADD_BENCHMARK(kaguya_api_benchmark______::lua_table_bracket_operator_access);
-	ADD_BENCHMARK(kaguya_api_benchmark______::lua_table_bracket_operator_assign);
-	ADD_BENCHMARK(kaguya_api_benchmark______::lua_table_bracket_operator_get);
-	ADD_BENCHMARK(kaguya_api_benchmark______::lua_table_bracket_const_operator_get);
-	
-	ADD_BENCHMARK(kaguya_api_benchmark______::lua_allocation);
-	ADD_BENCHMARK(original_api_no_type_check::lua_allocation);
-
-	ADD_BENCHMARK(kaguya_api_benchmark______::table_to_vector);
-	ADD_BENCHMARK(kaguya_api_benchmark______::table_to_vector_with_typecheck);
-	
-
-	execute_benchmark(functionmap);
+	Options options;
+	if (!parse_options(argc, argv, options))
+	{
+		return 1;
+	}
 
+	scenario_list_t scenarios;
+#define ADD_BENCHMARK(group, function, iterations) scenarios.push_back(Scenario(group, #function, &function, iterations));
+	{
+		using namespace kaguya_api_benchmark______;
+		ADD_BENCHMARK("class", simple_get_set, 10000000);
+		ADD_BENCHMARK("class", simple_get_set_static_binding, 10000000);
+		ADD_BENCHMARK("class", object_construct, 1000000);
+		ADD_BENCHMARK("class", overloaded_get_set, 10000000);
+		ADD_BENCHMARK("class", property_access, 10000000);
+		ADD_BENCHMARK("class", inherited_method_call_chained, 10000000);
+		ADD_BENCHMARK("class", inherited_method_call_flattened, 10000000);
+		ADD_BENCHMARK("class", simple_get_set_contain_propery_member, 10000000);
+		ADD_BENCHMARK("class", object_pointer_register_get_set, 10000000);
+		ADD_BENCHMARK("class", register_class_builder, 10000);
+		ADD_BENCHMARK("class", register_class_static, 10000);
+		ADD_BENCHMARK("class", startup_register_500_classes, 20);
+		ADD_BENCHMARK("class", startup_register_500_classes_static, 20);
+
+		ADD_BENCHMARK("function", call_native_function, 10000000);
+		ADD_BENCHMARK("function", call_overloaded_function, 1000000);
+		ADD_BENCHMARK("function", call_native_function_argument_mismatch, 100000);
+		ADD_BENCHMARK("function", variadic_arguments_vector, 1000000);
+		ADD_BENCHMARK("function", variadic_arguments_view, 1000000);
+		ADD_BENCHMARK("function", shared_ptr_argument, 1000000);
+		ADD_BENCHMARK("function", return_large_value, 300000);
+		ADD_BENCHMARK("function", return_multiple_values_tuple, 1000000);
+		ADD_BENCHMARK("function", return_multiple_values_writer, 1000000);
+
+		ADD_BENCHMARK("coroutine", coroutine_spawn_finish, 1000000);
+		ADD_BENCHMARK("coroutine", coroutine_spawn_finish_without_reuse, 1000000);
+		ADD_BENCHMARK("coroutine", coroutine_resume_yield, 1000000);
+#if KAGUYA_USE_CPP11
+		ADD_BENCHMARK("coroutine", async_await_resume, 100000);
+		ADD_BENCHMARK("coroutine", time_slice_round_robin, 10000000);
+#endif
+
+		ADD_BENCHMARK("lua_function", call_lua_function, 10000000);
+		ADD_BENCHMARK("lua_function", call_lua_function_operator_functional, 10000000);
+		ADD_BENCHMARK("lua_function", call_lua_function_multiple_results, 1000000);
+		ADD_BENCHMARK("lua_function", call_lua_function_multiple_results_into, 1000000);
+		ADD_BENCHMARK("lua_function", call_lua_function_with_execution_limit, 10000000);
+#if KAGUYA_USE_CPP11
+		ADD_BENCHMARK("lua_function", call_stored_callback_std_function, 10000000);
+		ADD_BENCHMARK("lua_function", call_stored_callback_lua_callback, 10000000);
+		ADD_BENCHMARK("lua_function", call_lua_function_per_element, 10000000);
+		ADD_BENCHMARK("lua_function", call_lua_function_batched, 10000000);
+#endif
+
+		ADD_BENCHMARK("table", lua_table_access, 10000000);
+		ADD_BENCHMARK("table", lua_table_bracket_operator_access, 10000000);
+		ADD_BENCHMARK("table", lua_table_bracket_operator_assign, 10000000);
+		ADD_BENCHMARK("table", lua_table_bracket_operator_get, 10000000);
+		ADD_BENCHMARK("table", lua_table_bracket_const_operator_get, 10000000);
+		ADD_BENCHMARK("table", state_bracket_operator_chain_get, 10000000);
+		ADD_BENCHMARK("table", field_path_get, 10000000);
+		ADD_BENCHMARK("table", field_path_get_cached, 10000000);
+		ADD_BENCHMARK("table", table_field_access_by_string, 10000000);
+		ADD_BENCHMARK("table", table_field_access_by_key, 10000000);
+		ADD_BENCHMARK("table", lua_table_fill_set_field, 1000000);
+		ADD_BENCHMARK("table", lua_table_fill_pinned_raw_set, 1000000);
+		ADD_BENCHMARK("table", table_to_vector, 1000000);
+		ADD_BENCHMARK("table", table_to_vector_with_typecheck, 1000000);
+		ADD_BENCHMARK("table", lua_allocation, 100000);
+
+		ADD_BENCHMARK("type_traits", push_get_integer, 10000000);
+		ADD_BENCHMARK("type_traits", push_get_number, 10000000);
+		ADD_BENCHMARK("type_traits", push_get_bool, 10000000);
+		ADD_BENCHMARK("type_traits", push_get_enum, 10000000);
+		ADD_BENCHMARK("type_traits", push_get_string, 10000000);
+		ADD_BENCHMARK("type_traits", push_get_c_string, 10000000);
+		ADD_BENCHMARK("type_traits", push_get_object_copy, 1000000);
+		ADD_BENCHMARK("type_traits", push_get_object_pointer, 1000000);
+		ADD_BENCHMARK("type_traits", push_get_shared_ptr, 1000000);
+		ADD_BENCHMARK("type_traits", push_get_vector, 1000000);
+		ADD_BENCHMARK("type_traits", push_get_map, 1000000);
+		ADD_BENCHMARK("type_traits", push_get_lua_table, 10000000);
+		ADD_BENCHMARK("type_traits", push_get_lua_function, 10000000);
+
+		ADD_BENCHMARK("ref", ref_copy_lua_ref, 10000000);
+		ADD_BENCHMARK("ref", ref_copy_lua_table, 10000000);
+		ADD_BENCHMARK("ref", ref_copy_lua_function, 10000000);
+		ADD_BENCHMARK("ref", ref_copy_lua_key, 10000000);
+#if KAGUYA_USE_CPP11
+		ADD_BENCHMARK("ref", ref_copy_lua_callback, 10000000);
+
+		ADD_BENCHMARK("gc", gc_pause_default_collector, 500);
+		ADD_BENCHMARK("gc", gc_pause_budgeted_step, 500);
+#endif
+
+		ADD_BENCHMARK("serialize", binary_serialize_round_trip, 1000000);
+		ADD_BENCHMARK("serialize", text_serialize_round_trip, 1000000);
+	}
+	{
+		using namespace original_api_no_type_check;
+		ADD_BENCHMARK("raw_lua_api", simple_get_set, 10000000);
+		ADD_BENCHMARK("raw_lua_api", call_native_function, 10000000);
+		ADD_BENCHMARK("raw_lua_api", call_lua_function, 10000000);
+		ADD_BENCHMARK("raw_lua_api", lua_table_access, 10000000);
+		ADD_BENCHMARK("raw_lua_api", lua_allocation, 100000);
+	}
+#undef ADD_BENCHMARK
+
+	std::ofstream file;
+	if (!options.output.empty())
+	{
+		file.open(options.output.c_str());
+		if (!file)
+		{
+			std::cerr << "can not open " << options.output << std::endl;
+			return 1;
+		}
+	}
+	std::ostream& os = file.is_open() ? file : std::cout;
+
+	if (options.list)
+	{
+		for (scenario_list_t::const_iterator it = scenarios.begin(); it != scenarios.end(); ++it)
+		{
+			if (match(*it, options))
+			{
+				os << it->fullname() << std::endl;
+			}
+		}
+		return 0;
+	}
+
+	bool failed = false;
+	bool first = true;
+	report_header(os, options);
+	for (scenario_list_t::const_iterator it = scenarios.begin(); it != scenarios.end(); ++it)
+	{
+		if (!match(*it, options))
+		{
+			continue;
+		}
+		Result result = execute_scenario(*it, options);
+		report(os, options, result, first);
+		first = false;
+		failed = failed || result.failed;
+	}
+	report_footer(os, options);
+	return failed ? 1 : 0;
 }
@@ -1,5 +1,12 @@
+#include <numeric>
+#include <cstdio>
 #include "kaguya/kaguya.hpp"
 
+#include "benchmark_function.hpp"
+
+using benchmark_harness::Run;
+using benchmark_harness::run_lua_chunk;
+
 namespace
 {
 
@@ -31,11 +38,21 @@ namespace
 	private:
 		double _i;
 	};
+
+	const char* set_get_loop =
+		"local getset = SetGet.new()\n"
+		"local times = ...\n"
+		"for i=1,times do\n"
+		"getset:set(i)\n"
+		"if(getset:get() ~= i)then\n"
+		"error('error')\n"
+		"end\n"
+		"end\n";
 }
 
 namespace kaguya_api_benchmark______
 {
-	void simple_get_set(kaguya::State& state)
+	void simple_get_set(kaguya::State& state, Run& run)
 	{
 		state["SetGet"].setClass(kaguya::UserdataMetatable<SetGet>()
 			.setConstructors<SetGet()>()
@@ -43,37 +60,165 @@ namespace kaguya_api_benchmark______
 			.addFunction("get", &SetGet::get)
 		);
 
-		state(
-			"local getset = SetGet.new()\n"
-			//"getset={set = function(self,v) self.i = v end,get=function(self) return self.i end}\n"
-			"local times = 10000000\n"
-			"for i=1,times do\n"
-			"getset:set(i)\n"
-			"if(getset:get() ~= i)then\n"
-			"error('error')\n"
-			"end\n"
-			"end\n"
-			"");
+		run_lua_chunk(state, run, set_get_loop);
+	}
+	static const luaL_Reg set_get_static_functions[] = {
+		{ "new", KAGUYA_STATIC_CONSTRUCTOR(SetGet()) },
+		{ "set", KAGUYA_STATIC_FUNCTION(&SetGet::set) },
+		{ "get", KAGUYA_STATIC_FUNCTION(&SetGet::get) },
+		{ 0, 0 }
+	};
+	void simple_get_set_static_binding(kaguya::State& state, Run& run)
+	{
+		state["SetGet"].setClass(kaguya::UserdataMetatable<SetGet>()
+			.addStaticFunctions(set_get_static_functions)
+		);
+
+		run_lua_chunk(state, run, set_get_loop);
+	}
+
+	//! class of 10 methods and 10 properties
+	struct RegisterTarget
+	{
+		RegisterTarget() :p0(0), p1(0), p2(0), p3(0), p4(0), p5(0), p6(0), p7(0), p8(0), p9(0) {}
+		template<int N> int method()const { return N; }
+		int p0, p1, p2, p3, p4, p5, p6, p7, p8, p9;
+	};
+	static const luaL_Reg register_target_functions[] = {
+		{ "m0", KAGUYA_STATIC_FUNCTION(&RegisterTarget::method<0>) },
+		{ "m1", KAGUYA_STATIC_FUNCTION(&RegisterTarget::method<1>) },
+		{ "m2", KAGUYA_STATIC_FUNCTION(&RegisterTarget::method<2>) },
+		{ "m3", KAGUYA_STATIC_FUNCTION(&RegisterTarget::method<3>) },
+		{ "m4", KAGUYA_STATIC_FUNCTION(&RegisterTarget::method<4>) },
+		{ "m5", KAGUYA_STATIC_FUNCTION(&RegisterTarget::method<5>) },
+		{ "m6", KAGUYA_STATIC_FUNCTION(&RegisterTarget::method<6>) },
+		{ "m7", KAGUYA_STATIC_FUNCTION(&RegisterTarget::method<7>) },
+		{ "m8", KAGUYA_STATIC_FUNCTION(&RegisterTarget::method<8>) },
+		{ "m9", KAGUYA_STATIC_FUNCTION(&RegisterTarget::method<9>) },
+		{ 0, 0 }
+	};
+	static const luaL_Reg register_target_properties[] = {
+		{ "p0", KAGUYA_STATIC_FUNCTION(&RegisterTarget::p0) },
+		{ "p1", KAGUYA_STATIC_FUNCTION(&RegisterTarget::p1) },
+		{ "p2", KAGUYA_STATIC_FUNCTION(&RegisterTarget::p2) },
+		{ "p3", KAGUYA_STATIC_FUNCTION(&RegisterTarget::p3) },
+		{ "p4", KAGUYA_STATIC_FUNCTION(&RegisterTarget::p4) },
+		{ "p5", KAGUYA_STATIC_FUNCTION(&RegisterTarget::p5) },
+		{ "p6", KAGUYA_STATIC_FUNCTION(&RegisterTarget::p6) },
+		{ "p7", KAGUYA_STATIC_FUNCTION(&RegisterTarget::p7) },
+		{ "p8", KAGUYA_STATIC_FUNCTION(&RegisterTarget::p8) },
+		{ "p9", KAGUYA_STATIC_FUNCTION(&RegisterTarget::p9) },
+		{ 0, 0 }
+	};
+	//! forget registered metatable, then the class can be registered again
+	void unregister_target(kaguya::State& state)
+	{
+		lua_pushnil(state.state());
+		lua_setfield(state.state(), LUA_REGISTRYINDEX, kaguya::metatableName<RegisterTarget>().c_str());
+	}
+	kaguya::UserdataMetatable<RegisterTarget> register_target_builder()
+	{
+		return kaguya::UserdataMetatable<RegisterTarget>()
+			.addFunction("m0", &RegisterTarget::method<0>)
+			.addFunction("m1", &RegisterTarget::method<1>)
+			.addFunction("m2", &RegisterTarget::method<2>)
+			.addFunction("m3", &RegisterTarget::method<3>)
+			.addFunction("m4", &RegisterTarget::method<4>)
+			.addFunction("m5", &RegisterTarget::method<5>)
+			.addFunction("m6", &RegisterTarget::method<6>)
+			.addFunction("m7", &RegisterTarget::method<7>)
+			.addFunction("m8", &RegisterTarget::method<8>)
+			.addFunction("m9", &RegisterTarget::method<9>)
+			.addProperty("p0", &RegisterTarget::p0)
+			.addProperty("p1", &RegisterTarget::p1)
+			.addProperty("p2", &RegisterTarget::p2)
+			.addProperty("p3", &RegisterTarget::p3)
+			.addProperty("p4", &RegisterTarget::p4)
+			.addProperty("p5", &RegisterTarget::p5)
+			.addProperty("p6", &RegisterTarget::p6)
+			.addProperty("p7", &RegisterTarget::p7)
+			.addProperty("p8", &RegisterTarget::p8)
+			.addProperty("p9", &RegisterTarget::p9);
+	}
+	kaguya::UserdataMetatable<RegisterTarget> register_target_static()
+	{
+		return kaguya::UserdataMetatable<RegisterTarget>()
+			.addStaticFunctions(register_target_functions)
+			.addStaticProperties(register_target_properties);
+	}
+	//! iterations is number of class registration
+	void register_class_builder(kaguya::State& state, Run& run)
+	{
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
+		{
+			unregister_target(state);
+			state["RegisterTarget"].setClass(register_target_builder());
+		}
+		run.stop();
+	}
+	//! iterations is number of class registration
+	void register_class_static(kaguya::State& state, Run& run)
+	{
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
+		{
+			unregister_target(state);
+			state["RegisterTarget"].setClass(register_target_static());
+		}
+		run.stop();
+	}
+	/**
+	* iterations is number of startup, that registers 500 classes of 20 members each.
+	* Same C++ type is registered again after unregister_target, instead of compiling 500 types.
+	*/
+	void startup_register_classes(kaguya::State& state, Run& run, kaguya::UserdataMetatable<RegisterTarget>(*make)())
+	{
+		static const int class_count = 500;
+		std::vector<std::string> names;
+		for (int i = 0; i < class_count; ++i)
+		{
+			char name[16];
+			sprintf(name, "Class%d", i);
+			names.push_back(name);
+		}
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
+		{
+			for (int c = 0; c < class_count; ++c)
+			{
+				unregister_target(state);
+				state[names[c]].setClass(make());
+			}
+		}
+		run.stop();
+		run.setCounter("classes/startup", class_count);
+	}
+	void startup_register_500_classes(kaguya::State& state, Run& run)
+	{
+		startup_register_classes(state, run, &register_target_builder);
 	}
-	void constructor_get_set(kaguya::State& state)
+	void startup_register_500_classes_static(kaguya::State& state, Run& run)
+	{
+		startup_register_classes(state, run, &register_target_static);
+	}
+
+	void object_construct(kaguya::State& state, Run& run)
 	{
 		state["SetGet"].setClass(kaguya::UserdataMetatable<SetGet>()
 			.setConstructors<SetGet()>()
 		);
 
-		state(
-			"local getset = SetGet.new()\n"
-			//"getset={set = function(self,v) self.i = v end,get=function(self) return self.i end}\n"
-			"local times = 10000000\n"
+		run_lua_chunk(state, run,
+			"local new = SetGet.new\n"
+			"local times = ...\n"
 			"for i=1,times do\n"
-			"getset:set(i)\n"
-			"if(getset:get() ~= i)then\n"
+			"if not new() then\n"
 			"error('error')\n"
 			"end\n"
-			"end\n"
-			"");
+			"end\n");
 	}
-	void overloaded_get_set(kaguya::State& state)
+	void overloaded_get_set(kaguya::State& state, Run& run)
 	{
 		state["SetGet"].setClass(kaguya::UserdataMetatable<SetGet>()
 			.setConstructors<SetGet()>()
@@ -81,19 +226,9 @@ namespace kaguya_api_benchmark______
 			.addFunction("get", &SetGet::get)
 		);
 
-		state(
-			"local getset = SetGet.new()\n"
-			//"getset={set = function(self,v) self.i = v end,get=function(self) return self.i end}\n"
-			"local times = 10000000\n"
-			"for i=1,times do\n"
-			"getset:set(i)\n"
-			"if(getset:get() ~= i)then\n"
-			"error('error')\n"
-			"end\n"
-			"end\n"
-			"");
+		run_lua_chunk(state, run, set_get_loop);
 	}
-	void simple_get_set_contain_propery_member(kaguya::State& state)
+	void simple_get_set_contain_propery_member(kaguya::State& state, Run& run)
 	{
 		state["SetGet"].setClass(kaguya::UserdataMetatable<SetGet>()
 			.setConstructors<SetGet()>()
@@ -102,19 +237,9 @@ namespace kaguya_api_benchmark______
 			.addProperty("a", &SetGet::a)
 			);
 
-		state(
-			"local getset = SetGet.new()\n"
-			//"getset={set = function(self,v) self.i = v end,get=function(self) return self.i end}\n"
-			"local times = 10000000\n"
-			"for i=1,times do\n"
-			"getset:set(i)\n"
-			"if(getset:get() ~= i)then\n"
-			"error('error')\n"
-			"end\n"
-			"end\n"
-			"");
+		run_lua_chunk(state, run, set_get_loop);
 	}
-	void object_pointer_register_get_set(kaguya::State& state)
+	void object_pointer_register_get_set(kaguya::State& state, Run& run)
 	{
 		state["SetGet"].setClass(kaguya::UserdataMetatable<SetGet>()
 			.setConstructors<SetGet()>()
@@ -124,8 +249,8 @@ namespace kaguya_api_benchmark______
 
 		SetGet getset;
 		state["getset"] = &getset;
-		state(
-			"local times = 10000000\n"
+		run_lua_chunk(state, run,
+			"local times = ...\n"
 			"for i=1,times do\n"
 			"getset:set(i)\n"
 			"if(getset:get() ~= i)then\n"
@@ -134,11 +259,11 @@ namespace kaguya_api_benchmark______
 			"end\n"
 			);
 	}
-	void call_native_function(kaguya::State& state)
+	void call_native_function(kaguya::State& state, Run& run)
 	{
 		state["nativefun"] = &test_native_function;
-		state(
-			"local times = 10000000\n"
+		run_lua_chunk(state, run,
+			"local times = ...\n"
 			"for i=1,times do\n"
 			"local r = nativefun(i)\n"
 			"if(r ~= i)then\n"
@@ -148,11 +273,11 @@ namespace kaguya_api_benchmark______
 			);
 	}
 
-	void call_overloaded_function(kaguya::State& state)
+	void call_overloaded_function(kaguya::State& state, Run& run)
 	{
 		state["nativefun"] = kaguya::overload(&test_native_function2,&test_native_function);
-		state(
-			"local times = 1000000\n"
+		run_lua_chunk(state, run,
+			"local times = ...\n"
 			"for i=1,times do\n"
 			"local r = nativefun(i)\n"
 			"if(r ~= i)then\n"
@@ -162,86 +287,577 @@ namespace kaguya_api_benchmark______
 		);
 	}
 
-	void call_lua_function(kaguya::State& state)
+	void call_native_function_argument_mismatch(kaguya::State& state, Run& run)
+	{
+		state["SetGet"].setClass(kaguya::UserdataMetatable<SetGet>()
+			.setConstructors<SetGet()>()
+			.addFunction("set", &SetGet::set)
+		);
+		run_lua_chunk(state, run,
+			"local set = SetGet.set\n"
+			"local times = ...\n"
+			"for i=1,times do\n"
+			"if pcall(set, 'not object', i) then\n"
+			"error('error')\n"
+			"end\n"
+			"end\n"
+		);
+	}
+
+	//! logging binding with 10 values
+	const char* variadic_log_loop =
+		"local log = log\n"
+		"local times = ...\n"
+		"for i=1,times do\n"
+		"if log('%f', i, 2, 3, 4, 5, 6, 7, 8, 9, 10) ~= i + 54 then\n"
+		"error('error')\n"
+		"end\n"
+		"end\n";
+	double log_variadic_vector(const char* format, kaguya::VariadicArgType args)
+	{
+		std::vector<double> values = args;
+		return std::accumulate(values.begin(), values.end(), 0.0);
+	}
+	double log_variadic_view(const char* format, kaguya::VariadicArgView<double> args)
+	{
+		double values[20];
+		size_t count = args.copy(values, 20);
+		return std::accumulate(values, values + count, 0.0);
+	}
+	void variadic_arguments_vector(kaguya::State& state, Run& run)
+	{
+		state["log"] = &log_variadic_vector;
+		run_lua_chunk(state, run, variadic_log_loop);
+	}
+	void variadic_arguments_view(kaguya::State& state, Run& run)
+	{
+		state["log"] = &log_variadic_view;
+		run_lua_chunk(state, run, variadic_log_loop);
+	}
+
+	struct SharedBase
+	{
+		SharedBase() :value(1) {}
+		virtual ~SharedBase() {}
+		int value;
+	};
+	struct SharedDerived :SharedBase
+	{
+	};
+	int receive_shared_base(kaguya::standard::shared_ptr<SharedBase> base)
+	{
+		return base->value;
+	}
+	int borrow_shared_base(const SharedBase& base)
+	{
+		return base.value;
+	}
+	void shared_ptr_argument(kaguya::State& state, Run& run)
+	{
+		state["SharedBase"].setClass(kaguya::UserdataMetatable<SharedBase>());
+		state["SharedDerived"].setClass(kaguya::UserdataMetatable<SharedDerived, SharedBase>());
+		state["object"] = kaguya::standard::shared_ptr<SharedDerived>(new SharedDerived());
+		state["receive"] = &receive_shared_base;
+		state["borrow"] = &borrow_shared_base;
+		run_lua_chunk(state, run,
+			"local receive = receive\n"
+			"local borrow = borrow\n"
+			"local object = object\n"
+			"local times = ...\n"
+			"for i=1,times do\n"
+			"if receive(object) + borrow(object) ~= 2 then\n"
+			"error('error')\n"
+			"end\n"
+			"end\n"
+		);
+	}
+
+	struct LargeValue
+	{
+		LargeValue() :size(0) {}
+		int size;
+		char data[10 * 1024];
+	};
+	LargeValue make_large_value(int size)
+	{
+		LargeValue value;
+		value.size = size;
+		return value;
+	}
+	int large_value_size(const LargeValue& value)
+	{
+		return value.size;
+	}
+	void return_large_value(kaguya::State& state, Run& run)
+	{
+		state["LargeValue"].setClass(kaguya::UserdataMetatable<LargeValue>());
+		state["make_large_value"] = &make_large_value;
+		state["large_value_size"] = &large_value_size;
+		run_lua_chunk(state, run,
+			"local make = make_large_value\n"
+			"local size = large_value_size\n"
+			"local times = ...\n"
+			"for i=1,times do\n"
+			"if size(make(i)) ~= i then\n"
+			"error('error')\n"
+			"end\n"
+			"end\n"
+		);
+	}
+
+	kaguya::standard::tuple<double, double, double> velocity_tuple(double t)
+	{
+		return kaguya::standard::tuple<double, double, double>(t, t * 2, t * 3);
+	}
+	kaguya::ResultWriter velocity_writer(double t, kaguya::ResultWriter results)
+	{
+		return results(t)(t * 2)(t * 3);
+	}
+	static const char* multiple_values_chunk =
+		"local velocity = velocity\n"
+		"local times = ...\n"
+		"for i=1,times do\n"
+		"local x, y, z = velocity(i)\n"
+		"if z ~= i * 3 then\n"
+		"error('error')\n"
+		"end\n"
+		"end\n";
+	void return_multiple_values_tuple(kaguya::State& state, Run& run)
+	{
+		state["velocity"] = &velocity_tuple;
+		run_lua_chunk(state, run, multiple_values_chunk);
+	}
+	void return_multiple_values_writer(kaguya::State& state, Run& run)
+	{
+		state["velocity"] = &velocity_writer;
+		run_lua_chunk(state, run, multiple_values_chunk);
+	}
+
+	void coroutine_spawn_finish(kaguya::State& state, Run& run)
+	{
+		state("corfun = function(i) return i end");
+		kaguya::LuaFunction corfun = state["corfun"];
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
+		{
+			kaguya::LuaThread cor = state.newThread(corfun);
+			if (cor.resume<size_t>(i) != i) { throw std::logic_error(""); }
+			state.releaseThread(cor);
+		}
+		run.stop();
+	}
+	void coroutine_spawn_finish_without_reuse(kaguya::State& state, Run& run)
+	{
+		state("corfun = function(i) return i end");
+		kaguya::LuaFunction corfun = state["corfun"];
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
+		{
+			kaguya::LuaThread cor = state.newThread(corfun);
+			if (cor.resume<size_t>(i) != i) { throw std::logic_error(""); }
+		}
+		run.stop();
+	}
+	void coroutine_resume_yield(kaguya::State& state, Run& run)
+	{
+		state("corfun = function(i) while true do i = coroutine.yield(i) end end");
+		kaguya::LuaThread cor = state.newThread(state["corfun"]);
+		cor.resume<void>(0);
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
+		{
+			if (cor.resume<size_t>(i) != i) { throw std::logic_error(""); }
+		}
+		run.stop();
+	}
+
+#if KAGUYA_USE_CPP11
+	void time_slice_round_robin(kaguya::State& state, Run& run)
+	{
+		kaguya::TimeSliceScheduler scheduler(state.state(), 10000);
+		state("function spin(n) return function() local x = 0 for i=1,n do x = x + i end end end");
+		kaguya::LuaFunction spin = state["spin"];
+		size_t tasks = std::min(run.iterations(), size_t(100));
+		for (size_t i = 0; i < tasks; ++i)
+		{
+			scheduler.spawn(spin.call<kaguya::LuaFunction>(run.iterations() / tasks));
+		}
+		run.start();
+		scheduler.run();
+		run.stop();
+	}
+
+	struct TickSource
+	{
+		std::vector<kaguya::AsyncPromise<int> > pending;
+		kaguya::AsyncResult<int> next()
+		{
+			pending.push_back(kaguya::AsyncPromise<int>());
+			return pending.back().result();
+		}
+	};
+	//! iterations is number of awaits. up to 1000 tasks share them.
+	void async_await_resume(kaguya::State& state, Run& run)
+	{
+		kaguya::AsyncScheduler scheduler(state.state());
+		TickSource ticks;
+		state["next_tick"] = kaguya::function([&ticks]() { return ticks.next(); });
+		state(
+			"function task(n)\n"
+			"local next_tick = next_tick\n"
+			"for i=1,n do\n"
+			"if next_tick() ~= i then\n"
+			"error('error')\n"
+			"end\n"
+			"end\n"
+			"end\n"
+		);
+		kaguya::LuaFunction task = state["task"];
+		size_t tasks = std::min(run.iterations(), size_t(1000));
+		run.start();
+		for (size_t i = 0; i < tasks; ++i)
+		{
+			scheduler.spawn(task, run.iterations() / tasks);
+		}
+		for (int tick = 1; scheduler.waitingCount() > 0; ++tick)
+		{
+			std::vector<kaguya::AsyncPromise<int> > pending;
+			pending.swap(ticks.pending);
+			for (size_t i = 0; i < pending.size(); ++i)
+			{
+				pending[i].setValue(tick);
+			}
+			scheduler.poll();
+		}
+		run.stop();
+	}
+#endif
+
+	void call_lua_function(kaguya::State& state, Run& run)
 	{
 		state("lua_function=function(i)return i;end");
 
 		kaguya::LuaRef lua_function = state["lua_function"];
-		for (int i = 0; i < 10000000; i++)
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
 		{
-			int r = lua_function.call<int>(i);
+			size_t r = lua_function.call<size_t>(i);
 			if (r != i) { throw std::logic_error(""); }
 		}
+		run.stop();
 	}
-	void call_lua_function_operator_functional(kaguya::State& state)
+	void call_lua_function_operator_functional(kaguya::State& state, Run& run)
 	{
 		state("lua_function=function(i)return i;end");
 
 		kaguya::LuaFunction lua_function = state["lua_function"];
-		for (int i = 0; i < 10000000; i++)
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
+		{
+			size_t r = lua_function(i);
+			if (r != i) { throw std::logic_error(""); }
+		}
+		run.stop();
+	}
+	void call_lua_function_multiple_results(kaguya::State& state, Run& run)
+	{
+		state("lua_function=function(i)return i, i + 1, i + 2;end");
+
+		kaguya::LuaFunction lua_function = state["lua_function"];
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
+		{
+			size_t a, b, c;
+			kaguya::tie(a, b, c) = lua_function(i);
+			if (a != i || c != i + 2) { throw std::logic_error(""); }
+		}
+		run.stop();
+	}
+	void call_lua_function_multiple_results_into(kaguya::State& state, Run& run)
+	{
+		state("lua_function=function(i)return i, i + 1, i + 2;end");
+
+		kaguya::LuaFunction lua_function = state["lua_function"];
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
+		{
+			size_t a, b, c;
+			lua_function.callInto(kaguya::tie(a, b, c), i);
+			if (a != i || c != i + 2) { throw std::logic_error(""); }
+		}
+		run.stop();
+	}
+#if KAGUYA_USE_CPP11
+	//! iterations is number of calls of up to 1000 stored callbacks
+	template<typename Callback>
+	void fire_stored_callbacks(Run& run, const std::vector<Callback>& callbacks)
+	{
+		run.start();
+		for (size_t i = 0; i < run.iterations() / callbacks.size(); i++)
+		{
+			for (typename std::vector<Callback>::const_iterator it = callbacks.begin(); it != callbacks.end(); ++it)
+			{
+				size_t r = (*it)(i);
+				if (r != i) { throw std::logic_error(""); }
+			}
+		}
+		run.stop();
+	}
+	void call_stored_callback_std_function(kaguya::State& state, Run& run)
+	{
+		std::vector<std::function<size_t(size_t)> > callbacks;
+		for (size_t i = 0; i < std::min(run.iterations(), size_t(1000)); i++)
+		{
+			state("lua_function=function(i)return i;end");
+			callbacks.push_back(std::function<size_t(size_t)>(state["lua_function"].get<kaguya::LuaFunction>()));
+		}
+		fire_stored_callbacks(run, callbacks);
+	}
+	void call_stored_callback_lua_callback(kaguya::State& state, Run& run)
+	{
+		std::vector<kaguya::LuaCallback<size_t(size_t)> > callbacks;
+		for (size_t i = 0; i < std::min(run.iterations(), size_t(1000)); i++)
+		{
+			state("lua_function=function(i)return i;end");
+			callbacks.push_back(state["lua_function"]);
+		}
+		fire_stored_callbacks(run, callbacks);
+	}
+	//! iterations is number of items scored. up to 50k items per request.
+	void call_lua_function_per_element(kaguya::State& state, Run& run)
+	{
+		state("score=function(a, b)return a * b;end");
+
+		kaguya::LuaFunction score = state["score"];
+		std::vector<std::tuple<int, int> > items;
+		for (size_t i = 0; i < std::min(run.iterations(), size_t(50000)); i++)
+		{
+			items.push_back(std::make_tuple(int(i), 2));
+		}
+		std::vector<int> results(items.size());
+		run.start();
+		for (size_t n = 0; n < run.iterations() / items.size(); n++)
+		{
+			for (size_t i = 0; i < items.size(); i++)
+			{
+				results[i] = score.call<int>(std::get<0>(items[i]), std::get<1>(items[i]));
+			}
+			if (results.back() != std::get<0>(items.back()) * 2) { throw std::logic_error(""); }
+		}
+		run.stop();
+	}
+	void call_lua_function_batched(kaguya::State& state, Run& run)
+	{
+		state("score=function(a, b)return a * b;end");
+
+		kaguya::LuaCallback<int(int, int)> score = state["score"];
+		std::vector<std::tuple<int, int> > items;
+		for (size_t i = 0; i < std::min(run.iterations(), size_t(50000)); i++)
+		{
+			items.push_back(std::make_tuple(int(i), 2));
+		}
+		std::vector<int> results(items.size());
+		run.start();
+		for (size_t n = 0; n < run.iterations() / items.size(); n++)
+		{
+			score.callEach(items.begin(), items.end(), results.begin());
+			if (results.back() != std::get<0>(items.back()) * 2) { throw std::logic_error(""); }
+		}
+		run.stop();
+	}
+#endif
+	void call_lua_function_with_execution_limit(kaguya::State& state, Run& run)
+	{
+		state("lua_function=function(i)return i;end");
+
+		kaguya::LuaRef lua_function = state["lua_function"];
+		kaguya::ScopedExecutionLimit limit(state.state(), kaguya::ExecutionLimit().setInstructions(1000000000));
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
 		{
-			int r = lua_function(i);
+			size_t r = lua_function.call<size_t>(i);
 			if (r != i) { throw std::logic_error(""); }
 		}
+		run.stop();
 	}
-	
-	void lua_table_access(kaguya::State& state)
+
+	void lua_table_access(kaguya::State& state, Run& run)
 	{
 		state("lua_table={value=0}");
 		kaguya::LuaTable lua_table = state["lua_table"];
-		for (int i = 0; i < 10000000; i++)
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
 		{
 			lua_table.setField("value", i);
-			int v = lua_table.getField<int>("value");
+			size_t v = lua_table.getField<size_t>("value");
 			if (v != i) { throw std::logic_error(""); }
 		}
+		run.stop();
 	}
 
-	void lua_table_bracket_operator_access(kaguya::State& state)
+	void lua_table_bracket_operator_access(kaguya::State& state, Run& run)
 	{
 		state("lua_table={value=0}");
 		kaguya::LuaTable lua_table = state["lua_table"];
-		for (int i = 0; i < 10000000; i++)
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
 		{
 			lua_table["value"] = i;
-			int v = lua_table["value"];
+			size_t v = lua_table["value"];
 			if (v != i) { throw std::logic_error(""); }
 		}
+		run.stop();
 	}
-	void lua_table_bracket_operator_assign(kaguya::State& state)
+	void lua_table_bracket_operator_assign(kaguya::State& state, Run& run)
 	{
 		state("lua_table={value=0}");
 		kaguya::LuaTable lua_table = state["lua_table"];
-		for (int i = 0; i < 10000000; i++)
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
 		{
 			lua_table.setField("value",i);
-			int v = lua_table["value"];
+			size_t v = lua_table["value"];
 			if (v != i) { throw std::logic_error(""); }
 		}
+		run.stop();
 	}
-	void lua_table_bracket_operator_get(kaguya::State& state)
+	void lua_table_bracket_operator_get(kaguya::State& state, Run& run)
 	{
 		state("lua_table={value=0}");
 		kaguya::LuaTable lua_table = state["lua_table"];
-		for (int i = 0; i < 10000000; i++)
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
 		{
 			lua_table["value"] = i;
-			int v = lua_table.getField<int>("value");
+			size_t v = lua_table.getField<size_t>("value");
 			if (v != i) { throw std::logic_error(""); }
 		}
+		run.stop();
 	}
-
-	void lua_table_bracket_const_operator_get(kaguya::State& state)
+	void lua_table_bracket_const_operator_get(kaguya::State& state, Run& run)
 	{
 		state("lua_table={value=0}");
 		kaguya::LuaTable lua_table = state["lua_table"];
 		const kaguya::LuaTable& const_lua_table = lua_table;
-		for (int i = 0; i < 10000000; i++)
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
 		{
 			lua_table["value"] = i;
-			int v = const_lua_table.getField("value");
+			size_t v = const_lua_table.getField("value");
 			if (v != i) { throw std::logic_error(""); }
 		}
+		run.stop();
+	}
+
+	void state_bracket_operator_chain_get(kaguya::State& state, Run& run)
+	{
+		state("config={limits={rate=0}}");
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
+		{
+			int v = state["config"]["limits"]["rate"];
+			if (v != 0) { throw std::logic_error(""); }
+		}
+		run.stop();
+	}
+	void field_path_get(kaguya::State& state, Run& run)
+	{
+		state("config={limits={rate=0}}");
+		kaguya::FieldPath rate = state.fieldPath("config.limits.rate");
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
+		{
+			int v = rate;
+			if (v != 0) { throw std::logic_error(""); }
+		}
+		run.stop();
+	}
+	void field_path_get_cached(kaguya::State& state, Run& run)
+	{
+		state("config={limits={rate=0}}");
+		kaguya::FieldPath rate = state.fieldPath("config.limits.rate");
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
+		{
+			int v = rate.getCached<int>();
+			if (v != 0) { throw std::logic_error(""); }
+		}
+		run.stop();
+	}
+
+	const char* const record_field_names[] = { "id","name","x","y","z","vx","vy","vz","mass","radius","flags","owner" };
+	const int record_field_count = sizeof(record_field_names) / sizeof(record_field_names[0]);
+	const char* record_table = "record={id=1,name='ball',x=1,y=2,z=3,vx=4,vy=5,vz=6,mass=7,radius=8,flags=9,owner=10}";
+	//! iterations is number of field reads
+	void table_field_access_by_string(kaguya::State& state, Run& run)
+	{
+		state(record_table);
+		kaguya::LuaTable record = state["record"];
+		size_t records = run.iterations() / (record_field_count - 2);
+		double sum = 0;
+		run.start();
+		for (size_t i = 0; i < records; i++)
+		{
+			for (int f = 2; f < record_field_count; ++f)
+			{
+				sum += record.getField<double>(record_field_names[f]);
+			}
+		}
+		run.stop();
+		if (sum != records * 55.0) { throw std::logic_error(""); }
+	}
+	void table_field_access_by_key(kaguya::State& state, Run& run)
+	{
+		state(record_table);
+		kaguya::LuaTable record = state["record"];
+		std::vector<kaguya::LuaKey> keys;
+		for (int f = 0; f < record_field_count; ++f)
+		{
+			keys.push_back(state.newKey(record_field_names[f]));
+		}
+		size_t records = run.iterations() / (record_field_count - 2);
+		double sum = 0;
+		run.start();
+		for (size_t i = 0; i < records; i++)
+		{
+			for (int f = 2; f < record_field_count; ++f)
+			{
+				sum += record.getField<double>(keys[f]);
+			}
+		}
+		run.stop();
+		if (sum != records * 55.0) { throw std::logic_error(""); }
+	}
+
+	//! iterations is number of fields set. up to 100k fields per table.
+	void lua_table_fill_set_field(kaguya::State& state, Run& run)
+	{
+		run.start();
+		int size = int(std::min(run.iterations(), size_t(100000)));
+		for (size_t n = 0; n < run.iterations() / size; n++)
+		{
+			kaguya::LuaTable table = state.newTable(size, 0);
+			for (int i = 1; i <= size; i++)
+			{
+				table.setField(i, i);
+			}
+		}
+		run.stop();
+	}
+	void lua_table_fill_pinned_raw_set(kaguya::State& state, Run& run)
+	{
+		run.start();
+		int size = int(std::min(run.iterations(), size_t(100000)));
+		for (size_t n = 0; n < run.iterations() / size; n++)
+		{
+			kaguya::LuaTable table = state.newTable(size, 0);
+			kaguya::PinnedTable pinned(table);
+			for (int i = 1; i <= size; i++)
+			{
+				pinned.rawSetIndex(i, i);
+			}
+		}
+		run.stop();
 	}
 
 	struct Prop
@@ -250,17 +866,16 @@ namespace kaguya_api_benchmark______
 
 		double d;
 	};
-	void property_access(kaguya::State& state)
+	void property_access(kaguya::State& state, Run& run)
 	{
 		state["Prop"].setClass(kaguya::UserdataMetatable<Prop>()
 			.setConstructors<Prop()>()
 			.addProperty("d", &Prop::d)
 			);
 
-		state(
+		run_lua_chunk(state, run,
 			"local getset = Prop.new()\n"
-			//"getset={set = function(self,v) self.i = v end,get=function(self) return self.i end}\n"
-			"local times = 10000000\n"
+			"local times = ...\n"
 			"for i=1,times do\n"
 			"getset.d =i\n"
 			"if(getset.d ~= i)then\n"
@@ -269,35 +884,302 @@ namespace kaguya_api_benchmark______
 			"end\n"
 			"");
 	}
-	void lua_allocation(kaguya::State& state)
+	struct Level0 { Level0() :v(0) {} double v; void set(double i) { v = i; } double get()const { return v; } };
+	struct Level1 :Level0 {};
+	struct Level2 :Level1 {};
+	struct Level3 :Level2 {};
+	struct Level4 :Level3 {};
+	void inherited_method_call(kaguya::State& state, Run& run, bool flatten)
 	{
-		state("lua_table = { } "
-			"local times = 100000\n"
+		state["Level0"].setClass(kaguya::UserdataMetatable<Level0>()
+			.addFunction("set", &Level0::set)
+			.addFunction("get", &Level0::get)
+			);
+		state["Level1"].setClass(kaguya::UserdataMetatable<Level1, Level0>().flattenInheritance(flatten));
+		state["Level2"].setClass(kaguya::UserdataMetatable<Level2, Level1>().flattenInheritance(flatten));
+		state["Level3"].setClass(kaguya::UserdataMetatable<Level3, Level2>().flattenInheritance(flatten));
+		state["Level4"].setClass(kaguya::UserdataMetatable<Level4, Level3>().flattenInheritance(flatten)
+			.setConstructors<Level4()>()
+			);
+
+		run_lua_chunk(state, run,
+			"local getset = Level4.new()\n"
+			"local times = ...\n"
+			"for i=1,times do\n"
+			"getset:set(i)\n"
+			"if(getset:get() ~= i)then\n"
+			"error('error')\n"
+			"end\n"
+			"end\n"
+			"");
+	}
+	void inherited_method_call_chained(kaguya::State& state, Run& run)
+	{
+		inherited_method_call(state, run, false);
+	}
+	void inherited_method_call_flattened(kaguya::State& state, Run& run)
+	{
+		inherited_method_call(state, run, true);
+	}
+
+	enum PushGetEnum
+	{
+		PUSH_GET_ENUM_VALUE = 3
+	};
+	//! push value and get it back by lua_type_traits<T>
+	template<typename T>
+	void push_get(kaguya::State& state, Run& run, const T& value)
+	{
+		lua_State* l = state.state();
+		int top = lua_gettop(l);
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
+		{
+			kaguya::lua_type_traits<T>::push(l, value);
+			if (!kaguya::lua_type_traits<T>::strictCheckType(l, -1)) { throw std::logic_error(""); }
+			typename kaguya::lua_type_traits<T>::get_type v = kaguya::lua_type_traits<T>::get(l, -1);
+			(void)v;
+			lua_settop(l, top);
+		}
+		run.stop();
+	}
+	void push_get_integer(kaguya::State& state, Run& run)
+	{
+		push_get<int>(state, run, 42);
+	}
+	void push_get_number(kaguya::State& state, Run& run)
+	{
+		push_get<double>(state, run, 4.2);
+	}
+	void push_get_bool(kaguya::State& state, Run& run)
+	{
+		push_get<bool>(state, run, true);
+	}
+	void push_get_enum(kaguya::State& state, Run& run)
+	{
+		push_get<PushGetEnum>(state, run, PUSH_GET_ENUM_VALUE);
+	}
+	void push_get_string(kaguya::State& state, Run& run)
+	{
+		push_get<std::string>(state, run, "benchmark string value");
+	}
+	void push_get_c_string(kaguya::State& state, Run& run)
+	{
+		push_get<const char*>(state, run, "benchmark string value");
+	}
+	void push_get_object_copy(kaguya::State& state, Run& run)
+	{
+		state["SetGet"].setClass(kaguya::UserdataMetatable<SetGet>());
+		push_get<SetGet>(state, run, SetGet());
+	}
+	void push_get_object_pointer(kaguya::State& state, Run& run)
+	{
+		state["SetGet"].setClass(kaguya::UserdataMetatable<SetGet>());
+		SetGet object;
+		push_get<SetGet*>(state, run, &object);
+	}
+	void push_get_shared_ptr(kaguya::State& state, Run& run)
+	{
+		state["SharedBase"].setClass(kaguya::UserdataMetatable<SharedBase>());
+		push_get<kaguya::standard::shared_ptr<SharedBase> >(state, run, kaguya::standard::shared_ptr<SharedBase>(new SharedBase()));
+	}
+	void push_get_vector(kaguya::State& state, Run& run)
+	{
+		push_get<std::vector<double> >(state, run, std::vector<double>(8, 1.5));
+	}
+	void push_get_map(kaguya::State& state, Run& run)
+	{
+		std::map<std::string, int> value;
+		value["x"] = 1;
+		value["y"] = 2;
+		value["z"] = 3;
+		value["w"] = 4;
+		push_get<std::map<std::string, int> >(state, run, value);
+	}
+	void push_get_lua_table(kaguya::State& state, Run& run)
+	{
+		push_get<kaguya::LuaTable>(state, run, state.newTable());
+	}
+	void push_get_lua_function(kaguya::State& state, Run& run)
+	{
+		state("lua_function=function(i)return i;end");
+		push_get<kaguya::LuaFunction>(state, run, state["lua_function"]);
+	}
+
+	//! copy reference and release
+	template<typename T>
+	void ref_copy(Run& run, const T& ref)
+	{
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
+		{
+			T copied = ref;
+			if (copied.isNilref()) { throw std::logic_error(""); }
+		}
+		run.stop();
+	}
+	void ref_copy_lua_ref(kaguya::State& state, Run& run)
+	{
+		ref_copy(run, state.newRef(42));
+	}
+	void ref_copy_lua_table(kaguya::State& state, Run& run)
+	{
+		ref_copy(run, state.newTable());
+	}
+	void ref_copy_lua_function(kaguya::State& state, Run& run)
+	{
+		state("lua_function=function(i)return i;end");
+		ref_copy(run, state["lua_function"].get<kaguya::LuaFunction>());
+	}
+	void ref_copy_lua_key(kaguya::State& state, Run& run)
+	{
+		ref_copy(run, state.newKey("key"));
+	}
+#if KAGUYA_USE_CPP11
+	void ref_copy_lua_callback(kaguya::State& state, Run& run)
+	{
+		state("lua_function=function(i)return i;end");
+		ref_copy(run, kaguya::LuaCallback<int(int)>(state["lua_function"].get<kaguya::LuaFunction>()));
+	}
+#endif
+
+	//! iterations is number of table fields set
+	void lua_allocation(kaguya::State& state, Run& run)
+	{
+		run_lua_chunk(state, run, "lua_table = { } "
+			"local times = ...\n"
 			"for i=1,times do\n"
 			"lua_table['key'..i] =i\n"
 			"end\n"
 			"");
 	}
 
+#if KAGUYA_USE_CPP11
+	//! each frame allocates short lived tables and keeps some of them alive
+	const char* gc_frame_source =
+		"keep = {}\n"
+		"function frame(n)\n"
+		"local t = {}\n"
+		"for i=1,2000 do t[i] = {i, 'key'..i} end\n"
+		"keep[n % 50 + 1] = t\n"
+		"end\n";
 
-	void table_to_vector(kaguya::State& state)
+	double percentile_us(std::vector<std::chrono::nanoseconds> times, double p)
+	{
+		if (times.empty())
+		{
+			return 0;
+		}
+		size_t index = std::min(size_t(p * times.size()), times.size() - 1);
+		std::nth_element(times.begin(), times.begin() + index, times.end());
+		return times[index].count() / 1000.0;
+	}
+	void report_pauses(Run& run, const std::string& name, const std::vector<std::chrono::nanoseconds>& times)
+	{
+		run.setCounter(name + "_p50_us", percentile_us(times, 0.5));
+		run.setCounter(name + "_p99_us", percentile_us(times, 0.99));
+		run.setCounter(name + "_max_us", percentile_us(times, 1.0));
+	}
+	std::chrono::nanoseconds run_gc_frame(kaguya::LuaFunction& frame, size_t n)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		frame(n);
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+	}
+	//! iterations is number of frames
+	void gc_pause_default_collector(kaguya::State& state, Run& run)
+	{
+		state(gc_frame_source);
+		kaguya::LuaFunction frame = state["frame"];
+		std::vector<std::chrono::nanoseconds> frames;
+		frames.reserve(run.iterations());
+		run.start();
+		for (size_t i = 0; i < run.iterations(); ++i)
+		{
+			frames.push_back(run_gc_frame(frame, i));
+		}
+		run.stop();
+		report_pauses(run, "frame", frames);
+	}
+	void gc_pause_budgeted_step(kaguya::State& state, Run& run)
+	{
+		state(gc_frame_source);
+		kaguya::LuaFunction frame = state["frame"];
+		kaguya::GCDriver driver(state.state(), run.iterations());
+		driver.setAutomatic(false);
+		std::vector<std::chrono::nanoseconds> frames;
+		frames.reserve(run.iterations());
+		run.start();
+		for (size_t i = 0; i < run.iterations(); ++i)
+		{
+			frames.push_back(run_gc_frame(frame, i));
+			driver.step(std::chrono::microseconds(500));
+		}
+		run.stop();
+		report_pauses(run, "frame", frames);
+		report_pauses(run, "gc_step", std::vector<std::chrono::nanoseconds>(driver.pauses().begin(), driver.pauses().end()));
+		run.setCounter("gc_cycles", double(driver.stats().cycles));
+		run.setCounter("in_use_kb", driver.usedBytes() / 1024.0);
+	}
+#endif
+
+	//! iterations is number of elements of serialized table
+	const char* serialize_source_table =
+		"source_table = {}\n"
+		"for i=1,... do\n"
+		"if i % 2 == 0 then source_table[i] = i\n"
+		"elseif i % 4 == 1 then source_table[i] = i + 0.5\n"
+		"else source_table[i] = 'name'..(i % 1000) end\n"
+		"end\n";
+	void binary_serialize_round_trip(kaguya::State& state, Run& run)
+	{
+		state.loadstring(serialize_source_table)(run.iterations());
+		run.start();
+		std::ostringstream os;
+		kaguya::serialize(os, state["source_table"]);
+		kaguya::LuaTable copied = state.deserialize(os.str());
+		run.stop();
+		if (copied.size() != run.iterations()) { throw std::logic_error(""); }
+	}
+	//generate Lua source and load it
+	void text_serialize_round_trip(kaguya::State& state, Run& run)
+	{
+		state.loadstring(serialize_source_table)(run.iterations());
+		run_lua_chunk(state, run,
+			"local buf = {}\n"
+			"for i,v in ipairs(source_table) do\n"
+			"if type(v) == 'string' then buf[i] = string.format('%q', v)\n"
+			"elseif math.type(v) == 'float' then buf[i] = string.format('%.17g', v)\n"
+			"else buf[i] = tostring(v) end\n"
+			"end\n"
+			"local text = 'return {' .. table.concat(buf, ',') .. '}'\n"
+			"copied_table = load(text)()\n"
+			"if #copied_table ~= ... then error('error') end\n"
+			"");
+	}
+
+	void table_to_vector(kaguya::State& state, Run& run)
 	{
 		state("lua_table={4,2,3,4,4,23,32,34,23,34,4,245,235,432,6,7,76,37,64,5,4}");
 		kaguya::LuaTable lua_table = state["lua_table"];
-		for (int i = 0; i < 1000000; i++)
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
 		{
 			std::vector<double> r = lua_table;
 		}
+		run.stop();
 	}
-	void table_to_vector_with_typecheck(kaguya::State& state)
+	void table_to_vector_with_typecheck(kaguya::State& state, Run& run)
 	{
 		state("lua_table={4,2,3,4,4,23,32,34,23,34,4,245,235,432,6,7,76,37,64,5,4}");
 		kaguya::LuaTable lua_table = state["lua_table"];
-		for (int i = 0; i < 1000000; i++)
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
 		{
 			bool was_valid;
 			std::vector<double> r = lua_table.get<std::vector<double> >(was_valid);
 		}
+		run.stop();
 	}
 }
 
@@ -310,8 +1192,8 @@ namespace original_api_no_type_check
 		lua_setmetatable(L, -2);
 	}
 	void setfuncs(lua_State *L, const luaL_Reg *l) {
-		for (; l->name != 0; l++) { 
-			lua_pushcclosure(L, l->func, 0); 
+		for (; l->name != 0; l++) {
+			lua_pushcclosure(L, l->func, 0);
 			lua_setfield(L, -2, l->name);
 		}
 	}
@@ -336,14 +1218,22 @@ namespace original_api_no_type_check
 		return 1;
 	}
 
+	//! run Lua loop chunk with iteration count, measured
+	void run_chunk(lua_State* s, Run& run, const char* chunk)
+	{
+		luaL_loadstring(s, chunk);
+		lua_pushinteger(s, lua_Integer(run.iterations()));
+		run.start();
+		lua_pcall(s, 1, 0, 0);
+		run.stop();
+	}
 
-	void simple_get_set(kaguya::State& )
+	void simple_get_set(kaguya::State& state, Run& run)
 	{
-		lua_State* s = luaL_newstate();
-		luaL_openlibs(s);
+		lua_State* s = state.state();
 		luaL_newmetatable(s,"SetGet");
 
-		luaL_Reg funcs[] = 
+		luaL_Reg funcs[] =
 		{
 			{ "new",setget_new },
 			{ 0 ,0 },
@@ -364,17 +1254,7 @@ namespace original_api_no_type_check
 
 		lua_setglobal(s, "SetGet");
 
-		luaL_dostring(s,
-			"local getset = SetGet.new()\n"
-			"local times = 10000000\n"
-			"for i=1,times do\n"
-			"getset:set(i)\n"
-			"if(getset:get() ~= i)then\n"
-			"error('error')\n"
-			"end\n"
-			"end\n"
-			"");
-		lua_close(s);
+		run_chunk(s, run, set_get_loop);
 	}
 
 
@@ -385,15 +1265,14 @@ namespace original_api_no_type_check
 		lua_pushnumber(L,result);
 		return 1;
 	}
-	void call_native_function(kaguya::State& )
+	void call_native_function(kaguya::State& state, Run& run)
 	{
-		lua_State* s = luaL_newstate();
-		luaL_openlibs(s);
+		lua_State* s = state.state();
 		lua_pushcclosure(s, static_native_function_binding, 0);  /* closure with those upvalues */
 		lua_setglobal(s,"nativefun");
 
-		luaL_dostring(s,
-			"local times = 10000000\n"
+		run_chunk(s, run,
+			"local times = ...\n"
 			"for i=1,times do\n"
 			"local r = nativefun(i)\n"
 			"if(r ~= i)then\n"
@@ -401,59 +1280,58 @@ namespace original_api_no_type_check
 			"end\n"
 			"end\n"
 			);
-		lua_close(s);
 	}
-	void call_lua_function(kaguya::State& )
+	void call_lua_function(kaguya::State& state, Run& run)
 	{
-		lua_State* s = luaL_newstate();
-		luaL_openlibs(s);
+		lua_State* s = state.state();
 		luaL_dostring(s,"lua_function=function(i)return i;end");
 		lua_getglobal(s, "lua_function");
 		int funref = luaL_ref(s, LUA_REGISTRYINDEX);
-		for (int i = 0; i < 10000000; i++)
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
 		{
 			lua_rawgeti(s, LUA_REGISTRYINDEX, funref);
-			lua_pushnumber(s, i);
+			lua_pushnumber(s, lua_Number(i));
 			lua_pcall(s, 1, 1,0);
-			int r = static_cast<int>(lua_tonumber(s, -1));
+			size_t r = static_cast<size_t>(lua_tonumber(s, -1));
 			if (r != i) { throw std::logic_error(""); }
 			lua_pop(s, 1);
 		}
-		lua_close(s);
+		run.stop();
+		luaL_unref(s, LUA_REGISTRYINDEX, funref);
 	}
-	void lua_table_access(kaguya::State& )
+	void lua_table_access(kaguya::State& state, Run& run)
 	{
-		lua_State* s = luaL_newstate();
-		luaL_openlibs(s);
+		lua_State* s = state.state();
 		luaL_dostring(s, "lua_table={value=0}");
 
 		lua_getglobal(s, "lua_table");
 		int table_ref = luaL_ref(s, LUA_REGISTRYINDEX);//get lua_table reference
-		for (int i = 0; i < 10000000; i++)
+		int top = lua_gettop(s);
+		run.start();
+		for (size_t i = 0; i < run.iterations(); i++)
 		{
 			lua_rawgeti(s, LUA_REGISTRYINDEX, table_ref);
-			lua_pushnumber(s, i);
+			lua_pushnumber(s, lua_Number(i));
 			lua_setfield(s, -2, "value");
-			lua_settop(s,0);
+			lua_settop(s, top);
 
 			lua_rawgeti(s, LUA_REGISTRYINDEX, table_ref);
 			lua_getfield(s, -1, "value");
-			int v = static_cast<int>(lua_tonumber(s, -1));
+			size_t v = static_cast<size_t>(lua_tonumber(s, -1));
 			if (v != i) { throw std::logic_error(""); }
-			lua_settop(s, 0);
+			lua_settop(s, top);
 		}
+		run.stop();
 		luaL_unref(s, LUA_REGISTRYINDEX, table_ref);
-		lua_close(s);
 	}
-	void lua_allocation(kaguya::State& )
+	void lua_allocation(kaguya::State& state, Run& run)
 	{
-		lua_State* s = luaL_newstate();
-		luaL_dostring(s, "lua_table = { } "
-			"local times = 100000\n"
+		run_chunk(state.state(), run, "lua_table = { } "
+			"local times = ...\n"
 			"for i=1,times do\n"
 			"lua_table['key'..i] =i\n"
 			"end\n"
 			"");
-		lua_close(s);
 	}
-}
\ No newline at end of file
+}
@@ -1,36 +1,112 @@
 #pragma once
+
+#include "benchmark_harness.hpp"
+
 namespace kaguya_api_benchmark______
 {
+	using benchmark_harness::Run;
+
+	void simple_get_set(kaguya::State& state, Run& run);
+	void simple_get_set_static_binding(kaguya::State& state, Run& run);
+	void register_class_builder(kaguya::State& state, Run& run);
+	void register_class_static(kaguya::State& state, Run& run);
+	void startup_register_500_classes(kaguya::State& state, Run& run);
+	void startup_register_500_classes_static(kaguya::State& state, Run& run);
+	void object_construct(kaguya::State& state, Run& run);
+	void overloaded_get_set(kaguya::State& state, Run& run);
+	void simple_get_set_contain_propery_member(kaguya::State& state, Run& run);
+	void object_pointer_register_get_set(kaguya::State& state, Run& run);
+
+	void call_native_function(kaguya::State& state, Run& run);
+	void call_overloaded_function(kaguya::State& state, Run& run);
+	void call_native_function_argument_mismatch(kaguya::State& state, Run& run);
+	void variadic_arguments_vector(kaguya::State& state, Run& run);
+	void variadic_arguments_view(kaguya::State& state, Run& run);
+	void shared_ptr_argument(kaguya::State& state, Run& run);
+	void return_large_value(kaguya::State& state, Run& run);
+	void return_multiple_values_tuple(kaguya::State& state, Run& run);
+	void return_multiple_values_writer(kaguya::State& state, Run& run);
+	void coroutine_spawn_finish(kaguya::State& state, Run& run);
+	void coroutine_spawn_finish_without_reuse(kaguya::State& state, Run& run);
+	void coroutine_resume_yield(kaguya::State& state, Run& run);
+#if KAGUYA_USE_CPP11
+	void async_await_resume(kaguya::State& state, Run& run);
+	void time_slice_round_robin(kaguya::State& state, Run& run);
+	void gc_pause_default_collector(kaguya::State& state, Run& run);
+	void gc_pause_budgeted_step(kaguya::State& state, Run& run);
+#endif
 
-	void simple_get_set(kaguya::State& state);
-	void overloaded_get_set(kaguya::State& state);
-	void simple_get_set_contain_propery_member(kaguya::State& state);
-	void object_pointer_register_get_set(kaguya::State& state);
+	void call_lua_function(kaguya::State& state, Run& run);
+	void call_lua_function_operator_functional(kaguya::State& state, Run& run);
+	void call_lua_function_multiple_results(kaguya::State& state, Run& run);
+	void call_lua_function_multiple_results_into(kaguya::State& state, Run& run);
+	void call_lua_function_with_execution_limit(kaguya::State& state, Run& run);
+#if KAGUYA_USE_CPP11
+	void call_stored_callback_std_function(kaguya::State& state, Run& run);
+	void call_stored_callback_lua_callback(kaguya::State& state, Run& run);
+	void call_lua_function_per_element(kaguya::State& state, Run& run);
+	void call_lua_function_batched(kaguya::State& state, Run& run);
+#endif
+	void lua_table_access(kaguya::State& state, Run& run);
+	void lua_table_bracket_operator_access(kaguya::State& state, Run& run);
+	void lua_table_bracket_operator_assign(kaguya::State& state, Run& run);
+	void lua_table_bracket_operator_get(kaguya::State& state, Run& run);
+	void lua_table_bracket_const_operator_get(kaguya::State& state, Run& run);
+	void state_bracket_operator_chain_get(kaguya::State& state, Run& run);
+	void field_path_get(kaguya::State& state, Run& run);
+	void field_path_get_cached(kaguya::State& state, Run& run);
+	void table_field_access_by_string(kaguya::State& state, Run& run);
+	void table_field_access_by_key(kaguya::State& state, Run& run);
+	void lua_table_fill_set_field(kaguya::State& state, Run& run);
+	void lua_table_fill_pinned_raw_set(kaguya::State& state, Run& run);
 
-	void call_native_function(kaguya::State& state);
-	void call_overloaded_function(kaguya::State& state);
+	void property_access(kaguya::State& state, Run& run);
+	void inherited_method_call_chained(kaguya::State& state, Run& run);
+	void inherited_method_call_flattened(kaguya::State& state, Run& run);
 
-	void call_lua_function(kaguya::State& state);
-	void call_lua_function_operator_functional(kaguya::State& state);
-	void lua_table_access(kaguya::State& state);
-	void lua_table_bracket_operator_access(kaguya::State& state);
-	void lua_table_bracket_operator_assign(kaguya::State& state);
-	void lua_table_bracket_operator_get(kaguya::State& state);
-	void lua_table_bracket_const_operator_get(kaguya::State& state);
-	
-	void property_access(kaguya::State& state);
+	void push_get_integer(kaguya::State& state, Run& run);
+	void push_get_number(kaguya::State& state, Run& run);
+	void push_get_bool(kaguya::State& state, Run& run);
+	void push_get_enum(kaguya::State& state, Run& run);
+	void push_get_string(kaguya::State& state, Run& run);
+	void push_get_c_string(kaguya::State& state, Run& run);
+	void push_get_object_copy(kaguya::State& state, Run& run);
+	void push_get_object_pointer(kaguya::State& state, Run& run);
+	void push_get_shared_ptr(kaguya::State& state, Run& run);
+	void push_get_vector(kaguya::State& state, Run& run);
+	void push_get_map(kaguya::State& state, Run& run);
+	void push_get_lua_table(kaguya::State& state, Run& run);
+	void push_get_lua_function(kaguya::State& state, Run& run);
 
-	void table_to_vector(kaguya::State& state);
-	void table_to_vector_with_typecheck(kaguya::State& state);
+	void ref_copy_lua_ref(kaguya::State& state, Run& run);
+	void ref_copy_lua_table(kaguya::State& state, Run& run);
+	void ref_copy_lua_function(kaguya::State& state, Run& run);
+	void ref_copy_lua_key(kaguya::State& state, Run& run);
+#if KAGUYA_USE_CPP11
+	void ref_copy_lua_callback(kaguya::State& state, Run& run);
+#endif
 
-	void lua_allocation(kaguya::State& state);
+	void table_to_vector(kaguya::State& state, Run& run);
+	void table_to_vector_with_typecheck(kaguya::State& state, Run& run);
+
+	void lua_allocation(kaguya::State& state, Run& run);
+
+	void binary_serialize_round_trip(kaguya::State& state, Run& run);
+	void text_serialize_round_trip(kaguya::State& state, Run& run);
 }
 
 namespace original_api_no_type_check
 {
-	void simple_get_set(kaguya::State& state);
-	void call_native_function(kaguya::State& state);
-	void call_lua_function(kaguya::State& state);
-	void lua_table_access(kaguya::State& state);
-	void lua_allocation(kaguya::State& state);
-}
\ No newline at end of file
+	using benchmark_harness::Run;
+
+	void simple_get_set(kaguya::State& state, Run& run);
+	void simple_get_set_static_binding(kaguya::State& state, Run& run);
+	void register_class_builder(kaguya::State& state, Run& run);
+	void register_class_static(kaguya::State& state, Run& run);
+	void startup_register_500_classes(kaguya::State& state, Run& run);
+	void startup_register_500_classes_static(kaguya::State& state, Run& run);
+	void call_native_function(kaguya::State& state, Run& run);
+	void call_lua_function(kaguya::State& state, Run& run);
+	void lua_table_access(kaguya::State& state, Run& run);
+	void lua_allocation(kaguya::State& state, Run& run);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <ctime>
+
+#include "kaguya/kaguya.hpp"
+
+#if KAGUYA_USE_CPP11
+#include <chrono>
+#endif
+
+namespace benchmark_harness
+{
+	using kaguya::AllocationCount;
+	using kaguya::allocation_count;
+
+	//! monotonic time in nanoseconds
+	inline double now_ns()
+	{
+#if KAGUYA_USE_CPP11
+		return double(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#else
+		return double(std::clock()) * 1e9 / CLOCKS_PER_SEC;
+#endif
+	}
+
+	/**
+	* @brief one measured run of a scenario.
+	* Scenario does setup, then start(), runs iterations() operations and stop().
+	* Only between start and stop is timed and counted.
+	*/
+	class Run
+	{
+	public:
+		explicit Run(size_t iterations) :iterations_(iterations), start_ns_(0), stop_ns_(0), started_(false), stopped_(false)
+		{
+		}
+
+		//! number of operations to run between start and stop
+		size_t iterations()const { return iterations_; }
+
+		void start()
+		{
+			started_ = true;
+			start_allocation_ = allocation_count();
+			start_ns_ = now_ns();
+		}
+		void stop()
+		{
+			stop_ns_ = now_ns();
+			stop_allocation_ = allocation_count();
+			stopped_ = true;
+		}
+
+		//! report scenario specific value. e.g. pause percentile
+		void setCounter(const std::string& name, double value)
+		{
+			counters_[name] = value;
+		}
+
+		bool measured()const { return started_ && stopped_; }
+		double startTime()const { return start_ns_; }
+		double elapsed()const { return stop_ns_ - start_ns_; }
+		AllocationCount allocations()const
+		{
+			return stop_allocation_ - start_allocation_;
+		}
+		const std::map<std::string, double>& counters()const { return counters_; }
+
+	private:
+		size_t iterations_;
+		double start_ns_;
+		double stop_ns_;
+		bool started_;
+		bool stopped_;
+		AllocationCount start_allocation_;
+		AllocationCount stop_allocation_;
+		std::map<std::string, double> counters_;
+	};
+
+	/**
+	* @brief load Lua loop chunk at setup and run it measured.
+	* Chunk gets iteration count as "...". e.g. "local times = ... for i=1,times do f(i) end"
+	*/
+	inline void run_lua_chunk(kaguya::State& state, Run& run, const char* chunk)
+	{
+		kaguya::LuaFunction f = state.loadstring(chunk);
+		run.start();
+		f(run.iterations());
+		run.stop();
+	}
+
+	typedef void(*scenario_function_t)(kaguya::State&, Run&);
+}
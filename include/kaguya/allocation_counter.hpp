@@ -0,0 +1,206 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstdlib>
+#include <new>
+#include "kaguya/config.hpp"
+#include "kaguya/exception.hpp"
+
+#if KAGUYA_USE_CPP11
+#include <atomic>
+#endif
+
+namespace kaguya
+{
+	/**
+	* @brief number of allocations.
+	* C++ heap allocations are counted only if KAGUYA_DEFINE_COUNTING_OPERATOR_NEW is defined in one translation unit.
+	* Lua allocations are counted only in lua_State created with CountingAllocator.
+	*/
+	struct AllocationCount
+	{
+		AllocationCount() :cxx(0), cxxBytes(0), lua(0), luaBytes(0) {}
+		size_t cxx;//!< number of operator new calls
+		size_t cxxBytes;
+		size_t lua;//!< number of allocate and reallocate calls of CountingAllocator
+		size_t luaBytes;
+
+		AllocationCount operator-(const AllocationCount& rhs)const
+		{
+			AllocationCount count;
+			count.cxx = cxx - rhs.cxx;
+			count.cxxBytes = cxxBytes - rhs.cxxBytes;
+			count.lua = lua - rhs.lua;
+			count.luaBytes = luaBytes - rhs.luaBytes;
+			return count;
+		}
+	};
+
+	namespace detail
+	{
+		/**
+		* @brief process wide counters.
+		* With C++11, counters are atomic, and allocations in any thread are counted.
+		* Without C++11, counters are not synchronized, allocate from one thread only.
+		*/
+		struct AllocationCounters
+		{
+#if KAGUYA_USE_CPP11
+			typedef std::atomic<size_t> counter_type;
+#else
+			typedef size_t counter_type;
+#endif
+			counter_type cxx;
+			counter_type cxxBytes;
+			counter_type lua;
+			counter_type luaBytes;
+		};
+		//! zero initialized before any dynamic initialization, so it can be used from operator new called in static constructors.
+		inline AllocationCounters& allocation_counters()
+		{
+			static AllocationCounters counters;
+			return counters;
+		}
+		inline void add_allocation(AllocationCounters::counter_type& count, AllocationCounters::counter_type& bytes, size_t size)
+		{
+#if KAGUYA_USE_CPP11
+			count.fetch_add(1, std::memory_order_relaxed);
+			bytes.fetch_add(size, std::memory_order_relaxed);
+#else
+			count++;
+			bytes += size;
+#endif
+		}
+		inline void add_cxx_allocation(size_t size)
+		{
+			AllocationCounters& counters = allocation_counters();
+			add_allocation(counters.cxx, counters.cxxBytes, size);
+		}
+		inline void add_lua_allocation(size_t size)
+		{
+			AllocationCounters& counters = allocation_counters();
+			add_allocation(counters.lua, counters.luaBytes, size);
+		}
+	}
+
+	//! snapshot of process wide allocation counts. @see detail::AllocationCounters
+	inline AllocationCount allocation_count()
+	{
+		const detail::AllocationCounters& counters = detail::allocation_counters();
+		AllocationCount count;
+		count.cxx = counters.cxx;
+		count.cxxBytes = counters.cxxBytes;
+		count.lua = counters.lua;
+		count.luaBytes = counters.luaBytes;
+		return count;
+	}
+
+	/**
+	* @brief allocator for State that counts Lua allocations to allocation_count().
+	* e.g. kaguya::State state(kaguya::standard::shared_ptr<kaguya::CountingAllocator>(new kaguya::CountingAllocator()));
+	*/
+	struct CountingAllocator
+	{
+		typedef void* pointer;
+		typedef size_t size_type;
+		pointer allocate(size_type n)
+		{
+			detail::add_lua_allocation(n);
+			return std::malloc(n);
+		}
+		pointer reallocate(pointer p, size_type n)
+		{
+			detail::add_lua_allocation(n);
+			return std::realloc(p, n);
+		}
+		void deallocate(pointer p, size_type n)
+		{
+			std::free(p);
+		}
+	};
+
+	/**
+	* @brief count allocations in the scope.
+	* e.g.
+	* @code
+	* kaguya::ScopedAllocationCount scope;
+	* f(1, 2);
+	* assert(scope.count().cxx == 0);
+	* @endcode
+	*/
+	class ScopedAllocationCount
+	{
+	public:
+		ScopedAllocationCount() :start_(allocation_count())
+		{
+		}
+		//! allocations from construction or reset
+		AllocationCount count()const
+		{
+			return allocation_count() - start_;
+		}
+		void reset()
+		{
+			start_ = allocation_count();
+		}
+	private:
+		AllocationCount start_;
+	};
+}
+
+/**
+* If KAGUYA_DEFINE_COUNTING_OPERATOR_NEW is defined before including kaguya headers in one translation unit,
+* global operator new and delete are replaced to count C++ heap allocations to kaguya::allocation_count().
+*/
+#ifdef KAGUYA_DEFINE_COUNTING_OPERATOR_NEW
+void* operator new(size_t size)
+{
+	kaguya::detail::add_cxx_allocation(size);
+	void* p = std::malloc(size ? size : 1);
+	if (!p) { KAGUYA_THROW(std::bad_alloc()); }
+	return p;
+}
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+void* operator new(size_t size, const std::nothrow_t&) throw()
+{
+	kaguya::detail::add_cxx_allocation(size);
+	return std::malloc(size ? size : 1);
+}
+void* operator new[](size_t size, const std::nothrow_t& tag) throw()
+{
+	return operator new(size, tag);
+}
+void operator delete(void* p) throw()
+{
+	std::free(p);
+}
+void operator delete[](void* p) throw()
+{
+	std::free(p);
+}
+void operator delete(void* p, const std::nothrow_t&) throw()
+{
+	std::free(p);
+}
+void operator delete[](void* p, const std::nothrow_t&) throw()
+{
+	std::free(p);
+}
+#if KAGUYA_USE_CPP11
+void operator delete(void* p, size_t) noexcept
+{
+	std::free(p);
+}
+void operator delete[](void* p, size_t) noexcept
+{
+	std::free(p);
+}
+#endif
+#endif
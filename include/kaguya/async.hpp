@@ -0,0 +1,474 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "kaguya/config.hpp"
+
+#if KAGUYA_USE_CPP11
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "kaguya/lua_ref.hpp"
+#include "kaguya/native_function.hpp"
+#include "kaguya/lua_ref_function.hpp"
+
+namespace kaguya
+{
+	class AsyncScheduler;
+
+	namespace asyncimpl
+	{
+		//! push resume values to coroutine. return number of pushed values.
+		typedef std::function<int(lua_State*)> value_pusher;
+
+		//! coroutine that can be resumed with values
+		struct completion
+		{
+			lua_State* thread;
+			value_pusher values;
+		};
+
+		/**
+		* @brief completions received from any thread. AsyncScheduler consume it on the thread that own lua_State.
+		* Owned by scheduler and pending results. It lives longer than scheduler if completion is late.
+		*/
+		class completion_queue
+		{
+		public:
+			void push(completion c)
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					queue_.push_back(std::move(c));
+				}
+				condition_.notify_one();
+			}
+			//! move all completions to back of out
+			void takeAll(std::deque<completion>& out)
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				while (!queue_.empty())
+				{
+					out.push_back(std::move(queue_.front()));
+					queue_.pop_front();
+				}
+			}
+			void wait()
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				while (queue_.empty())
+				{
+					condition_.wait(lock);
+				}
+			}
+			template<class Rep, class Period>
+			bool waitFor(const std::chrono::duration<Rep, Period>& timeout)
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				return condition_.wait_for(lock, timeout, [this]() { return !queue_.empty(); });
+			}
+		private:
+			std::mutex mutex_;
+			std::condition_variable condition_;
+			std::deque<completion> queue_;
+		};
+
+		//! shared by AsyncPromise and AsyncResult
+		class shared_state
+		{
+		public:
+			shared_state() :thread_(0), completed_(false), awaited_(false) {}
+
+			//! set result. If coroutine already waits, it is sent to scheduler.
+			void complete(value_pusher values)
+			{
+				std::shared_ptr<completion_queue> queue;
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					if (completed_)
+					{
+						return;
+					}
+					completed_ = true;
+					if (!queue_)
+					{
+						values_ = std::move(values);
+						return;
+					}
+					queue.swap(queue_);
+				}
+				completion c = { thread_, std::move(values) };
+				queue->push(std::move(c));
+			}
+
+			/**
+			* @brief wait result on coroutine.
+			* @return If result already completed, return false and values is set.
+			*/
+			bool await(const std::shared_ptr<completion_queue>& queue, lua_State* thread, value_pusher& values)
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				awaited_ = true;
+				if (completed_)
+				{
+					values.swap(values_);
+					return false;
+				}
+				queue_ = queue;
+				thread_ = thread;
+				return true;
+			}
+			bool awaited()const
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				return awaited_;
+			}
+			bool completed()const
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				return completed_;
+			}
+		private:
+			mutable std::mutex mutex_;
+			std::shared_ptr<completion_queue> queue_;
+			lua_State* thread_;
+			bool completed_;
+			bool awaited_;
+			value_pusher values_;
+		};
+
+		//! push value. value is held by shared_ptr for move only type
+		template<class T>
+		struct value_holder
+		{
+			explicit value_holder(T&& value) :value_(std::make_shared<T>(std::move(value))) {}
+			int operator()(lua_State* l)const
+			{
+				return util::push_args(l, std::move(*value_));
+			}
+		private:
+			std::shared_ptr<T> value_;
+		};
+		struct no_value
+		{
+			int operator()(lua_State* l)const
+			{
+				return 0;
+			}
+		};
+		//! push nil and error message
+		struct error_value
+		{
+			explicit error_value(const std::string& message) :message_(message) {}
+			int operator()(lua_State* l)const
+			{
+				lua_pushnil(l);
+				lua_pushlstring(l, message_.c_str(), message_.size());
+				return 2;
+			}
+		private:
+			std::string message_;
+		};
+
+		//! resume argument
+		struct resume_values
+		{
+			value_pusher values;
+		};
+	}
+
+	template<class T>
+	class AsyncPromise;
+
+	/**
+	* @brief pending result of asynchronous operation.
+	* Returned from bound function, calling coroutine is suspended until AsyncPromise is completed,
+	* and AsyncScheduler resume it with the value. If already completed, value is returned without suspend.
+	* Can be awaited once.
+	*/
+	template<class T>
+	class AsyncResult
+	{
+	public:
+		AsyncResult() {}
+
+		bool valid()const { return state_ != 0; }
+		bool ready()const { return state_ && state_->completed(); }
+	private:
+		explicit AsyncResult(const std::shared_ptr<asyncimpl::shared_state>& state) :state_(state) {}
+
+		std::shared_ptr<asyncimpl::shared_state> state_;
+		friend class AsyncPromise<T>;
+		friend struct lua_type_traits<AsyncResult<T> >;
+	};
+
+	/**
+	* @brief completion side of AsyncResult. set value from event loop or worker thread.
+	* Value is pushed to Lua on the thread that call AsyncScheduler::poll.
+	* Do not use Lua objects(e.g. LuaRef) as value.
+	*/
+	template<class T>
+	class AsyncPromise
+	{
+	public:
+		AsyncPromise() :state_(std::make_shared<asyncimpl::shared_state>()) {}
+
+		AsyncResult<T> result()const
+		{
+			return AsyncResult<T>(state_);
+		}
+		//! complete with value. Can be called from any thread. Completed more than once is ignored.
+		void setValue(T value)
+		{
+			state_->complete(asyncimpl::value_holder<T>(std::move(value)));
+		}
+		//! complete with error. Coroutine receive nil and message.
+		void setError(const std::string& message)
+		{
+			state_->complete(asyncimpl::error_value(message));
+		}
+	private:
+		std::shared_ptr<asyncimpl::shared_state> state_;
+	};
+
+	template<>
+	class AsyncPromise<void>
+	{
+	public:
+		AsyncPromise() :state_(std::make_shared<asyncimpl::shared_state>()) {}
+
+		AsyncResult<void> result()const
+		{
+			return AsyncResult<void>(state_);
+		}
+		//! complete without value. Can be called from any thread.
+		void setValue()
+		{
+			state_->complete(asyncimpl::no_value());
+		}
+		//! complete with error. Coroutine receive nil and message.
+		void setError(const std::string& message)
+		{
+			state_->complete(asyncimpl::error_value(message));
+		}
+	private:
+		std::shared_ptr<asyncimpl::shared_state> state_;
+	};
+
+	/**
+	* @brief resume coroutines that wait AsyncResult.
+	* Completion may come from any thread, but poll and run must be called on the thread that use lua_State.
+	* One scheduler per lua_State.
+	*/
+	class AsyncScheduler
+	{
+	public:
+		explicit AsyncScheduler(lua_State* state) :state_(util::toMainThread(state)), queue_(std::make_shared<asyncimpl::completion_queue>())
+		{
+			util::ScopedSavedStack save(state_);
+			lua_pushlightuserdata(state_, registryKey());
+			lua_pushlightuserdata(state_, this);
+			lua_settable(state_, LUA_REGISTRYINDEX);
+		}
+		~AsyncScheduler()
+		{
+			util::ScopedSavedStack save(state_);
+			lua_pushlightuserdata(state_, registryKey());
+			lua_pushnil(state_);
+			lua_settable(state_, LUA_REGISTRYINDEX);
+		}
+
+		/**
+		* @brief run function on new coroutine until it finish or wait AsyncResult.
+		* @return coroutine
+		*/
+		template<class... Args>
+		LuaThread spawn(const LuaFunction& f, Args&&... args)
+		{
+			LuaThread thread(state_);
+			thread.setFunction(f);
+			resume(thread, std::forward<Args>(args)...);
+			return thread;
+		}
+
+		/**
+		* @brief resume coroutines whose result is completed, and coroutines that yield by coroutine.yield. Not blocking.
+		* @return number of resumed coroutines
+		*/
+		size_t poll()
+		{
+			queue_->takeAll(ready_);
+			size_t count = 0;
+			std::deque<LuaThread> yielded;
+			yielded.swap(yielded_);
+			while (!yielded.empty())
+			{
+				LuaThread thread = yielded.front();
+				yielded.pop_front();
+				count++;
+				resume(thread);
+			}
+			while (!ready_.empty())
+			{
+				asyncimpl::completion c = std::move(ready_.front());
+				ready_.pop_front();
+				std::unordered_map<lua_State*, LuaThread>::iterator it = waiting_.find(c.thread);
+				if (it == waiting_.end())
+				{
+					continue;
+				}
+				LuaThread thread = it->second;
+				waiting_.erase(it);
+				count++;
+				asyncimpl::resume_values values = { std::move(c.values) };
+				resume(thread, values);
+			}
+			return count;
+		}
+
+		/**
+		* @brief wait completion until timeout, and poll.
+		* @return number of resumed coroutines
+		*/
+		template<class Rep, class Period>
+		size_t pollFor(const std::chrono::duration<Rep, Period>& timeout)
+		{
+			if (yielded_.empty())
+			{
+				queue_->waitFor(timeout);
+			}
+			return poll();
+		}
+
+		/**
+		* @brief poll until all coroutines finished. block while waiting completion.
+		* @return number of resumed coroutines
+		*/
+		size_t run()
+		{
+			size_t count = 0;
+			while (!waiting_.empty() || !yielded_.empty() || !ready_.empty())
+			{
+				if (yielded_.empty() && ready_.empty())
+				{
+					queue_->wait();
+				}
+				count += poll();
+			}
+			return count;
+		}
+
+		//! number of coroutines waiting AsyncResult
+		size_t waitingCount()const
+		{
+			return waiting_.size();
+		}
+
+		//! scheduler registered to state. If not exists, return null
+		static AsyncScheduler* get(lua_State* state)
+		{
+			util::ScopedSavedStack save(state);
+			lua_pushlightuserdata(state, registryKey());
+			lua_gettable(state, LUA_REGISTRYINDEX);
+			return static_cast<AsyncScheduler*>(lua_touserdata(state, -1));
+		}
+
+		/**
+		* @brief suspend current coroutine until result is completed. Used by push of AsyncResult.
+		* @return number of pushed values or nativefunction::YIELD_CURRENT_THREAD
+		*/
+		static int await(lua_State* l, const std::shared_ptr<asyncimpl::shared_state>& state)
+		{
+			if (!state || state->awaited())
+			{
+				return error(l, "AsyncResult is invalid or already awaited");
+			}
+			AsyncScheduler* scheduler = get(l);
+			if (!state->completed() && (!scheduler || !yieldable(l)))
+			{
+				return error(l, scheduler ? "can not wait AsyncResult outside coroutine" : "AsyncScheduler is not created");
+			}
+			asyncimpl::value_pusher values;
+			if (!state->await(scheduler ? scheduler->queue_ : std::shared_ptr<asyncimpl::completion_queue>(), l, values))
+			{
+				return values ? values(l) : 0;
+			}
+			lua_pushthread(l);
+			scheduler->waiting_.insert(std::make_pair(l, LuaThread(l, StackTop())));
+			return nativefunction::YIELD_CURRENT_THREAD;
+		}
+
+	private:
+		static void* registryKey()
+		{
+			static char key;
+			return &key;
+		}
+		//! report error, and return nil and message same as AsyncPromise::setError
+		static int error(lua_State* l, const char* message)
+		{
+			except::OtherError(l, message);
+			return asyncimpl::error_value(message)(l);
+		}
+		static bool yieldable(lua_State* l)
+		{
+#if LUA_VERSION_NUM >= 503
+			return lua_isyieldable(l) != 0;
+#else
+			bool is_main = lua_pushthread(l) == 1;
+			lua_pop(l, 1);
+			return !is_main;
+#endif
+		}
+
+		template<class... Args>
+		void resume(LuaThread& thread, Args&&... args)
+		{
+			thread.resume<void>(std::forward<Args>(args)...);
+			if (thread.threadStatus() == LUA_YIELD && waiting_.find(thread.get<lua_State*>()) == waiting_.end())
+			{
+				yielded_.push_back(thread);
+			}
+		}
+
+		AsyncScheduler(const AsyncScheduler&);
+		AsyncScheduler& operator=(const AsyncScheduler&);
+
+		lua_State* state_;
+		std::shared_ptr<asyncimpl::completion_queue> queue_;
+		std::deque<asyncimpl::completion> ready_;
+		std::deque<LuaThread> yielded_;
+		std::unordered_map<lua_State*, LuaThread> waiting_;
+	};
+
+	template<class T>
+	struct lua_type_traits<AsyncResult<T> >
+	{
+		typedef const AsyncResult<T>& push_type;
+
+		//! Can be used as return type of bound function only.
+		static int push(lua_State* l, push_type result)
+		{
+			return AsyncScheduler::await(l, result.state_);
+		}
+	};
+
+	template<>
+	struct lua_type_traits<asyncimpl::resume_values>
+	{
+		typedef const asyncimpl::resume_values& push_type;
+
+		static int push(lua_State* l, push_type v)
+		{
+			return v.values ? v.values(l) : 0;
+		}
+	};
+}
+#endif
@@ -0,0 +1,219 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "kaguya/config.hpp"
+
+#if KAGUYA_USE_CPP11
+#include <map>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+#include "kaguya/utility.hpp"
+#include "kaguya/lua_ref.hpp"
+#include "kaguya/native_function.hpp"
+#include "kaguya/allocation_counter.hpp"
+
+namespace kaguya
+{
+	/**
+	* @brief counters and latency histograms of native function calls dispatched by kaguya, for one lua_State.
+	* Functions registered by kaguya::function, overload, addFunction and setConstructors are counted,
+	* and aggregated by the name the function was called with(e.g. "new" for constructors).
+	* Allocations in calls are counted from allocation_count(). @see allocation_counter.hpp
+	* It can be enabled with Profiler or other BindingMetrics on the same lua_State.
+	* If not enabled, dispatcher does not look up metrics.
+	*/
+	class BindingMetrics :public nativefunction::NativeCallObserver
+	{
+	public:
+		//! bucket i counts calls with latency in [2^i, 2^(i+1)) nanoseconds. last bucket includes larger latency.
+		static const int HISTOGRAM_BUCKETS = 32;
+
+		struct Stats
+		{
+			Stats() :calls(0), overloadMisses(0), typeMismatches(0), exceptions(0), totalTime(0), maxTime(0), histogram(HISTOGRAM_BUCKETS, 0), cxxAllocations(0), luaAllocations(0) {}
+			size_t calls;
+			size_t overloadMisses;//!< no overload matched to arguments
+			size_t typeMismatches;//!< arguments were not convertible to selected function
+			size_t exceptions;//!< exception thrown from function
+			std::chrono::nanoseconds totalTime;
+			std::chrono::nanoseconds maxTime;
+			std::vector<size_t> histogram;
+			size_t cxxAllocations;//!< C++ heap allocations in calls
+			size_t luaAllocations;//!< Lua allocations in calls
+
+			/**
+			* @brief estimate latency at percentile from histogram
+			* @param p percentile 0.0 - 1.0
+			* @return upper bound of the bucket
+			*/
+			std::chrono::nanoseconds percentile(double p)const
+			{
+				size_t rank = size_t(p * calls);
+				size_t count = 0;
+				for (int i = 0; i < HISTOGRAM_BUCKETS; ++i)
+				{
+					count += histogram[i];
+					if (count > rank)
+					{
+						return std::min(std::chrono::nanoseconds(int64_t(2) << i), maxTime);
+					}
+				}
+				return maxTime;
+			}
+		};
+		typedef std::map<std::string, Stats> StatsMap;
+
+		explicit BindingMetrics(lua_State* state) :state_(util::toMainThread(state)), enabled_(false)
+		{
+		}
+		~BindingMetrics()
+		{
+			disable();
+		}
+
+		void enable()
+		{
+			if (!enabled_)
+			{
+				nativefunction::add_observer(state_, this);
+				enabled_ = true;
+			}
+		}
+		void disable()
+		{
+			if (enabled_)
+			{
+				nativefunction::remove_observer(state_, this);
+				calls_.clear();
+				enabled_ = false;
+			}
+		}
+		bool enabled()const { return enabled_; }
+
+		const StatsMap& stats()const { return stats_; }
+		//! return stats of the name. If not called, return null
+		const Stats* find(const std::string& name)const
+		{
+			StatsMap::const_iterator it = stats_.find(name);
+			return it != stats_.end() ? &it->second : 0;
+		}
+		void clear()
+		{
+			stats_.clear();
+		}
+
+		/**
+		* @brief return stats as Lua table for query from Lua.
+		* {[name]={calls=,overload_misses=,type_mismatches=,exceptions=,total_ns=,max_ns=,p50_ns=,p99_ns=,cxx_allocations=,lua_allocations=,histogram={...}}}
+		*/
+		LuaTable toTable()const
+		{
+			util::ScopedSavedStack save(state_);
+			lua_createtable(state_, 0, int(stats_.size()));
+			for (StatsMap::const_iterator it = stats_.begin(); it != stats_.end(); ++it)
+			{
+				const Stats& stats = it->second;
+				lua_createtable(state_, 0, 11);
+				setField("calls", lua_Integer(stats.calls));
+				setField("overload_misses", lua_Integer(stats.overloadMisses));
+				setField("type_mismatches", lua_Integer(stats.typeMismatches));
+				setField("exceptions", lua_Integer(stats.exceptions));
+				setField("total_ns", lua_Integer(stats.totalTime.count()));
+				setField("max_ns", lua_Integer(stats.maxTime.count()));
+				setField("p50_ns", lua_Integer(stats.percentile(0.5).count()));
+				setField("p99_ns", lua_Integer(stats.percentile(0.99).count()));
+				setField("cxx_allocations", lua_Integer(stats.cxxAllocations));
+				setField("lua_allocations", lua_Integer(stats.luaAllocations));
+				lua_createtable(state_, HISTOGRAM_BUCKETS, 0);
+				for (int i = 0; i < HISTOGRAM_BUCKETS; ++i)
+				{
+					lua_pushinteger(state_, lua_Integer(stats.histogram[i]));
+					lua_rawseti(state_, -2, i + 1);
+				}
+				lua_setfield(state_, -2, "histogram");
+				lua_setfield(state_, -2, it->first.c_str());
+			}
+			return LuaTable(state_, StackTop());
+		}
+
+		virtual void enter(lua_State* state)
+		{
+			calls_.push_back(Call(nativefunction::called_function_name(state)));
+			calls_.back().allocations = allocation_count();
+			calls_.back().start = std::chrono::steady_clock::now();
+		}
+		virtual void leave(lua_State*, int result)
+		{
+			if (calls_.empty())
+			{
+				return;
+			}
+			std::chrono::nanoseconds elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - calls_.back().start);
+			AllocationCount allocations = allocation_count() - calls_.back().allocations;
+			Stats& stats = stats_[calls_.back().name];
+			calls_.pop_back();
+			stats.calls++;
+			stats.cxxAllocations += allocations.cxx;
+			stats.luaAllocations += allocations.lua;
+			switch (result)
+			{
+			case nativefunction::RAISE_NO_MATCHING_OVERLOAD:
+				stats.overloadMisses++;
+				break;
+			case nativefunction::RAISE_TYPE_MISMATCH:
+				stats.typeMismatches++;
+				break;
+			case nativefunction::RAISE_EXCEPTION:
+				stats.exceptions++;
+				break;
+			}
+			stats.totalTime += elapsed;
+			if (stats.maxTime < elapsed)
+			{
+				stats.maxTime = elapsed;
+			}
+			stats.histogram[bucket(elapsed)]++;
+		}
+
+	private:
+		struct Call
+		{
+			explicit Call(const char* n) :name(n) {}
+			const char* name;
+			std::chrono::steady_clock::time_point start;
+			AllocationCount allocations;
+		};
+
+		static int bucket(std::chrono::nanoseconds elapsed)
+		{
+			int index = 0;
+			for (uint64_t ns = uint64_t(elapsed.count()) >> 1; ns && index < HISTOGRAM_BUCKETS - 1; ns >>= 1)
+			{
+				index++;
+			}
+			return index;
+		}
+		void setField(const char* key, lua_Integer value)const
+		{
+			lua_pushinteger(state_, value);
+			lua_setfield(state_, -2, key);
+		}
+
+		BindingMetrics(const BindingMetrics&);
+		BindingMetrics& operator=(const BindingMetrics&);
+
+		lua_State* state_;
+		bool enabled_;
+		StatsMap stats_;
+		std::vector<Call> calls_;
+	};
+}
+#endif
@@ -0,0 +1,254 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "kaguya/config.hpp"
+
+#if KAGUYA_USE_CPP11
+#include <vector>
+
+#include "kaguya/utility.hpp"
+#include "kaguya/error_handler.hpp"
+#include "kaguya/lua_ref.hpp"
+
+namespace kaguya
+{
+	namespace callback_detail
+	{
+		template<typename Ret>
+		struct result_count { static const int value = 1; };
+		template<>
+		struct result_count<void> { static const int value = 0; };
+		template<typename... Types>
+		struct result_count<standard::tuple<Types...> > { static const int value = sizeof...(Types); };
+
+		struct Holder
+		{
+			Holder(lua_State* s, int r) :state(s), ref(r) {}
+			~Holder()
+			{
+				luaL_unref(state, LUA_REGISTRYINDEX, ref);
+			}
+			lua_State* state;
+			int ref;
+		private:
+			Holder(const Holder&);
+			Holder& operator=(const Holder&);
+		};
+	}
+
+	//! error handling of LuaCallback::callEach
+	enum BatchErrorMode
+	{
+		BATCH_CONTINUE_ON_ERROR,//!< report error to error handler, write default value and continue
+		BATCH_STOP_ON_ERROR//!< report error as LuaFunction call(throw if enabled) and stop
+	};
+	//! result of LuaCallback::callEach
+	struct BatchResult
+	{
+		BatchResult() :calls(0) {}
+		size_t calls;//!< number of called elements including failed
+		std::vector<size_t> failed;//!< indexes of failed elements
+
+		bool succeeded()const { return failed.empty(); }
+	};
+
+	template<typename FTYPE>
+	class LuaCallback;
+
+	/**
+	* @brief Lua function handle with fixed signature, for callbacks called many times from C++.
+	* Call does not construct FunctionResults, and copy shares the registry reference.
+	* Copyable and callable, so it can be stored in standard::function<Ret(Args...)>.
+	* e.g.
+	* @code
+	* kaguya::LuaCallback<int(int, int)> add = state["add"];
+	* int r = add(1, 2);
+	* @endcode
+	*/
+	template<typename Ret, typename... Args>
+	class LuaCallback<Ret(Args...)>
+	{
+	public:
+		typedef Ret result_type;
+		//! number of results taken from called function
+		static const int RESULT_COUNT = callback_detail::result_count<Ret>::value;
+
+		LuaCallback()
+		{
+		}
+		//! reference function at index. If not function, become nil callback.
+		LuaCallback(lua_State* state, int index)
+		{
+			if (lua_type(state, index) != LUA_TFUNCTION)
+			{
+				return;
+			}
+			lua_pushvalue(state, index);
+			lua_State* main = util::toMainThread(state);
+			if (main != state)
+			{
+				lua_xmove(state, main, 1);
+			}
+			holder_ = standard::make_shared<callback_detail::Holder>(main, luaL_ref(main, LUA_REGISTRYINDEX));
+		}
+		LuaCallback(const LuaFunction& f)
+		{
+			lua_State* state = f.state();
+			if (!state || f.type() != LUA_TFUNCTION)
+			{
+				return;
+			}
+			util::ScopedSavedStack save(state);
+			f.push(state);
+			holder_ = standard::make_shared<callback_detail::Holder>(state, luaL_ref(state, LUA_REGISTRYINDEX));
+		}
+
+		bool isNilref()const { return !holder_; }
+		lua_State* state()const { return holder_ ? holder_->state : 0; }
+
+		int push(lua_State* state)const
+		{
+			if (!holder_ || util::toMainThread(state) != holder_->state)
+			{
+				lua_pushnil(state);
+				return 1;
+			}
+			lua_rawgeti(state, LUA_REGISTRYINDEX, holder_->ref);
+			return 1;
+		}
+
+		Ret operator()(Args... args)const
+		{
+			lua_State* state = holder_ ? holder_->state : 0;
+			if (!state)
+			{
+				except::typeMismatchError(state, "is nil");
+				return Ret();
+			}
+			util::ScopedSavedStack save(state);
+			int argstart = lua_gettop(state) + 1;
+			lua_rawgeti(state, LUA_REGISTRYINDEX, holder_->ref);
+			int argnum = util::push_args(state, args...);
+			int status = lua_pcall_wrap(state, argnum, RESULT_COUNT);
+			if (status != 0)
+			{
+				except::checkErrorAndThrow(status, state);
+				return Ret();
+			}
+			lua_settop(state, argstart + RESULT_COUNT - 1);//adjust to fixed result count
+			return util::get_result<Ret>(state, argstart);
+		}
+
+		/**
+		* @brief call for each element in [first, last) and write results to out.
+		* Function is pushed once, and stack is reserved once for the whole batch.
+		* Element is an argument or standard::tuple of arguments.
+		* e.g.
+		* @code
+		* std::vector<std::tuple<int, int> > args;
+		* std::vector<int> results;
+		* add.callEach(args.begin(), args.end(), std::back_inserter(results));
+		* @endcode
+		* @param mode If BATCH_CONTINUE_ON_ERROR, Ret() is written for failed element.
+		* @return number of calls and indexes of failed elements
+		*/
+		template<typename InputIterator, typename OutputIterator>
+		BatchResult callEach(InputIterator first, InputIterator last, OutputIterator out, BatchErrorMode mode = BATCH_CONTINUE_ON_ERROR)const
+		{
+			BatchResult result;
+			lua_State* state = holder_ ? holder_->state : 0;
+			if (!state)
+			{
+				except::typeMismatchError(state, "is nil");
+				return result;
+			}
+			util::ScopedSavedStack save(state);
+			lua_rawgeti(state, LUA_REGISTRYINDEX, holder_->ref);
+			int function_index = lua_gettop(state);
+			if (!lua_checkstack(state, int(sizeof...(Args)) + RESULT_COUNT + 1))
+			{
+				except::OtherError(state, "stack overflow");
+				return result;
+			}
+			for (size_t index = 0; first != last; ++first, ++index)
+			{
+				lua_pushvalue(state, function_index);
+				int argnum = util::push_args(state, *first);
+				int status = lua_pcall_wrap(state, argnum, RESULT_COUNT);
+				result.calls++;
+				if (status != 0)
+				{
+					result.failed.push_back(index);
+					if (mode == BATCH_STOP_ON_ERROR)
+					{
+						except::checkErrorAndThrow(status, state);
+						break;
+					}
+					ErrorHandler::handle(status, state);
+					lua_settop(state, function_index);
+					write_default(out, types::typetag<Ret>());
+					continue;
+				}
+				lua_settop(state, function_index + RESULT_COUNT);
+				write_result(out, state, function_index + 1, types::typetag<Ret>());
+				lua_settop(state, function_index);
+			}
+			return result;
+		}
+
+	private:
+		template<typename OutputIterator, typename T>
+		static void write_result(OutputIterator& out, lua_State* state, int index, types::typetag<T>)
+		{
+			*out = util::get_result<T>(state, index);
+			++out;
+		}
+		template<typename OutputIterator>
+		static void write_result(OutputIterator&, lua_State*, int, types::typetag<void>)
+		{
+		}
+		template<typename OutputIterator, typename T>
+		static void write_default(OutputIterator& out, types::typetag<T>)
+		{
+			*out = T();
+			++out;
+		}
+		template<typename OutputIterator>
+		static void write_default(OutputIterator&, types::typetag<void>)
+		{
+		}
+
+		standard::shared_ptr<callback_detail::Holder> holder_;
+	};
+
+	template<typename Ret, typename... Args>
+	struct lua_type_traits<LuaCallback<Ret(Args...)> >
+	{
+		typedef LuaCallback<Ret(Args...)> get_type;
+		typedef const LuaCallback<Ret(Args...)>& push_type;
+
+		static bool strictCheckType(lua_State* l, int index)
+		{
+			return lua_type(l, index) == LUA_TFUNCTION;
+		}
+		static bool checkType(lua_State* l, int index)
+		{
+			return lua_type(l, index) == LUA_TFUNCTION;
+		}
+		static get_type get(lua_State* l, int index)
+		{
+			return get_type(l, index);
+		}
+		static int push(lua_State* l, push_type v)
+		{
+			return v.push(l);
+		}
+	};
+	template<typename Ret, typename... Args>
+	struct lua_type_traits<const LuaCallback<Ret(Args...)>&> :lua_type_traits<LuaCallback<Ret(Args...)> > {};
+}
+#endif
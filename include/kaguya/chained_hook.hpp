@@ -0,0 +1,115 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+
+#include "kaguya/config.hpp"
+
+namespace kaguya
+{
+	namespace util
+	{
+		/**
+		* @brief hook that was installed before own count hook.
+		* Own hook calls it, so other hooks(e.g. ScopedExecutionLimit) keep working while own hook is installed.
+		* Previous hook receives count event when its own count is elapsed, and lua_gethookcount returns elapsed count in it.
+		*/
+		class ChainedHook
+		{
+		public:
+			ChainedHook() :hook_(0), mask_(0), count_(0), elapsed_(0)
+			{
+			}
+
+			//! save current hook of l. If it is same as saved hook, elapsed count is kept.
+			void save(lua_State* l)
+			{
+				lua_Hook hook = lua_gethook(l);
+				int mask = lua_gethookmask(l);
+				int count = lua_gethookcount(l);
+				if (hook != hook_ || mask != mask_ || count != count_)
+				{
+					hook_ = hook;
+					mask_ = mask;
+					count_ = count;
+					elapsed_ = 0;
+				}
+			}
+			//! install saved hook to l
+			void restore(lua_State* l)const
+			{
+				lua_sethook(l, hook_, mask_, count_);
+			}
+
+			lua_Hook hook()const { return hook_; }
+
+			//! mask of own count hook. other events of previous hook are forwarded
+			int mask()const
+			{
+				return LUA_MASKCOUNT | (hook_ ? (mask_ & ~LUA_MASKCOUNT) : 0);
+			}
+			//! count of own hook, that does not exceed next count event of previous hook
+			int count(int own)const
+			{
+				if (!countEnabled())
+				{
+					return own;
+				}
+				return std::max(1, std::min(own, count_ - elapsed_));
+			}
+
+			/**
+			* @brief pass event to previous hook. Previous hook may raise error.
+			* Own hook must be installed again after this, previous hook may install itself.
+			* @param executed instruction count since last count event of own hook
+			*/
+			void call(lua_State* l, lua_Debug* ar, int executed)
+			{
+				if (!hook_)
+				{
+					return;
+				}
+				if (ar->event != LUA_HOOKCOUNT)
+				{
+					hook_(l, ar);
+					return;
+				}
+				if (!countEnabled())
+				{
+					return;
+				}
+				elapsed_ += executed;
+				if (elapsed_ < count_)
+				{
+					return;
+				}
+				lua_Hook hook = hook_;
+				int elapsed = elapsed_;
+				elapsed_ = 0;
+				lua_sethook(l, hook, mask_, elapsed);
+				hook(l, ar);
+				if (lua_gethook(l) != hook || lua_gethookmask(l) != mask_ || lua_gethookcount(l) != elapsed)
+				{//previous hook installed new hook or count
+					hook_ = lua_gethook(l);
+					mask_ = lua_gethookmask(l);
+					count_ = lua_gethookcount(l);
+				}
+			}
+
+		private:
+			bool countEnabled()const
+			{
+				return hook_ && (mask_ & LUA_MASKCOUNT) && count_ > 0;
+			}
+
+			lua_Hook hook_;
+			int mask_;
+			int count_;
+			int elapsed_;
+		};
+	}
+}
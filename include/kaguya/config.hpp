@@ -44,6 +44,23 @@ extern "C" {
 #include "kaguya/preprocess.hpp"
 
 
+#ifndef KAGUYA_NO_EXCEPTIONS
+#if (defined(__GNUC__) && !defined(__EXCEPTIONS)) || (defined(_MSC_VER) && !defined(_CPPUNWIND))
+//build with -fno-exceptions
+#define KAGUYA_NO_EXCEPTIONS 1
+#else
+#define KAGUYA_NO_EXCEPTIONS 0
+#endif
+#endif
+
+#if KAGUYA_NO_EXCEPTIONS
+//error can not be thrown. report to error handler only
+#undef KAGUYA_ERROR_NO_THROW
+#define KAGUYA_ERROR_NO_THROW 1
+#undef KAGUYA_NO_SET_AT_PANIC
+#define KAGUYA_NO_SET_AT_PANIC 1
+#endif
+
 #ifndef KAGUYA_ERROR_NO_THROW
 #define KAGUYA_ERROR_NO_THROW 1
 #endif
@@ -56,6 +73,15 @@ extern "C" {
 #endif
 #endif
 
+//! max nesting depth of tables walked recursively(deepCopy, serialize). deeper tables fail instead of exhausting the C stack.
+#ifndef KAGUYA_TABLE_MAX_DEPTH
+#define KAGUYA_TABLE_MAX_DEPTH 200
+#endif
+//! max nesting depth of tables written by serialize and read by deserialize
+#ifndef KAGUYA_SERIALIZE_MAX_DEPTH
+#define KAGUYA_SERIALIZE_MAX_DEPTH KAGUYA_TABLE_MAX_DEPTH
+#endif
+
 
 #ifdef KAGUYA_NO_VECTOR_AND_MAP_TO_TABLE
 #define KAGUYA_NO_STD_VECTOR_TO_TABLE
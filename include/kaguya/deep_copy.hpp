@@ -0,0 +1,276 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <string>
+
+#include "kaguya/config.hpp"
+#include "kaguya/utility.hpp"
+#include "kaguya/object.hpp"
+#include "kaguya/error_handler.hpp"
+#include "kaguya/lua_ref.hpp"
+
+namespace kaguya
+{
+	namespace util
+	{
+		/**
+		* @brief copy value between stacks of two Lua states.
+		* Tables are copied recursively, shared and cyclic references are kept.
+		* Userdata are copied by copy function of metatable(@see UserdataMetatable::setCopyFunction).
+		* Table metatables are not copied.
+		* If tables are nested deeper than KAGUYA_TABLE_MAX_DEPTH, copy fails and nil is pushed.
+		*/
+		class DeepCopier
+		{
+		public:
+			DeepCopier(lua_State* from, lua_State* to) :from_(from), to_(to), visited_(0), depth_(0), too_deep_(false), failed_type_(0)
+			{
+			}
+
+			/**
+			* @brief push copy of value at index in from state to top of "to" state.
+			* "from" and "to" must not be same stack.
+			* @return If all values were copied, return true. Otherwise not copyable values replaced to nil and return false.
+			*/
+			bool push(int index)
+			{
+				if (index < 0 && index > LUA_REGISTRYINDEX)
+				{
+					index = lua_gettop(from_) + 1 + index;
+				}
+				lua_checkstack(to_, 2);
+				lua_newtable(to_);//visited map. lightuserdata(source pointer) -> copied value
+				visited_ = lua_gettop(to_);
+				copy(index);
+				lua_remove(to_, visited_);
+				visited_ = 0;
+				if (too_deep_)
+				{//partial copy is not usable
+					lua_pop(to_, 1);
+					lua_pushnil(to_);
+				}
+				return failed_type_ == 0;
+			}
+
+			//! type name of first value that was not copyable. if all copied return 0.
+			const char* failedTypeName()const { return failed_type_; }
+			//! true if failed by table nested deeper than KAGUYA_TABLE_MAX_DEPTH
+			bool nestingTooDeep()const { return too_deep_; }
+
+		private:
+			void fail(int type)
+			{
+				if (!failed_type_)
+				{
+					failed_type_ = lua_typename(from_, type);
+				}
+				lua_pushnil(to_);
+			}
+			bool pushVisited(int index)
+			{
+				lua_pushlightuserdata(to_, const_cast<void*>(lua_topointer(from_, index)));
+				lua_rawget(to_, visited_);
+				if (lua_isnil(to_, -1))
+				{
+					lua_pop(to_, 1);
+					return false;
+				}
+				return true;
+			}
+			void setVisited(int index)
+			{
+				lua_pushlightuserdata(to_, const_cast<void*>(lua_topointer(from_, index)));
+				lua_pushvalue(to_, -2);
+				lua_rawset(to_, visited_);
+			}
+
+			void copy(int index)
+			{
+				int type = lua_type(from_, index);
+				switch (type)
+				{
+				case LUA_TNIL:
+					lua_pushnil(to_);
+					break;
+				case LUA_TBOOLEAN:
+					lua_pushboolean(to_, lua_toboolean(from_, index));
+					break;
+				case LUA_TNUMBER:
+#if LUA_VERSION_NUM >= 503
+					if (lua_isinteger(from_, index))
+					{
+						lua_pushinteger(to_, lua_tointeger(from_, index));
+						break;
+					}
+#endif
+					lua_pushnumber(to_, lua_tonumber(from_, index));
+					break;
+				case LUA_TSTRING:
+				{
+					size_t size = 0;
+					const char* str = lua_tolstring(from_, index, &size);
+					lua_pushlstring(to_, str, size);
+					break;
+				}
+				case LUA_TLIGHTUSERDATA:
+					lua_pushlightuserdata(to_, lua_touserdata(from_, index));
+					break;
+				case LUA_TTABLE:
+					copyTable(index);
+					break;
+				case LUA_TUSERDATA:
+					copyUserdata(index);
+					break;
+				case LUA_TFUNCTION:
+					if (lua_iscfunction(from_, index))
+					{
+						if (!lua_getupvalue(from_, index, 1))
+						{//C function without upvalue is copyable
+							lua_pushcfunction(to_, lua_tocfunction(from_, index));
+							break;
+						}
+						lua_pop(from_, 1);//pop upvalue
+					}
+					fail(type);
+					break;
+				default:
+					fail(type);
+					break;
+				}
+			}
+
+			void copyTable(int index)
+			{
+				if (pushVisited(index))
+				{
+					return;
+				}
+				if (depth_ >= KAGUYA_TABLE_MAX_DEPTH)
+				{
+					too_deep_ = true;
+					fail(LUA_TTABLE);
+					return;
+				}
+				if (!lua_checkstack(from_, 3) || !lua_checkstack(to_, 4))
+				{
+					fail(LUA_TTABLE);
+					return;
+				}
+#if LUA_VERSION_NUM >= 502
+				int array_size = static_cast<int>(lua_rawlen(from_, index));
+#else
+				int array_size = static_cast<int>(lua_objlen(from_, index));
+#endif
+				lua_createtable(to_, array_size, 0);
+				setVisited(index);
+				int table = lua_gettop(to_);
+
+				++depth_;
+				lua_pushnil(from_);
+				while (lua_next(from_, index) != 0)
+				{
+					int value = lua_gettop(from_);
+					copy(value - 1);//key
+					if (lua_isnil(to_, -1))
+					{
+						lua_pop(to_, 1);
+					}
+					else
+					{
+						copy(value);
+						lua_rawset(to_, table);
+					}
+					lua_settop(from_, value - 1);//keep key for next
+				}
+				--depth_;
+			}
+
+			void copyUserdata(int index)
+			{
+				if (pushVisited(index))
+				{
+					return;
+				}
+				class_userdata::copy_function_type copy_function = class_userdata::get_copy_function(from_, index);
+				int top = lua_gettop(to_);
+				if (!copy_function || !copy_function(from_, index, to_))
+				{
+					lua_settop(to_, top);
+					fail(LUA_TUSERDATA);
+					return;
+				}
+				lua_settop(to_, top + 1);
+				setVisited(index);
+			}
+
+			lua_State* from_;
+			lua_State* to_;
+			int visited_;
+			int depth_;
+			bool too_deep_;
+			const char* failed_type_;
+		};
+
+		/**
+		* @brief push deep copy of value at index in from state to top of "to" state.
+		* @return If all values were copied, return true. Otherwise send error message to error handler and return false.
+		*/
+		inline bool deepCopyToStack(lua_State* from, int index, lua_State* to)
+		{
+			if (index < 0 && index > LUA_REGISTRYINDEX)
+			{
+				index = lua_gettop(from) + 1 + index;
+			}
+			bool result = false;
+			const char* failed_type = 0;
+			bool too_deep = false;
+			if (from != to)
+			{
+				DeepCopier copier(from, to);
+				result = copier.push(index);
+				failed_type = copier.failedTypeName();
+				too_deep = copier.nestingTooDeep();
+			}
+			else
+			{
+				//copy to same stack via temporary thread
+				lua_State* thread = lua_newthread(to);
+				DeepCopier copier(from, thread);
+				result = copier.push(index);
+				failed_type = copier.failedTypeName();
+				too_deep = copier.nestingTooDeep();
+				lua_xmove(thread, to, 1);
+				lua_remove(to, -2);//remove thread
+			}
+			if (!result)
+			{
+				except::OtherError(to, too_deep ? std::string("deep copy failed. nesting too deep") : std::string("deep copy failed. can not copy ") + failed_type);
+			}
+			return result;
+		}
+	}
+
+	/**
+	* @brief copy Lua value to other Lua state without conversion to C++ types.
+	* @param to destination state
+	* @param value source value. LuaRef,LuaTable,LuaStackRef etc.
+	* @return reference of copied value in destination state
+	*/
+	template<typename RefType>
+	LuaRef deepCopy(lua_State* to, const RefType& value)
+	{
+		lua_State* from = value.state();
+		if (!from || !to)
+		{
+			return LuaRef(to);
+		}
+		util::ScopedSavedStack save(from);
+		int index = value.pushStackIndex(from);
+		util::deepCopyToStack(from, index, to);
+		return LuaRef(to, StackTop());
+	}
+}
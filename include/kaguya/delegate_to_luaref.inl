@@ -1,8 +1,10 @@
 #ifndef KAGUYA_DELEGATE_FIRST_ARG
 #define KAGUYA_DELEGATE_FIRST_ARG
 #define KAGUYA_DELEGATE_FIRST_ARG_C
+#define KAGUYA_DELEGATE_C_FIRST_ARG
 #else
 #define KAGUYA_DELEGATE_FIRST_ARG_C KAGUYA_DELEGATE_FIRST_ARG,
+#define KAGUYA_DELEGATE_C_FIRST_ARG ,KAGUYA_DELEGATE_FIRST_ARG
 #endif
 
 #if KAGUYA_USE_CPP11
@@ -17,6 +19,12 @@
 		{
 			return KAGUYA_DELEGATE_LUAREF.call<Result>(KAGUYA_DELEGATE_FIRST_ARG_C std::forward<Args>(args)...);
 		}
+
+		template<class Results, class... Args>
+		void callInto(Results results, Args&&... args)
+		{
+			KAGUYA_DELEGATE_LUAREF.callInto(results, KAGUYA_DELEGATE_FIRST_ARG_C std::forward<Args>(args)...);
+		}
 #else
 
 #define KAGUYA_PP_TEMPLATE(N) KAGUYA_PP_CAT(typename A,N)
@@ -58,14 +66,30 @@
 		}
 		KAGUYA_PP_REPEAT_DEF(9, KAGUYA_CALL_DEF)
 
+#define KAGUYA_CALL_INTO_DEF(N) \
+		template<class Results,KAGUYA_PP_REPEAT_ARG(N,KAGUYA_PP_TEMPLATE)> \
+		void callInto(Results results,KAGUYA_PP_REPEAT_ARG(N,KAGUYA_PP_FARG))\
+		{\
+			KAGUYA_DELEGATE_LUAREF.callInto(results, KAGUYA_DELEGATE_FIRST_ARG_C KAGUYA_PP_REPEAT_ARG(N, KAGUYA_PUSH_ARG_DEF));\
+		}
+
+		template<class Results>
+		void callInto(Results results)
+		{
+			KAGUYA_DELEGATE_LUAREF.callInto(results KAGUYA_DELEGATE_C_FIRST_ARG);
+		}
+		KAGUYA_PP_REPEAT_DEF(9, KAGUYA_CALL_INTO_DEF)
+
 #undef KAGUYA_PP_TEMPLATE
 #undef KAGUYA_PP_FARG
 #undef KAGUYA_PUSH_ARG_DEF
 #undef KAGUYA_OP_FN_DEF
 #undef KAGUYA_CALL_DEF
+#undef KAGUYA_CALL_INTO_DEF
 #undef KAGUYA_RESUME_DEF
 #endif
 			
 #undef KAGUYA_DELEGATE_FIRST_ARG
 #undef KAGUYA_DELEGATE_FIRST_ARG_C
+#undef KAGUYA_DELEGATE_C_FIRST_ARG
 
@@ -89,6 +89,37 @@ namespace kaguya
 			return FunctionResultProxy::ReturnValue(state, result, argstart, types::typetag<Result>());
 		}
 
+		/**
+		* @brief call function and assign results to existing variables, without FunctionResults or tuple construction.
+		* e.g.
+		* @code
+		* double x, y, z;
+		* fn.callInto(kaguya::tie(x, y, z), body);
+		* @endcode
+		* @param results variables bound by kaguya::tie
+		*/
+		template<class Results, class...Args> void callInto(Results results, Args&&... args)
+		{
+			lua_State* state = state_();
+			if (!state)
+			{
+				except::typeMismatchError(state, "is nil");
+				return;
+			}
+			util::ScopedSavedStack save(state);
+			int argstart = lua_gettop(state) + 1;
+			push_(state);
+			int argnum = util::push_args(state, std::forward<Args>(args)...);
+			int result = lua_pcall_wrap(state, argnum, Results::size);
+			except::checkErrorAndThrow(result, state);
+			if (result == 0)//LUA_OK
+			{
+				//lua_pcall_wrap may return all results. adjust to Results::size
+				lua_settop(state, argstart + Results::size - 1);
+				results.assign_results(state, argstart);
+			}
+		}
+
 		template<class...Args> FunctionResults operator()(Args&&... args);
 #else
 
@@ -117,6 +148,35 @@ namespace kaguya
 		KAGUYA_CALL_DEF(0)
 			KAGUYA_PP_REPEAT_DEF(9, KAGUYA_CALL_DEF)
 
+#define KAGUYA_PP_FARG_CONCAT(N) ,const KAGUYA_PP_CAT(A,N)& KAGUYA_PP_CAT(a,N)
+#define KAGUYA_CALL_INTO_DEF(N) \
+		template<class Results KAGUYA_PP_REPEAT(N,KAGUYA_PP_TEMPLATE)>\
+		void callInto(Results results KAGUYA_PP_REPEAT(N,KAGUYA_PP_FARG_CONCAT))\
+		{\
+			lua_State* state = state_();\
+			if (!state)\
+			{\
+				except::typeMismatchError(state, "is nil");\
+				return;\
+			}\
+			util::ScopedSavedStack save(state);\
+			int argstart = lua_gettop(state) + 1;\
+			push_(state);\
+			int argnum = util::push_args(state KAGUYA_PP_REPEAT(N,KAGUYA_PUSH_ARG_DEF));\
+			int result = lua_pcall_wrap(state, argnum, Results::size);\
+			except::checkErrorAndThrow(result, state);\
+			if (result == 0)\
+			{\
+				lua_settop(state, argstart + Results::size - 1);\
+				results.assign_results(state, argstart);\
+			}\
+		}
+
+		KAGUYA_CALL_INTO_DEF(0)
+			KAGUYA_PP_REPEAT_DEF(9, KAGUYA_CALL_INTO_DEF)
+
+#undef KAGUYA_CALL_INTO_DEF
+#undef KAGUYA_PP_FARG_CONCAT
 
 #undef KAGUYA_PUSH_DEF
 #undef KAGUYA_PUSH_ARG_DEF
@@ -194,6 +254,10 @@ namespace kaguya
 			}
 			util::push_args(thread, std::forward<Args>(args)...);
 			int argnum = lua_gettop(thread) - argstart;
+			if (lua_status(thread) == LUA_YIELD)
+			{
+				argnum += 1;//argstart is first argument on resume from yield
+			}
 			int result = util::lua_resume_compat(thread, argnum);
 			except::checkErrorAndThrow(result, thread);
 			return FunctionResultProxy::ReturnValue(thread, result, argstart, types::typetag<Result>());
@@ -226,6 +290,10 @@ namespace kaguya
 			}\
 			util::push_args(thread KAGUYA_PP_REPEAT(N, KAGUYA_PUSH_ARG_DEF));\
 			int argnum = lua_gettop(thread) - argstart;\
+			if (lua_status(thread) == LUA_YIELD)\
+			{\
+				argnum += 1;\
+			}\
 			int result = util::lua_resume_compat(thread, argnum);\
 			except::checkErrorAndThrow(result, thread);\
 			return FunctionResultProxy::ReturnValue(thread,result, argstart, types::typetag<Result>());\
@@ -366,6 +366,151 @@ namespace kaguya
 			setField(key.c_str(), std::forward<V>(value));
 		}
 #endif
+
+		/**
+		* @name raw access
+		* @brief access without metamethods.
+		*/
+		//@{
+		/**
+		* @brief value = rawget(table,key);
+		*/
+		template<typename T, typename K>
+		typename lua_type_traits<T>::get_type rawGet(const K& key)const
+		{
+			lua_State* state = state_();
+			if (!state)
+			{
+				except::typeMismatchError(state, "is nil");
+				return typename lua_type_traits<T>::get_type();
+			}
+			util::ScopedSavedStack save(state);
+			int stackIndex = pushRawTable(state);
+			if (!stackIndex)
+			{
+				return typename lua_type_traits<T>::get_type();
+			}
+			util::one_push(state, key);//push table key
+			lua_rawget(state, stackIndex);
+			return lua_type_traits<T>::get(state, -1);
+		}
+		/**
+		* @brief value = rawget(table,index);
+		*/
+		template<typename T>
+		typename lua_type_traits<T>::get_type rawGetIndex(int index)const
+		{
+			lua_State* state = state_();
+			if (!state)
+			{
+				except::typeMismatchError(state, "is nil");
+				return typename lua_type_traits<T>::get_type();
+			}
+			util::ScopedSavedStack save(state);
+			int stackIndex = pushRawTable(state);
+			if (!stackIndex)
+			{
+				return typename lua_type_traits<T>::get_type();
+			}
+			lua_rawgeti(state, stackIndex, index);
+			return lua_type_traits<T>::get(state, -1);
+		}
+		/**
+		* @brief rawset(table,key,value);
+		*/
+		template<typename K, typename V>
+		void rawSet(const K& key, const V& value)
+		{
+			lua_State* state = state_();
+			if (!state)
+			{
+				except::typeMismatchError(state, "is nil");
+				return;
+			}
+			util::ScopedSavedStack save(state);
+			int stackIndex = pushRawTable(state);
+			if (!stackIndex)
+			{
+				return;
+			}
+			util::one_push(state, key);//push table key
+			util::one_push(state, value);//push value
+			lua_rawset(state, stackIndex);
+		}
+		/**
+		* @brief rawset(table,index,value);
+		*/
+		template<typename V>
+		void rawSetIndex(int index, const V& value)
+		{
+			lua_State* state = state_();
+			if (!state)
+			{
+				except::typeMismatchError(state, "is nil");
+				return;
+			}
+			util::ScopedSavedStack save(state);
+			int stackIndex = pushRawTable(state);
+			if (!stackIndex)
+			{
+				return;
+			}
+			util::one_push(state, value);//push value
+			lua_rawseti(state, stackIndex, index);
+		}
+#if KAGUYA_USE_CPP11
+		template<typename K, typename V>
+		void rawSet(K&& key, V&& value)
+		{
+			lua_State* state = state_();
+			if (!state)
+			{
+				except::typeMismatchError(state, "is nil");
+				return;
+			}
+			util::ScopedSavedStack save(state);
+			int stackIndex = pushRawTable(state);
+			if (!stackIndex)
+			{
+				return;
+			}
+			util::one_push(state, std::forward<K>(key));//push table key
+			util::one_push(state, std::forward<V>(value));//push value
+			lua_rawset(state, stackIndex);
+		}
+		template<typename V>
+		void rawSetIndex(int index, V&& value)
+		{
+			lua_State* state = state_();
+			if (!state)
+			{
+				except::typeMismatchError(state, "is nil");
+				return;
+			}
+			util::ScopedSavedStack save(state);
+			int stackIndex = pushRawTable(state);
+			if (!stackIndex)
+			{
+				return;
+			}
+			util::one_push(state, std::forward<V>(value));//push value
+			lua_rawseti(state, stackIndex, index);
+		}
+#endif
+		//@}
+
+	private:
+		//! push table and return stack index. if not table, send error message to error handler and return 0
+		int pushRawTable(lua_State* state)const
+		{
+			int stackIndex = pushStackIndex_(state);
+			if (lua_type(state, stackIndex) != LUA_TTABLE)
+			{
+				except::typeMismatchError(state, "is not table");
+				return 0;
+			}
+			return stackIndex;
+		}
 	};
 
 }
\ No newline at end of file
@@ -9,6 +9,7 @@
 
 #include "kaguya/config.hpp"
 #include "kaguya/type.hpp"
+#include "kaguya/execution_limit.hpp"
 
 
 #define KAGUYA_ERROR_HANDLER_METATABLE "error_handler_kaguya_metatype"
@@ -31,6 +32,10 @@ namespace kaguya
 	inline int lua_pcall_wrap(lua_State* state, int argnum, int retnum)
 	{
 		int result = lua_pcall(state, argnum, retnum, 0);
+		if (result != 0)
+		{
+			return ScopedExecutionLimit::errorStatus(state, result);
+		}
 		return result;
 	}
 #else
@@ -52,7 +57,7 @@ namespace kaguya
 		}
 		catch (const LuaException& e)
 		{
-			return LUA_ERRRUN;
+			return ScopedExecutionLimit::errorStatus(state, LUA_ERRRUN);
 //			return e.status();//status not changed at luajit 2.0.4
 		}
 		return lua_status(state);
@@ -126,9 +131,9 @@ namespace kaguya
 					lua_setfield(state, -2, "__gc");
 					lua_setfield(state, -1, "__index");
 					void* ptr = lua_newuserdata(state, sizeof(function_type));//dummy data for gc call
-					if (!ptr) { throw std::runtime_error("critical error. maybe failed memory allocation"); }//critical error
+					if (!ptr) { KAGUYA_THROW(std::runtime_error("critical error. maybe failed memory allocation")); }//critical error
 					function_type* funptr = new(ptr) function_type();
-					if (!funptr) { throw std::runtime_error("critical error. maybe failed memory allocation"); }//critical error
+					if (!funptr) { KAGUYA_THROW(std::runtime_error("critical error. maybe failed memory allocation")); }//critical error
 					class_userdata::setmetatable<function_type>(state);
 					lua_settable(state, LUA_REGISTRYINDEX);
 					*funptr = f;
@@ -213,6 +218,9 @@ namespace kaguya
 				case LUA_ERRERR:
 					message = lua_tostring(state, -1);
 					throw LuaRunningError(status, message ? std::string(message) : "unknown error");
+				case KAGUYA_ERRLIMIT:
+					message = lua_tostring(state, -1);
+					throw LuaExecutionLimitError(status, message ? std::string(message) : "execution limit exceeded");
 				case LUA_ERRGCMM:
 					message = lua_tostring(state, -1);
 					throw LuaGCError(status, message ? std::string(message) : "unknown gc error");
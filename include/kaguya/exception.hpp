@@ -6,6 +6,10 @@
 #pragma once
 
 #include <exception>
+#if KAGUYA_NO_EXCEPTIONS
+#include <cstdio>
+#include <cstdlib>
+#endif
 
 #include "kaguya/utility.hpp"
 
@@ -61,6 +65,11 @@ namespace kaguya
 		LuaGCError(int status, const char* what)throw() :LuaException(status, what) {}
 		LuaGCError(int status, const std::string& what) :LuaException(status, what) {}
 	};
+	class LuaExecutionLimitError :public LuaException {
+	public:
+		LuaExecutionLimitError(int status, const char* what)throw() :LuaException(status, what) {}
+		LuaExecutionLimitError(int status, const std::string& what) :LuaException(status, what) {}
+	};
 	class LuaUnknownError :public LuaException {
 	public:
 		LuaUnknownError(int status, const char* what)throw() :LuaException(status, what) {}
@@ -78,4 +87,18 @@ namespace kaguya
 	};
 #endif
 
+#if KAGUYA_NO_EXCEPTIONS
+	namespace except
+	{
+		//! exception can not be thrown. print message and abort.
+		inline void abortByException(const std::exception& e)
+		{
+			std::fprintf(stderr, "kaguya: %s\n", e.what());
+			std::abort();
+		}
+	}
+#define KAGUYA_THROW(EXCEPTION) ::kaguya::except::abortByException(EXCEPTION)
+#else
+#define KAGUYA_THROW(EXCEPTION) throw EXCEPTION
+#endif
 }
@@ -0,0 +1,211 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstddef>
+#include "kaguya/config.hpp"
+#include "kaguya/utility.hpp"
+
+#if KAGUYA_USE_CPP11
+#include <chrono>
+#endif
+
+//! status code of the call aborted by ExecutionLimit
+#define KAGUYA_ERRLIMIT 16
+
+namespace kaguya
+{
+	/**
+	* @brief limits of one call. Zero is unlimited.
+	*/
+	struct ExecutionLimit
+	{
+		ExecutionLimit() :instructions(0)
+#if KAGUYA_USE_CPP11
+			, timeout(0)
+#endif
+		{
+		}
+
+		//! max number of VM instructions
+		size_t instructions;
+		ExecutionLimit& setInstructions(size_t count)
+		{
+			instructions = count;
+			return *this;
+		}
+
+#if KAGUYA_USE_CPP11
+		//! wall clock time from start of the scope
+		std::chrono::steady_clock::duration timeout;
+		template<class Rep, class Period>
+		ExecutionLimit& setTimeout(const std::chrono::duration<Rep, Period>& duration)
+		{
+			timeout = std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration);
+			return *this;
+		}
+#endif
+	};
+
+	/**
+	* @brief apply ExecutionLimit to Lua calls on the state while this object is alive.
+	* Limits are checked by instruction count hook. Exceeded call is aborted by Lua error with status KAGUYA_ERRLIMIT,
+	* and every Lua instruction after that raises the error again, so pcall in the script can not continue running.
+	* Time spent in C/C++ functions is counted to timeout, but can not be interrupted.
+	* Coroutines created in the scope inherit the limit. Innermost scope is used if nested.
+	* TimeSliceScheduler and Profiler call this hook from their own hook.
+	* Other hooks installed in the scope must be removed before the scope ends.
+	*/
+	class ScopedExecutionLimit
+	{
+	public:
+		ScopedExecutionLimit(lua_State* state, const ExecutionLimit& limit) :state_(state), limit_(limit), executed_(0), exceeded_(false), message_(0)
+			, prev_hook_(lua_gethook(state)), prev_mask_(lua_gethookmask(state)), prev_count_(lua_gethookcount(state)), prev_scope_(get(state))
+		{
+#if KAGUYA_USE_CPP11
+			deadline_ = std::chrono::steady_clock::now() + limit_.timeout;
+#endif
+			set(state_, this);
+			if (limited())
+			{
+				lua_sethook(state_, &countHook, LUA_MASKCOUNT, nextCount());
+			}
+		}
+		~ScopedExecutionLimit()
+		{
+			lua_sethook(state_, prev_hook_, prev_mask_, prev_count_);
+			set(state_, prev_scope_);
+		}
+
+		//! number of instructions executed in this scope. counted by check interval
+		size_t executedInstructions()const { return executed_; }
+		//! the limit was exceeded
+		bool exceeded()const { return exceeded_; }
+
+		/**
+		* @brief convert error status of the call
+		* @return If the call is aborted by the limit, return KAGUYA_ERRLIMIT. Otherwise return status.
+		*/
+		static int errorStatus(lua_State* state, int status)
+		{
+			if (status != LUA_ERRRUN)
+			{
+				return status;
+			}
+			ScopedExecutionLimit* scope = get(state);
+			return (scope && scope->exceeded_) ? KAGUYA_ERRLIMIT : status;
+		}
+
+	private:
+		//! instruction count between checks of timeout
+		static const int CHECK_INTERVAL = 1000;
+
+		static void* registryKey()
+		{
+			static char key;
+			return &key;
+		}
+		static ScopedExecutionLimit* get(lua_State* state)
+		{
+			util::ScopedSavedStack save(state);
+			lua_pushlightuserdata(state, registryKey());
+			lua_rawget(state, LUA_REGISTRYINDEX);
+			return static_cast<ScopedExecutionLimit*>(lua_touserdata(state, -1));
+		}
+		static void set(lua_State* state, ScopedExecutionLimit* scope)
+		{
+			util::ScopedSavedStack save(state);
+			lua_pushlightuserdata(state, registryKey());
+			if (scope)
+			{
+				lua_pushlightuserdata(state, scope);
+			}
+			else
+			{
+				lua_pushnil(state);
+			}
+			lua_rawset(state, LUA_REGISTRYINDEX);
+		}
+
+		bool limited()const
+		{
+#if KAGUYA_USE_CPP11
+			if (limit_.timeout.count() > 0)
+			{
+				return true;
+			}
+#endif
+			return limit_.instructions > 0;
+		}
+		int nextCount()const
+		{
+			if (limit_.instructions > 0 && limit_.instructions - executed_ < size_t(CHECK_INTERVAL))
+			{
+				return int(limit_.instructions - executed_);
+			}
+			return CHECK_INTERVAL;
+		}
+		const char* check(int count)
+		{
+			executed_ += size_t(count);
+			if (limit_.instructions > 0 && executed_ >= limit_.instructions)
+			{
+				return "execution limit exceeded: instruction count";
+			}
+#if KAGUYA_USE_CPP11
+			if (limit_.timeout.count() > 0 && std::chrono::steady_clock::now() >= deadline_)
+			{
+				return "execution limit exceeded: timeout";
+			}
+#endif
+			return 0;
+		}
+
+		static void countHook(lua_State* l, lua_Debug* ar)
+		{
+			if (ar->event != LUA_HOOKCOUNT)
+			{
+				return;
+			}
+			ScopedExecutionLimit* scope = get(l);
+			if (!scope)
+			{
+				//coroutine created in the scope, and resumed after the scope.
+				lua_sethook(l, 0, 0, 0);
+				return;
+			}
+			if (!scope->exceeded_)
+			{
+				const char* message = scope->check(lua_gethookcount(l));
+				if (!message)
+				{
+					lua_sethook(l, &countHook, LUA_MASKCOUNT, scope->nextCount());
+					return;
+				}
+				scope->exceeded_ = true;
+				scope->message_ = message;
+			}
+			lua_sethook(l, &countHook, LUA_MASKCOUNT, 1);
+			luaL_error(l, "%s", scope->message_);
+		}
+
+		ScopedExecutionLimit(const ScopedExecutionLimit&);
+		ScopedExecutionLimit& operator=(const ScopedExecutionLimit&);
+
+		lua_State* state_;
+		ExecutionLimit limit_;
+		size_t executed_;
+		bool exceeded_;
+		const char* message_;
+#if KAGUYA_USE_CPP11
+		std::chrono::steady_clock::time_point deadline_;
+#endif
+		lua_Hook prev_hook_;
+		int prev_mask_;
+		int prev_count_;
+		ScopedExecutionLimit* prev_scope_;
+	};
+}
@@ -0,0 +1,246 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "kaguya/config.hpp"
+#include "kaguya/lua_ref.hpp"
+#include "kaguya/lua_ref_table.hpp"
+#include "kaguya/lua_ref_function.hpp"
+
+namespace kaguya
+{
+	/**
+	* @brief prepared reference to global field by dotted path. e.g. "config.limits.rate"
+	* Path is split once, and each access walks the path with prepared keys, so read, write and call follow replaced intermediate table.
+	* The table that holds the field is also kept in registry. getCached() reads it without walking the path,
+	* and it is stale after intermediate table was replaced until refresh().
+	*/
+	class FieldPath : public LuaVariantImpl<FieldPath>
+	{
+	public:
+		FieldPath() :state_(0)
+		{
+		}
+		FieldPath(lua_State* state, const std::string& path) :state_(state), path_(path)
+		{
+			std::string::size_type begin = 0;
+			std::string::size_type end = 0;
+			while ((end = path.find('.', begin)) != std::string::npos)
+			{
+				parents_.push_back(path.substr(begin, end - begin));
+				begin = end + 1;
+			}
+			field_ = path.substr(begin);
+			refresh();
+		}
+
+		/**
+		* @brief resolve path again.
+		* @return If table that holds the field exists, return true.
+		*/
+		bool refresh()const
+		{
+			if (!state_)
+			{
+				return false;
+			}
+			util::ScopedSavedStack save(state_);
+			if (!pushTableFromGlobal(state_))
+			{
+				table_ = LuaRef();
+				return false;
+			}
+			table_ = LuaRef(state_, StackTop());
+			return true;
+		}
+
+		/**
+		* @brief check cached table is same as table that path refers now. This walks whole path.
+		* @return If intermediate table was replaced, return true.
+		*/
+		bool isStale()const
+		{
+			if (!state_)
+			{
+				return false;
+			}
+			util::ScopedSavedStack save(state_);
+			bool exists = pushTableFromGlobal(state_);
+			if (!exists || table_.isNilref())
+			{
+				return exists != !table_.isNilref();
+			}
+			table_.push(state_);
+			return !lua_rawequal(state_, -1, -2);
+		}
+
+		/**
+		* @brief resolve path and replace cached table if intermediate table was replaced.
+		* @return If table that holds the field exists, return true.
+		*/
+		bool validate()const
+		{
+			if (!state_)
+			{
+				return false;
+			}
+			util::ScopedSavedStack save(state_);
+			if (!pushTableFromGlobal(state_))
+			{
+				table_ = LuaRef();
+				return false;
+			}
+			if (!table_.isNilref())
+			{
+				table_.push(state_);
+				if (lua_rawequal(state_, -1, -2))
+				{
+					return true;
+				}
+				lua_pop(state_, 1);
+			}
+			table_ = LuaRef(state_, StackTop());
+			return true;
+		}
+
+		//! dotted path string
+		const std::string& path()const { return path_; }
+
+		//! cached table that holds the field.
+		const LuaRef& table()const { return table_; }
+
+		/**
+		* @brief get field of cached table without walking the path. one rawgeti and one field access.
+		* If intermediate table was replaced after refresh, return value of old table. @see isStale
+		*/
+		template<typename T>
+		typename lua_type_traits<T>::get_type getCached()const
+		{
+			util::ScopedSavedStack save(state_);
+			if (table_.isNilref() && !refresh())
+			{
+				lua_pushnil(state_);
+			}
+			else
+			{
+				pushField(state_);
+			}
+			return lua_type_traits<T>::get(state_, -1);
+		}
+
+		lua_State* state()const { return state_; }
+
+		bool isNilref()const
+		{
+			if (!state_)
+			{
+				return true;
+			}
+			util::ScopedSavedStack save(state_);
+			return lua_isnoneornil(state_, pushStackIndex(state_));
+		}
+
+		//! push field value with resolving path.
+		int push(lua_State* state)const
+		{
+			pushStackIndex(state);
+			return 1;
+		}
+		int push()const
+		{
+			return push(state_);
+		}
+		//! push field value with resolving path. used by read
+		int pushStackIndex(lua_State* state)const
+		{
+			if (!pushTableFromGlobal(state))
+			{
+				lua_pop(state, 1);
+				lua_pushnil(state);
+			}
+			else
+			{
+				lua_getfield(state, -1, field_.c_str());
+				lua_remove(state, -2);
+			}
+			return lua_gettop(state);
+		}
+
+		/**
+		* @brief assign value to field. path is resolved again, so value is not written to replaced table.
+		* @return If table that holds the field exists, return true.
+		*/
+		template<typename T>
+		bool set(const T& value)const
+		{
+			util::ScopedSavedStack save(state_);
+			if (!pushTableFromGlobal(state_))
+			{
+				except::typeMismatchError(state_, path_ + " is not table field");
+				return false;
+			}
+			table_proxy::set(state_, lua_gettop(state_), field_, value);
+			return true;
+		}
+
+		//! assign value to field. same as set(value)
+		template<typename T>
+		const FieldPath& operator=(const T& value)const
+		{
+			set(value);
+			return *this;
+		}
+
+	private:
+		int pushField(lua_State* state)const
+		{
+			table_.push(state);
+			lua_getfield(state, -1, field_.c_str());
+			lua_remove(state, -2);
+			return 1;
+		}
+		bool pushTableFromGlobal(lua_State* state)const
+		{
+			lua_type_traits<GlobalTable>::push(state, GlobalTable());
+			for (std::vector<std::string>::const_iterator it = parents_.begin(); it != parents_.end(); ++it)
+			{
+				lua_getfield(state, -1, it->c_str());
+				lua_remove(state, -2);
+				if (lua_type(state, -1) != LUA_TTABLE)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		lua_State* state_;
+		std::string path_;
+		std::vector<std::string> parents_;
+		std::string field_;
+		mutable LuaRef table_;
+	};
+
+	template<>
+	struct lua_type_traits<FieldPath> {
+		static int push(lua_State* l, const FieldPath& ref)
+		{
+			return ref.push(l);
+		}
+	};
+
+	inline std::ostream& operator<<(std::ostream& os, const FieldPath& ref)
+	{
+		lua_State* state = ref.state();
+		util::ScopedSavedStack save(state);
+		int stackIndex = ref.pushStackIndex(state);
+		util::stackValueDump(os, state, stackIndex);
+		return os;
+	}
+}
@@ -0,0 +1,180 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "kaguya/config.hpp"
+
+#if KAGUYA_USE_CPP11
+#include <deque>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "kaguya/utility.hpp"
+
+namespace kaguya
+{
+	/**
+	* @brief drive incremental garbage collection within time budget, and record pauses.
+	* e.g. call step(std::chrono::microseconds(500)) between frames or requests.
+	* If setAutomatic(false), the collector runs only in this driver.
+	*/
+	class GCDriver
+	{
+	public:
+		//! one finished collection cycle
+		struct Cycle
+		{
+			Cycle() :steps(0), pause(0), maxPause(0), freedBytes(0) {}
+			size_t steps;//!< number of step or collect calls in the cycle
+			std::chrono::nanoseconds pause;//!< total time in the cycle
+			std::chrono::nanoseconds maxPause;
+			size_t freedBytes;
+		};
+		struct Stats
+		{
+			Stats() :pauses(0), cycles(0), totalPause(0), maxPause(0), freedBytes(0) {}
+			size_t pauses;//!< number of step or collect calls
+			size_t cycles;
+			std::chrono::nanoseconds totalPause;
+			std::chrono::nanoseconds maxPause;
+			size_t freedBytes;
+		};
+
+		/**
+		* @param state lua_State
+		* @param history max number of recent pauses and cycles to keep
+		*/
+		explicit GCDriver(lua_State* state, size_t history = 1024) :state_(util::toMainThread(state)), history_(history), step_size_(0)
+		{
+		}
+
+		/**
+		* @brief run incremental steps until the budget is spent or a cycle is finished.
+		* At least one step runs, so the pause may exceed the budget by one step.
+		* @return If a cycle is finished, return true.
+		*/
+		template<class Rep, class Period>
+		bool step(const std::chrono::duration<Rep, Period>& budget)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			std::chrono::steady_clock::time_point end = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(budget);
+			size_t before = usedBytes();
+			bool finished = false;
+			std::chrono::steady_clock::time_point now;
+			do
+			{
+				finished = lua_gc(state_, LUA_GCSTEP, step_size_) == 1;
+				now = std::chrono::steady_clock::now();
+			} while (!finished && now < end);
+			record(now - start, before, finished);
+			return finished;
+		}
+
+		//! performs a full garbage-collection cycle and record it.
+		void collect()
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			size_t before = usedBytes();
+			lua_gc(state_, LUA_GCCOLLECT, 0);
+			record(std::chrono::steady_clock::now() - start, before, true);
+		}
+
+		/**
+		* @brief enable or disable the collector running in allocation.
+		* If false, garbage is collected only by step or collect.
+		*/
+		void setAutomatic(bool automatic)
+		{
+			lua_gc(state_, automatic ? LUA_GCRESTART : LUA_GCSTOP, 0);
+		}
+
+		//! work size(KBytes) of one incremental step. 0 is smallest step.
+		int stepSize()const { return step_size_; }
+		void setStepSize(int kbytes) { step_size_ = kbytes; }
+
+		//! total memory in use by Lua in bytes
+		size_t usedBytes()const
+		{
+			return size_t(lua_gc(state_, LUA_GCCOUNT, 0)) * 1024 + size_t(lua_gc(state_, LUA_GCCOUNTB, 0));
+		}
+
+		const Stats& stats()const { return stats_; }
+		//! recent pause durations, oldest first
+		const std::deque<std::chrono::nanoseconds>& pauses()const { return pauses_; }
+		//! recent finished cycles, oldest first
+		const std::deque<Cycle>& cycles()const { return cycles_; }
+
+		/**
+		* @brief pause duration at percentile of recent pauses
+		* @param p percentile 0.0 - 1.0
+		*/
+		std::chrono::nanoseconds pausePercentile(double p)const
+		{
+			if (pauses_.empty())
+			{
+				return std::chrono::nanoseconds(0);
+			}
+			std::vector<std::chrono::nanoseconds> sorted(pauses_.begin(), pauses_.end());
+			size_t index = std::min(size_t(p * sorted.size()), sorted.size() - 1);
+			std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+			return sorted[index];
+		}
+
+		void clear()
+		{
+			stats_ = Stats();
+			current_ = Cycle();
+			pauses_.clear();
+			cycles_.clear();
+		}
+
+	private:
+		void record(std::chrono::steady_clock::duration elapsed, size_t before, bool finished)
+		{
+			std::chrono::nanoseconds pause = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed);
+			size_t after = usedBytes();
+			size_t freed = before > after ? before - after : 0;
+
+			stats_.pauses++;
+			stats_.totalPause += pause;
+			stats_.maxPause = std::max(stats_.maxPause, pause);
+			stats_.freedBytes += freed;
+			pauses_.push_back(pause);
+			if (pauses_.size() > history_)
+			{
+				pauses_.pop_front();
+			}
+
+			current_.steps++;
+			current_.pause += pause;
+			current_.maxPause = std::max(current_.maxPause, pause);
+			current_.freedBytes += freed;
+			if (finished)
+			{
+				stats_.cycles++;
+				cycles_.push_back(current_);
+				if (cycles_.size() > history_)
+				{
+					cycles_.pop_front();
+				}
+				current_ = Cycle();
+			}
+		}
+
+		GCDriver(const GCDriver&);
+		GCDriver& operator=(const GCDriver&);
+
+		lua_State* state_;
+		size_t history_;
+		int step_size_;
+		Stats stats_;
+		Cycle current_;
+		std::deque<std::chrono::nanoseconds> pauses_;
+		std::deque<Cycle> cycles_;
+	};
+}
+#endif
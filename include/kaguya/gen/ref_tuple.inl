@@ -11,6 +11,10 @@ struct ref_tuple1
     using standard::get;
     v0 =get<0>(fres);
   }
+  void assign_results(lua_State* state, int index)
+  {
+    v0 = lua_type_traits<T0>::get(state, index);
+  }
 };
 
 template<class T0,class T1>
@@ -26,6 +30,11 @@ struct ref_tuple2
     v0 =get<0>(fres);
     v1 =get<1>(fres);
   }
+  void assign_results(lua_State* state, int index)
+  {
+    v0 = lua_type_traits<T0>::get(state, index);
+    v1 = lua_type_traits<T1>::get(state, index + 1);
+  }
 };
 
 template<class T0,class T1,class T2>
@@ -42,6 +51,12 @@ struct ref_tuple3
     v1 =get<1>(fres);
     v2 =get<2>(fres);
   }
+  void assign_results(lua_State* state, int index)
+  {
+    v0 = lua_type_traits<T0>::get(state, index);
+    v1 = lua_type_traits<T1>::get(state, index + 1);
+    v2 = lua_type_traits<T2>::get(state, index + 2);
+  }
 };
 
 template<class T0,class T1,class T2,class T3>
@@ -59,6 +74,13 @@ struct ref_tuple4
     v2 =get<2>(fres);
     v3 =get<3>(fres);
   }
+  void assign_results(lua_State* state, int index)
+  {
+    v0 = lua_type_traits<T0>::get(state, index);
+    v1 = lua_type_traits<T1>::get(state, index + 1);
+    v2 = lua_type_traits<T2>::get(state, index + 2);
+    v3 = lua_type_traits<T3>::get(state, index + 3);
+  }
 };
 
 template<class T0,class T1,class T2,class T3,class T4>
@@ -77,6 +99,14 @@ struct ref_tuple5
     v3 =get<3>(fres);
     v4 =get<4>(fres);
   }
+  void assign_results(lua_State* state, int index)
+  {
+    v0 = lua_type_traits<T0>::get(state, index);
+    v1 = lua_type_traits<T1>::get(state, index + 1);
+    v2 = lua_type_traits<T2>::get(state, index + 2);
+    v3 = lua_type_traits<T3>::get(state, index + 3);
+    v4 = lua_type_traits<T4>::get(state, index + 4);
+  }
 };
 
 template<class T0,class T1,class T2,class T3,class T4,class T5>
@@ -96,6 +126,15 @@ struct ref_tuple6
     v4 =get<4>(fres);
     v5 =get<5>(fres);
   }
+  void assign_results(lua_State* state, int index)
+  {
+    v0 = lua_type_traits<T0>::get(state, index);
+    v1 = lua_type_traits<T1>::get(state, index + 1);
+    v2 = lua_type_traits<T2>::get(state, index + 2);
+    v3 = lua_type_traits<T3>::get(state, index + 3);
+    v4 = lua_type_traits<T4>::get(state, index + 4);
+    v5 = lua_type_traits<T5>::get(state, index + 5);
+  }
 };
 
 template<class T0,class T1,class T2,class T3,class T4,class T5,class T6>
@@ -116,6 +155,16 @@ struct ref_tuple7
     v5 =get<5>(fres);
     v6 =get<6>(fres);
   }
+  void assign_results(lua_State* state, int index)
+  {
+    v0 = lua_type_traits<T0>::get(state, index);
+    v1 = lua_type_traits<T1>::get(state, index + 1);
+    v2 = lua_type_traits<T2>::get(state, index + 2);
+    v3 = lua_type_traits<T3>::get(state, index + 3);
+    v4 = lua_type_traits<T4>::get(state, index + 4);
+    v5 = lua_type_traits<T5>::get(state, index + 5);
+    v6 = lua_type_traits<T6>::get(state, index + 6);
+  }
 };
 
 template<class T0,class T1,class T2,class T3,class T4,class T5,class T6,class T7>
@@ -137,6 +186,17 @@ struct ref_tuple8
     v6 =get<6>(fres);
     v7 =get<7>(fres);
   }
+  void assign_results(lua_State* state, int index)
+  {
+    v0 = lua_type_traits<T0>::get(state, index);
+    v1 = lua_type_traits<T1>::get(state, index + 1);
+    v2 = lua_type_traits<T2>::get(state, index + 2);
+    v3 = lua_type_traits<T3>::get(state, index + 3);
+    v4 = lua_type_traits<T4>::get(state, index + 4);
+    v5 = lua_type_traits<T5>::get(state, index + 5);
+    v6 = lua_type_traits<T6>::get(state, index + 6);
+    v7 = lua_type_traits<T7>::get(state, index + 7);
+  }
 };
 
 template<class T0,class T1,class T2,class T3,class T4,class T5,class T6,class T7,class T8>
@@ -159,6 +219,18 @@ struct ref_tuple9
     v7 =get<7>(fres);
     v8 =get<8>(fres);
   }
+  void assign_results(lua_State* state, int index)
+  {
+    v0 = lua_type_traits<T0>::get(state, index);
+    v1 = lua_type_traits<T1>::get(state, index + 1);
+    v2 = lua_type_traits<T2>::get(state, index + 2);
+    v3 = lua_type_traits<T3>::get(state, index + 3);
+    v4 = lua_type_traits<T4>::get(state, index + 4);
+    v5 = lua_type_traits<T5>::get(state, index + 5);
+    v6 = lua_type_traits<T6>::get(state, index + 6);
+    v7 = lua_type_traits<T7>::get(state, index + 7);
+    v8 = lua_type_traits<T8>::get(state, index + 8);
+  }
 };
 
 template<class T0>
@@ -9,10 +9,20 @@
 
 #include "kaguya/lua_ref.hpp"
 #include "kaguya/native_function.hpp"
+#include "kaguya/static_function.hpp"
 
 #include "kaguya/state.hpp"
 
 #include "kaguya/lua_ref_table.hpp"
 #include "kaguya/lua_ref_function.hpp"
 #include "kaguya/ref_tuple.hpp"
+#include "kaguya/deep_copy.hpp"
+#include "kaguya/serialize.hpp"
+#include "kaguya/field_path.hpp"
+#include "kaguya/async.hpp"
+#include "kaguya/scheduler.hpp"
+#include "kaguya/profiler.hpp"
+#include "kaguya/binding_metrics.hpp"
+#include "kaguya/gc_driver.hpp"
+#include "kaguya/allocation_counter.hpp"
 
@@ -12,6 +12,7 @@
 #include <algorithm>
 #include <ostream>
 #include <istream>
+#include <cstring>
 #include "kaguya/config.hpp"
 #include "kaguya/error_handler.hpp"
 #include "kaguya/type.hpp"
@@ -310,6 +311,78 @@ namespace kaguya
 
 
 
+	/**
+	* @brief Interned string key for table access.
+	* The string is pinned in registry once and pushed by lua_rawgeti, without hashing the string again.
+	* Copy is cheap, copies share same registry reference.
+	* @code
+	* kaguya::LuaKey name = state.newKey("name");
+	* std::string v = table.getField<std::string>(name);
+	* table[name] = "value";
+	* @endcode
+	*/
+	class LuaKey : public LuaBasicTypeFunctions<LuaKey>
+	{
+	public:
+		LuaKey()
+		{
+		}
+		LuaKey(lua_State* state, const char* str) :ref_(make_ref(state, str, std::strlen(str)))
+		{
+		}
+		LuaKey(lua_State* state, const std::string& str) :ref_(make_ref(state, str.data(), str.size()))
+		{
+		}
+
+		lua_State* state()const { return ref_ ? ref_->state() : 0; }
+
+		bool isNilref()const { return !ref_ || ref_->isNilref(); }
+
+		int push(lua_State* state)const
+		{
+			if (!ref_)
+			{
+				lua_pushnil(state);
+				return 1;
+			}
+			return ref_->push(state);
+		}
+		int push()const
+		{
+			return push(state());
+		}
+		int pushStackIndex(lua_State* state)const
+		{
+			push(state);
+			return lua_gettop(state);
+		}
+
+	private:
+		static standard::shared_ptr<const LuaRef> make_ref(lua_State* state, const char* str, size_t size)
+		{
+			if (!state)
+			{
+				return standard::shared_ptr<const LuaRef>();
+			}
+			lua_pushlstring(state, str, size);
+			return standard::shared_ptr<const LuaRef>(new LuaRef(state, StackTop()));
+		}
+		standard::shared_ptr<const LuaRef> ref_;
+	};
+	template<>
+	struct lua_type_traits<LuaKey>
+	{
+		typedef const LuaKey& push_type;
+
+		static int push(lua_State* l, push_type v)
+		{
+			return v.push(l);
+		}
+	};
+	template<>	struct lua_type_traits<const LuaKey&> :lua_type_traits<LuaKey> {};
+
+
+
 	//! Reference to Lua userdata
 	class  LuaUserData :public Ref::RegistoryRef
 		, public LuaTableOrUserDataImpl<LuaUserData>
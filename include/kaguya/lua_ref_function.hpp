@@ -145,7 +145,7 @@ namespace kaguya
 		{
 			if (index >= result_size())
 			{
-				throw std::out_of_range("function result out of range");
+				KAGUYA_THROW(std::out_of_range("function result out of range"));
 			}
 			return lua_type_traits<T>::get(state_, stack_index_ + static_cast<int>(index));
 		}
@@ -153,7 +153,7 @@ namespace kaguya
 		{
 			if (index >= result_size())
 			{
-				throw std::out_of_range("function result out of range");
+				KAGUYA_THROW(std::out_of_range("function result out of range"));
 			}
 			return reference(state_, stack_index_ + static_cast<int>(index));
 		}
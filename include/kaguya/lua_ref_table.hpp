@@ -269,6 +269,120 @@ namespace kaguya
 		KEY key_;
 	};
 
+	/**
+	* @brief keep table on the stack during lifetime, for batch of field access.
+	* Table is not pushed from registry at each access.
+	* Stack top must be restored by user between operations. Stack is restored to the state before construction at destruction.
+	* @code
+	* kaguya::PinnedTable pinned(table);
+	* for (int i = 1; i <= 100000; ++i) { pinned.rawSetIndex(i, i); }
+	* @endcode
+	*/
+	class PinnedTable
+	{
+	public:
+		template<typename RefType>
+		explicit PinnedTable(const RefType& table) :state_(table.state()), stack_top_(0), table_index_(0)
+		{
+			if (!state_)
+			{
+				except::typeMismatchError(state_, "is nil");
+				return;
+			}
+			stack_top_ = lua_gettop(state_);
+			table_index_ = table.pushStackIndex(state_);
+			if (lua_type(state_, table_index_) != LUA_TTABLE)
+			{
+				except::typeMismatchError(state_, "is not table");
+				lua_settop(state_, stack_top_);
+				state_ = 0;
+			}
+		}
+		~PinnedTable()
+		{
+			if (state_)
+			{
+				lua_settop(state_, stack_top_);
+			}
+		}
+
+		//! If table is available, return true.
+		bool valid()const { return state_ != 0; }
+		lua_State* state()const { return state_; }
+		//! stack index of table
+		int stackIndex()const { return table_index_; }
+
+		//! value = table[key];
+		template<typename T, typename K>
+		typename lua_type_traits<T>::get_type get(const K& key)const
+		{
+			if (!state_) { return typename lua_type_traits<T>::get_type(); }
+			util::ScopedSavedStack save(state_);
+			table_proxy::get(state_, table_index_, key);
+			return lua_type_traits<T>::get(state_, -1);
+		}
+		//! table[key] = value;
+		template<typename K, typename V>
+		void set(const K& key, const V& value)
+		{
+			if (!state_) { return; }
+			table_proxy::set(state_, table_index_, key, value);
+		}
+		//! value = rawget(table,key);
+		template<typename T, typename K>
+		typename lua_type_traits<T>::get_type rawGet(const K& key)const
+		{
+			if (!state_) { return typename lua_type_traits<T>::get_type(); }
+			util::ScopedSavedStack save(state_);
+			util::one_push(state_, key);
+			lua_rawget(state_, table_index_);
+			return lua_type_traits<T>::get(state_, -1);
+		}
+		//! value = rawget(table,index);
+		template<typename T>
+		typename lua_type_traits<T>::get_type rawGetIndex(int index)const
+		{
+			if (!state_) { return typename lua_type_traits<T>::get_type(); }
+			util::ScopedSavedStack save(state_);
+			lua_rawgeti(state_, table_index_, index);
+			return lua_type_traits<T>::get(state_, -1);
+		}
+		//! rawset(table,key,value);
+		template<typename K, typename V>
+		void rawSet(const K& key, const V& value)
+		{
+			if (!state_) { return; }
+			util::one_push(state_, key);
+			util::one_push(state_, value);
+			lua_rawset(state_, table_index_);
+		}
+		//! rawset(table,index,value);
+		template<typename V>
+		void rawSetIndex(int index, const V& value)
+		{
+			if (!state_) { return; }
+			util::one_push(state_, value);
+			lua_rawseti(state_, table_index_, index);
+		}
+		//! Equivalent to rawlen
+		size_t size()const
+		{
+			if (!state_) { return 0; }
+#if LUA_VERSION_NUM >= 502
+			return lua_rawlen(state_, table_index_);
+#else
+			return lua_objlen(state_, table_index_);
+#endif
+		}
+	private:
+		PinnedTable(const PinnedTable&);
+		PinnedTable& operator=(const PinnedTable&);
+
+		lua_State* state_;
+		int stack_top_;
+		int table_index_;
+	};
+
 	template<typename KEY>
 	inline std::ostream& operator<<(std::ostream& os, const TableKeyReference<KEY>& ref)
 	{
@@ -488,6 +602,21 @@ namespace kaguya
 			table.push(l);
 			return 1;
 		}
+#if KAGUYA_USE_RVALUE_REFERENCE
+		//! move elements to Lua. avoid copy of returned vector of string or registered class.
+		static int push(lua_State* l, std::vector<T, A>&& v)
+		{
+			LuaRef table(l, NewTable(int(v.size()), 0));
+
+			int count = 1;//array is 1 origin in Lua
+			for (typename std::vector<T, A>::iterator it = v.begin(); it != v.end(); ++it)
+			{
+				table.setField(count++, static_cast<T&&>(*it));//vector<bool> reference is converted to bool
+			}
+			table.push(l);
+			return 1;
+		}
+#endif
 	};
 #endif
 
@@ -556,6 +685,19 @@ namespace kaguya
 			table.push(l);
 			return 1;
 		}
+#if KAGUYA_USE_RVALUE_REFERENCE
+		//! move mapped values to Lua. key is copied.
+		static int push(lua_State* l, std::map<K, V, C, A>&& v)
+		{
+			LuaRef table(l, NewTable(0, int(v.size())));
+			for (typename std::map<K, V, C, A>::iterator it = v.begin(); it != v.end(); ++it)
+			{
+				table.setField(it->first, std::move(it->second));
+			}
+			table.push(l);
+			return 1;
+		}
+#endif
 	};
 #endif
 }
@@ -13,6 +13,7 @@
 
 #include "kaguya/config.hpp"
 #include "kaguya/native_function.hpp"
+#include "kaguya/static_function.hpp"
 
 
 #include "kaguya/lua_ref_function.hpp"
@@ -107,6 +108,72 @@ namespace kaguya
 		}
 	}
 
+	namespace metatable_detail
+	{
+		//! chunks of __index and __newindex builder. argument is metatable
+		inline const char* index_chunk()
+		{
+			return "local arg = {...};local metatable = arg[1];"
+				"return function(table, index)"
+				" local propfun = metatable['_prop_'..index];"
+				" if propfun then return propfun(table) end "
+				" return metatable[index]"
+				" end";
+		}
+		inline const char* flattened_index_chunk()
+		{
+			return "local arg = {...};local metatable = arg[1];"
+				"return function(table, index)"
+				" local propfun = rawget(metatable,'_prop_'..index);"
+				" if propfun then return propfun(table) end "
+				" local v = rawget(metatable,index);"
+				" if v ~= nil then return v end "
+				" return metatable[index]"
+				" end";
+		}
+		inline const char* newindex_chunk()
+		{
+			return "local arg = {...};local metatable = arg[1];"
+				" return function(table, index, value) "
+				" if type(table) == 'userdata' then "
+				" local propfun = metatable['_prop_'..index];"
+				" if propfun then return propfun(table,value) end "
+				" end "
+				" rawset(table,index,value) "
+				" end";
+		}
+		inline const char* flattened_newindex_chunk()
+		{
+			return "local arg = {...};local metatable = arg[1];"
+				" return function(table, index, value) "
+				" if type(table) == 'userdata' then "
+				" local propfun = rawget(metatable,'_prop_'..index);"
+				" if propfun then return propfun(table,value) end "
+				" end "
+				" rawset(table,index,value) "
+				" end";
+		}
+		/**
+		* @brief compiled accessor builder chunk. compiled once per lua_State and cached in registry by chunk address,
+		* so registering many classes does not compile the same code again.
+		*/
+		inline LuaFunction accessor_builder(lua_State* state, const char* chunk)
+		{
+			lua_pushlightuserdata(state, const_cast<char*>(chunk));
+			lua_rawget(state, LUA_REGISTRYINDEX);
+			if (lua_isfunction(state, -1))
+			{
+				return LuaFunction(state, StackTop());
+			}
+			lua_pop(state, 1);
+			LuaFunction builder = LuaFunction::loadstring(state, chunk);
+			lua_pushlightuserdata(state, const_cast<char*>(chunk));
+			builder.push(state);
+			lua_rawset(state, LUA_REGISTRYINDEX);
+			return builder;
+		}
+	}
+
 	template<typename class_type, typename base_class_type = void>
 	class UserdataMetatable
 	{
@@ -116,7 +183,7 @@ namespace kaguya
 
 	public:
 
-		UserdataMetatable()
+		UserdataMetatable() :copy_function_(0), serialize_function_(0), deserialize_function_(0), flatten_inheritance_(false)
 		{
 			addStaticFunction("__gc", &class_userdata::destructor<ObjectWrapperBase>);
 
@@ -134,46 +201,31 @@ namespace kaguya
 		LuaRef registerClass(lua_State* state)const
 		{
 			util::ScopedSavedStack save(state);
-			if (class_userdata::newmetatable<class_type>(state))
+			if (class_userdata::newmetatable<class_type>(state, metatable_field_count()))
 			{
 				LuaTable metatable(state, StackTop());
 				metatable.push();
 				registerMember(state);
 
-				if (!traits::is_same<base_class_type, void>::value || !property_map_.empty())//if base class has property and derived class hasnt property. need property access metamethod
+				set_base_metatable(state, metatable, types::typetag<base_class_type>());
+
+				bool need_property_access = !traits::is_same<base_class_type, void>::value || !property_map_.empty() || !static_property_tables_.empty();//if base class has property and derived class hasnt property. need property access metamethod
+				if (flatten_inheritance_)
 				{
-					for (typename PropMapType::const_iterator it = property_map_.begin(); it != property_map_.end(); ++it)
-					{
-						int count = it->second->push_to_lua(state);
-						if (count > 1)
-						{
-							lua_pop(state, count - 1);
-							count = 1;
-						}
-						if (count == 1)
-						{
-							lua_setfield(state, -2, ("_prop_" + it->first).c_str());
-						}
-					}
-					LuaFunction indexfun = kaguya::LuaFunction::loadstring(state, "local arg = {...};local metatable = arg[1];"
-						"return function(table, index)"
-						//						" if type(table) == 'userdata' then "
-						" local propfun = metatable['_prop_'..index];"
-						" if propfun then return propfun(table) end "
-						//						" end "
-						" return metatable[index]"
-						" end")(metatable);
+					metatable.push();
+					class_userdata::flatten_inherited_members(state, -1);
+					need_property_access = class_userdata::has_property(state, -1);
+				}
 
+				if (need_property_access)
+				{
+					//flattened metatable has all inherited members. lookup without metatable chain.
+					LuaFunction indexfun = metatable_detail::accessor_builder(state, flatten_inheritance_ ?
+						metatable_detail::flattened_index_chunk() : metatable_detail::index_chunk())(metatable);
 					metatable.setField("__index", indexfun);
 
-					LuaFunction newindexfn = LuaFunction::loadstring(state, "local arg = {...};local metatable = arg[1];"
-						" return function(table, index, value) "
-						" if type(table) == 'userdata' then "
-						" local propfun = metatable['_prop_'..index];"
-						" if propfun then return propfun(table,value) end "
-						" end "
-						" rawset(table,index,value) "
-						" end")(metatable);
+					LuaFunction newindexfn = metatable_detail::accessor_builder(state, flatten_inheritance_ ?
+						metatable_detail::flattened_newindex_chunk() : metatable_detail::newindex_chunk())(metatable);
 					metatable.setField("__newindex", newindexfn);
 				}
 				else
@@ -181,7 +233,16 @@ namespace kaguya
 					metatable.setField("__index", metatable);
 				}
 
-				set_base_metatable(state, metatable, types::typetag<base_class_type>());
+				if (copy_function_)
+				{
+					metatable.push();
+					class_userdata::set_copy_function(state, -1, copy_function_);
+				}
+				if (serialize_function_ && deserialize_function_)
+				{
+					metatable.push();
+					class_userdata::set_serialize_functions(state, -1, serialize_function_, deserialize_function_);
+				}
 
 				return metatable;
 			}
@@ -218,6 +279,89 @@ namespace kaguya
 #endif
 
 
+		/**
+		* @brief add functions of static luaL_Reg array, terminated by {0, 0}.
+		* Entries are registered by lua_pushcfunction at registerClass, without per member holder object.
+		* The array must be alive until registerClass. Names must not overlap with other members.
+		* e.g.
+		* @code
+		* static const luaL_Reg vec3_functions[] = {
+		*   { "new", KAGUYA_STATIC_CONSTRUCTOR(Vec3(double, double, double)) },
+		*   { "length", KAGUYA_STATIC_FUNCTION(&Vec3::length) },
+		*   { 0, 0 }
+		* };
+		* state["Vec3"].setClass(kaguya::UserdataMetatable<Vec3>().addStaticFunctions(vec3_functions));
+		* @endcode
+		*/
+		UserdataMetatable& addStaticFunctions(const luaL_Reg* functions)
+		{
+			static_function_tables_.push_back(functions);
+			return *this;
+		}
+		/**
+		* @brief add properties of static luaL_Reg array, terminated by {0, 0}.
+		* Entry function is KAGUYA_STATIC_FUNCTION of member data pointer, or function that same as property accessor.
+		*/
+		UserdataMetatable& addStaticProperties(const luaL_Reg* properties)
+		{
+			static_property_tables_.push_back(properties);
+			return *this;
+		}
+
+		/**
+		* @brief copy all inherited methods and properties into the metatable at registerClass.
+		* Method lookup does not walk the base class metatables.
+		* Members added to base class metatables after registration are visible after refreshInheritedMembers.
+		*/
+		UserdataMetatable& flattenInheritance(bool flatten = true)
+		{
+			flatten_inheritance_ = flatten;
+			return *this;
+		}
+
+		/**
+		* @brief copy inherited members again into the registered metatable of class_type, if registered with flattenInheritance.
+		* Call after base class metatables are modified. Derived classes of class_type must be refreshed after class_type.
+		*/
+		static void refreshInheritedMembers(lua_State* state)
+		{
+			util::ScopedSavedStack save(state);
+			class_userdata::get_metatable<class_type>(state);
+			if (lua_istable(state, -1) && class_userdata::is_flattened(state, -1))
+			{
+				class_userdata::flatten_inherited_members(state, -1);
+			}
+		}
+
+		/**
+		* @brief allow copy object to other Lua state by deepCopy. use copy constructor of class_type.
+		*/
+		UserdataMetatable& setCopyFunction()
+		{
+			copy_function_ = &class_userdata::copy_object<class_type>;
+			return *this;
+		}
+		/**
+		* @brief allow copy object to other Lua state by deepCopy.
+		* @param f function that push copy of object at index in from state to "to" state.
+		*/
+		UserdataMetatable& setCopyFunction(class_userdata::copy_function_type f)
+		{
+			copy_function_ = f;
+			return *this;
+		}
+		/**
+		* @brief allow write object by serialize and restore by deserialize.
+		* @param serialize function that write object at index to stream.
+		* @param deserialize function that push object restored from data written by serialize.
+		*/
+		UserdataMetatable& setSerializeFunction(class_userdata::serialize_function_type serialize, class_userdata::deserialize_function_type deserialize)
+		{
+			serialize_function_ = serialize;
+			deserialize_function_ = deserialize;
+			return *this;
+		}
+
 		//add member property
 		template<typename Ret>
 		UserdataMetatable& addProperty(const char* name, Ret class_type::* mem)
@@ -236,7 +380,7 @@ namespace kaguya
 		{
 			if (has_key(name))
 			{
-				throw KaguyaException("already registerd.");
+				KAGUYA_THROW(KaguyaException("already registerd."));
 				return *this;
 			}
 			member_map_[name] = metatable_detail::makeDataHolder(function(f));
@@ -248,7 +392,7 @@ namespace kaguya
 		{
 			if (has_key(name))
 			{
-				throw KaguyaException("already registerd.");
+				KAGUYA_THROW(KaguyaException("already registerd."));
 				return *this;
 			}
 			code_chunk_map_[name] = lua_code_chunk;
@@ -262,7 +406,7 @@ namespace kaguya
 		{
 			if (has_key(name))
 			{
-				throw KaguyaException("already registerd.");
+				KAGUYA_THROW(KaguyaException("already registerd."));
 				return *this;
 			}
 			member_map_[name] = metatable_detail::makeDataHolder(d);
@@ -274,7 +418,7 @@ namespace kaguya
 		{
 			if (has_key(name))
 			{
-				throw KaguyaException("already registerd."); 
+				KAGUYA_THROW(KaguyaException("already registerd.")); 
 				return *this;
 			}
 
@@ -287,7 +431,7 @@ namespace kaguya
 		{
 			if (has_key(name))
 			{
-				throw KaguyaException("already registerd.");
+				KAGUYA_THROW(KaguyaException("already registerd."));
 				return *this;
 			}
 			member_map_[name] = metatable_detail::makeDataHolder(std::forward<Data>(d));
@@ -303,7 +447,7 @@ namespace kaguya
 		{\
 			if (has_key(name))\
 			{\
-				throw KaguyaException("already registerd.");\
+				KAGUYA_THROW(KaguyaException("already registerd."));\
 				return *this;\
 			}\
 			member_map_[name] = metatable_detail::makeDataHolder(overload(KAGUYA_PP_ARG_REPEAT(N)));\
@@ -323,7 +467,7 @@ namespace kaguya
 		{
 			if (has_key(name))
 			{
-				throw KaguyaException("already registerd. if you want function overload,use addOverloadedFunctions");
+				KAGUYA_THROW(KaguyaException("already registerd. if you want function overload,use addOverloadedFunctions"));
 				return *this;
 			}
 			member_map_[name] = metatable_detail::makeDataHolder(function(f));
@@ -335,7 +479,7 @@ namespace kaguya
 		{
 			if (has_key(name))
 			{
-				throw KaguyaException("already registerd. if you want function overload,use addOverloadedFunctions");
+				KAGUYA_THROW(KaguyaException("already registerd. if you want function overload,use addOverloadedFunctions"));
 				return *this;
 			}
 			member_map_[name] = metatable_detail::makeDataHolder(function(f));
@@ -379,7 +523,11 @@ namespace kaguya
 		void set_base_metatable(lua_State* state, LuaTable& metatable, types::typetag<Base>)const
 		{
 			class_userdata::get_metatable<Base>(state);
-			metatable.setMetatable(LuaTable(state, StackTop()));
+			LuaTable base(state, StackTop());
+			metatable.setMetatable(base);
+			LuaTable metabases(state, NewTable(1, 0));
+			metabases.setField(1, base);
+			set_base_list(state, metatable, metabases);
 
 			PointerConverter& pconverter = PointerConverter::get(state);
 			pconverter.add_type_conversion<Base, class_type>();
@@ -402,7 +550,14 @@ namespace kaguya
 			newmeta.setField("__index", indexfun);
 
 			metatable.setMetatable(newmeta);
-
+			set_base_list(state, metatable, metabases);
+		}
+		void set_base_list(lua_State* state, LuaTable& metatable, const LuaTable& metabases)const
+		{
+			util::ScopedSavedStack save(state);
+			metatable.push();
+			metabases.push();
+			class_userdata::set_base_metatables(state, -2);
 		}
 #if KAGUYA_USE_CPP11
 
@@ -465,18 +620,40 @@ namespace kaguya
 			}
 			return false;
 		}
-		void registerField(lua_State* state, const char* name, const metatable_detail::DataHolderType& value)const
+		//! push one value of holder. return false if nothing pushed
+		static bool pushField(lua_State* state, const metatable_detail::DataHolderType& value)
 		{
 			int count = value->push_to_lua(state);
 			if (count > 1)
 			{
 				lua_pop(state, count - 1);
-				count = 1;
 			}
-			if (count == 1)
+			return count > 0;
+		}
+
+		static int static_table_size(const std::vector<const luaL_Reg*>& tables)
+		{
+			int count = 0;
+			for (std::vector<const luaL_Reg*>::const_iterator it = tables.begin(); it != tables.end(); ++it)
 			{
-				lua_setfield(state, -2, name);
+				for (const luaL_Reg* reg = *it; reg->name; ++reg)
+				{
+					++count;
+				}
 			}
+			return count;
+		}
+		//! number of fields set to metatable by registerClass, except inherited members.
+		int metatable_field_count()const
+		{
+			int count = static_cast<int>(member_map_.size() + property_map_.size() + code_chunk_map_.size())
+				+ static_table_size(static_function_tables_) + static_table_size(static_property_tables_);
+			count += 2;//__index and __newindex
+			count += traits::is_same<base_class_type, void>::value ? 0 : 1;
+			count += copy_function_ ? 1 : 0;
+			count += serialize_function_ && deserialize_function_ ? 1 : 0;
+			count += flatten_inheritance_ ? 1 : 0;
+			return count;
 		}
 		void registerCodeChunk(lua_State* state, const char* name,const std::string& value)const
 		{
@@ -488,11 +665,44 @@ namespace kaguya
 			lua_setfield(state, -2, name);
 		}
 
+		//! register all members and properties to metatable on stack top in one pass
 		void registerMember(lua_State* state)const
 		{
 			for (typename MemberMapType::const_iterator it = member_map_.begin(); it != member_map_.end(); ++it)
 			{
-				registerField(state, it->first.c_str(), it->second);
+				if (pushField(state, it->second))
+				{
+					lua_setfield(state, -2, it->first.c_str());
+				}
+			}
+			for (typename PropMapType::const_iterator it = property_map_.begin(); it != property_map_.end(); ++it)
+			{
+				class_userdata::push_property_key(state, it->first.data(), it->first.size());
+				if (pushField(state, it->second))
+				{
+					lua_rawset(state, -3);
+				}
+				else
+				{
+					lua_pop(state, 1);
+				}
+			}
+			for (std::vector<const luaL_Reg*>::const_iterator it = static_function_tables_.begin(); it != static_function_tables_.end(); ++it)
+			{
+				for (const luaL_Reg* reg = *it; reg->name; ++reg)
+				{
+					lua_pushcfunction(state, reg->func);
+					lua_setfield(state, -2, reg->name);
+				}
+			}
+			for (std::vector<const luaL_Reg*>::const_iterator it = static_property_tables_.begin(); it != static_property_tables_.end(); ++it)
+			{
+				for (const luaL_Reg* reg = *it; reg->name; ++reg)
+				{
+					class_userdata::push_property_key(state, reg->name, std::strlen(reg->name));
+					lua_pushcfunction(state, reg->func);
+					lua_rawset(state, -3);
+				}
 			}
 			for (typename CodeChunkMapType::const_iterator it = code_chunk_map_.begin(); it != code_chunk_map_.end(); ++it)
 			{
@@ -503,5 +713,11 @@ namespace kaguya
 		PropMapType property_map_;
 		MemberMapType member_map_;
 		CodeChunkMapType code_chunk_map_;
+		std::vector<const luaL_Reg*> static_function_tables_;
+		std::vector<const luaL_Reg*> static_property_tables_;
+		class_userdata::copy_function_type copy_function_;
+		class_userdata::serialize_function_type serialize_function_;
+		class_userdata::deserialize_function_type deserialize_function_;
+		bool flatten_inheritance_;
 	};
 }
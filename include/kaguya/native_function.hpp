@@ -7,6 +7,9 @@
 
 #include <string>
 #include <vector>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
 
 #include "kaguya/config.hpp"
 #include "kaguya/utility.hpp"
@@ -14,7 +17,9 @@
 #include "kaguya/lua_ref.hpp"
 
 #if KAGUYA_USE_CPP11
+#include <atomic>
 #include "kaguya/native_function_cxx11.hpp"
+#include "kaguya/callback.hpp"
 #else
 #include "kaguya/preprocess.hpp"
 #include "kaguya/native_function_cxx03.hpp"
@@ -125,7 +130,7 @@ namespace kaguya
 		{
 			if (index >= size())
 			{
-				throw std::out_of_range("variadic arguments out of range");
+				KAGUYA_THROW(std::out_of_range("variadic arguments out of range"));
 			}
 			return lua_type_traits<T>::get(state_, startIndex_ + static_cast<int>(index));
 		}
@@ -134,7 +139,7 @@ namespace kaguya
 		{
 			if (index >= size())
 			{
-				throw std::out_of_range("variadic arguments out of range");
+				KAGUYA_THROW(std::out_of_range("variadic arguments out of range"));
 			}
 			return reference(state_, startIndex_ + static_cast<int>(index));
 		}
@@ -170,6 +175,278 @@ namespace kaguya
 		}
 	};
 
+	/**
+	* @brief typed view of variadic arguments on the Lua stack. Arguments are converted at access, without allocation.
+	* As a bound function parameter, all remaining arguments must be convertible to T.
+	* e.g.
+	* @code
+	* state["log"] = kaguya::function([](const char* format, kaguya::VariadicArgView<double> args) {
+	*   double values[20];
+	*   size_t count = args.copy(values, 20);
+	* });
+	* @endcode
+	*/
+	template<typename T>
+	class VariadicArgView
+	{
+	public:
+		typedef typename lua_type_traits<T>::get_type value_type;
+		typedef value_type const_reference;
+		typedef size_t size_type;
+
+		class iterator
+		{
+		public:
+			typedef std::random_access_iterator_tag iterator_category;
+			typedef typename VariadicArgView::value_type value_type;
+			typedef int difference_type;
+			typedef const value_type* pointer;
+			typedef value_type reference;
+
+			iterator(lua_State* state, int index) :state_(state), stack_index_(index)
+			{
+			}
+			value_type operator*()const
+			{
+				return lua_type_traits<T>::get(state_, stack_index_);
+			}
+			value_type operator[](difference_type n)const
+			{
+				return lua_type_traits<T>::get(state_, stack_index_ + n);
+			}
+			iterator& operator++()
+			{
+				stack_index_++;
+				return *this;
+			}
+			iterator operator++(int)
+			{
+				return iterator(state_, stack_index_++);
+			}
+			iterator& operator--()
+			{
+				stack_index_--;
+				return *this;
+			}
+			iterator operator--(int)
+			{
+				return iterator(state_, stack_index_--);
+			}
+			iterator& operator+=(difference_type n)
+			{
+				stack_index_ += n;
+				return *this;
+			}
+			iterator& operator-=(difference_type n)
+			{
+				stack_index_ -= n;
+				return *this;
+			}
+			iterator operator+(difference_type n)const
+			{
+				return iterator(state_, stack_index_ + n);
+			}
+			iterator operator-(difference_type n)const
+			{
+				return iterator(state_, stack_index_ - n);
+			}
+			difference_type operator-(const iterator& other)const
+			{
+				return stack_index_ - other.stack_index_;
+			}
+			bool operator==(const iterator& other)const
+			{
+				return state_ == other.state_ && stack_index_ == other.stack_index_;
+			}
+			bool operator!=(const iterator& other)const
+			{
+				return !(*this == other);
+			}
+			bool operator<(const iterator& other)const
+			{
+				return stack_index_ < other.stack_index_;
+			}
+		private:
+			lua_State* state_;
+			int stack_index_;
+		};
+		typedef iterator const_iterator;
+
+		VariadicArgView(lua_State* state, int startIndex) :state_(state), startIndex_(startIndex), endIndex_(lua_gettop(state) + 1)
+		{
+			if (startIndex_ > endIndex_)
+			{
+				endIndex_ = startIndex_;
+			}
+		}
+
+		size_t size()const
+		{
+			return endIndex_ - startIndex_;
+		}
+		bool empty()const
+		{
+			return startIndex_ == endIndex_;
+		}
+		iterator begin()const
+		{
+			return iterator(state_, startIndex_);
+		}
+		iterator end()const
+		{
+			return iterator(state_, endIndex_);
+		}
+		value_type operator[](size_t index)const
+		{
+			return lua_type_traits<T>::get(state_, startIndex_ + static_cast<int>(index));
+		}
+		value_type at(size_t index)const
+		{
+			if (index >= size())
+			{
+				KAGUYA_THROW(std::out_of_range("variadic arguments out of range"));
+			}
+			return (*this)[index];
+		}
+		value_type front()const
+		{
+			return (*this)[0];
+		}
+		value_type back()const
+		{
+			return (*this)[size() - 1];
+		}
+
+		//! view of [offset, offset + count). count is clamped to size
+		VariadicArgView subview(size_t offset, size_t count = size_t(-1))const
+		{
+			VariadicArgView view(*this);
+			view.startIndex_ = startIndex_ + static_cast<int>(std::min(offset, size()));
+			view.endIndex_ = view.startIndex_ + static_cast<int>(std::min(count, size_t(endIndex_ - view.startIndex_)));
+			return view;
+		}
+
+		/**
+		* @brief copy converted arguments to buffer.
+		* @param buffer output buffer of T
+		* @param capacity size of buffer
+		* @param offset first argument to copy
+		* @return number of copied arguments
+		*/
+		size_t copy(T* buffer, size_t capacity, size_t offset = 0)const
+		{
+			int index = startIndex_ + static_cast<int>(std::min(offset, size()));
+			int last = index + static_cast<int>(std::min(capacity, size_t(endIndex_ - index)));
+			T* out = buffer;
+			for (; index < last; ++index)
+			{
+				*out++ = lua_type_traits<T>::get(state_, index);
+			}
+			return out - buffer;
+		}
+
+		lua_State* state()const { return state_; }
+		//! stack index of first argument
+		int stackIndex()const { return startIndex_; }
+	private:
+		lua_State* state_;
+		int startIndex_;
+		int endIndex_;
+	};
+	template<typename T> struct lua_type_traits<VariadicArgView<T> >
+	{
+		typedef VariadicArgView<T> get_type;
+
+		static bool strictCheckType(lua_State* l, int index)
+		{
+			for (int top = lua_gettop(l); index <= top; ++index)
+			{
+				if (!lua_type_traits<T>::strictCheckType(l, index)) { return false; }
+			}
+			return true;
+		}
+		static bool checkType(lua_State* l, int index)
+		{
+			for (int top = lua_gettop(l); index <= top; ++index)
+			{
+				if (!lua_type_traits<T>::checkType(l, index)) { return false; }
+			}
+			return true;
+		}
+		static get_type get(lua_State* l, int index)
+		{
+			return VariadicArgView<T>(l, index);
+		}
+	};
+
+	/**
+	* @brief writer of multiple return values. Values are pushed straight onto the Lua stack, without tuple construction.
+	* As a bound function parameter, it must be the last parameter and the function must return it.
+	* e.g.
+	* @code
+	* kaguya::ResultWriter velocity(const Body& body, kaguya::ResultWriter results)
+	* {
+	*   return results(body.vx)(body.vy)(body.vz);
+	* }
+	* @endcode
+	*/
+	class ResultWriter
+	{
+	public:
+		explicit ResultWriter(lua_State* state) :state_(state), count_(0)
+		{
+		}
+
+		//! push value as next result. Stack is grown as needed, throw std::length_error if Lua stack limit is reached.
+		template<typename T>
+		ResultWriter& operator()(const T& value)
+		{
+			//keep free slots that push of a value may use
+			if (!lua_checkstack(state_, LUA_MINSTACK))
+			{
+				KAGUYA_THROW(std::length_error("too many results"));
+			}
+			count_ += util::push_args(state_, value);
+			return *this;
+		}
+
+		//! number of pushed results
+		int size()const
+		{
+			return count_;
+		}
+		lua_State* state()const
+		{
+			return state_;
+		}
+	private:
+		lua_State* state_;
+		int count_;
+	};
+	template<> struct lua_type_traits<ResultWriter>
+	{
+		typedef ResultWriter get_type;
+		typedef const ResultWriter& push_type;
+
+		static bool strictCheckType(lua_State* l, int index)
+		{
+			return true;
+		}
+		static bool checkType(lua_State* l, int index)
+		{
+			return true;
+		}
+		static get_type get(lua_State* l, int index)
+		{
+			return ResultWriter(l);
+		}
+		//! values are already on the stack. only return the count
+		static int push(lua_State* l, push_type v)
+		{
+			return v.size();
+		}
+	};
+
 	namespace nativefunction
 	{
 		static const int MAX_OVERLOAD_SCORE = 255;
@@ -353,29 +630,186 @@ namespace kaguya
 			}
 			return message;
 		}
-		inline int functor_dispatcher(lua_State *l)
+		/**
+		* @name raise error result
+		* @brief returned from invoke when error message is pushed. dispatcher raise Lua error.
+		*/
+		//@{
+		static const int RAISE_TYPE_MISMATCH = -10;//!< arguments were not convertible to selected function
+		static const int RAISE_NO_MATCHING_OVERLOAD = -11;//!< no overload matched to arguments
+		static const int RAISE_EXCEPTION = -12;//!< exception thrown from function
+		//@}
+		inline bool is_raise_error(int result)
+		{
+			return result <= RAISE_TYPE_MISMATCH && result >= RAISE_EXCEPTION;
+		}
+
+		/**
+		* @brief receives entry and exit of native function call dispatched by kaguya. @see Profiler
+		* Multiple observers can be added to the same lua_State, and each of them receives all calls.
+		*/
+		struct NativeCallObserver
+		{
+			NativeCallObserver() :next_observer(0) {}
+			//! next observer in the list of the lua_State. managed by add_observer and remove_observer
+			NativeCallObserver* next_observer;
+
+			virtual void enter(lua_State* state) = 0;
+			//! @param result result of invoke. number of return values, YIELD_CURRENT_THREAD or RAISE_*
+			virtual void leave(lua_State* state, int result) = 0;
+			virtual ~NativeCallObserver() {}
+		};
+		//! name of running native function that is called by. If unknown, return "?"
+		inline const char* called_function_name(lua_State* state)
+		{
+			lua_Debug ar;
+			if (lua_getstack(state, 0, &ar) && lua_getinfo(state, "n", &ar) && ar.name)
+			{
+				return ar.name;
+			}
+			return "?";
+		}
+#if KAGUYA_USE_CPP11
+		//! number of observers in all lua_State. If zero, dispatcher does not look up observer.
+		inline std::atomic<int>& observer_count()
+		{
+			static std::atomic<int> count(0);
+			return count;
+		}
+		inline void* observer_key()
+		{
+			static char key;
+			return &key;
+		}
+		//! first observer of the lua_State. others are linked by next_observer
+		inline NativeCallObserver* get_observer(lua_State* state)
+		{
+			util::ScopedSavedStack save(state);
+			lua_pushlightuserdata(state, observer_key());
+			lua_rawget(state, LUA_REGISTRYINDEX);
+			return static_cast<NativeCallObserver*>(lua_touserdata(state, -1));
+		}
+		inline void set_first_observer(lua_State* state, NativeCallObserver* observer)
+		{
+			util::ScopedSavedStack save(state);
+			lua_pushlightuserdata(state, observer_key());
+			if (observer)
+			{
+				lua_pushlightuserdata(state, observer);
+			}
+			else
+			{
+				lua_pushnil(state);
+			}
+			lua_rawset(state, LUA_REGISTRYINDEX);
+		}
+		//! add observer to the lua_State. observer must not be added already.
+		inline void add_observer(lua_State* state, NativeCallObserver* observer)
+		{
+			observer->next_observer = get_observer(state);
+			set_first_observer(state, observer);
+			observer_count()++;
+		}
+		//! remove observer from the lua_State. Other observers are kept.
+		inline void remove_observer(lua_State* state, NativeCallObserver* observer)
+		{
+			NativeCallObserver* first = get_observer(state);
+			if (first == observer)
+			{
+				set_first_observer(state, observer->next_observer);
+			}
+			else
+			{
+				NativeCallObserver* prev = first;
+				while (prev && prev->next_observer != observer)
+				{
+					prev = prev->next_observer;
+				}
+				if (!prev)
+				{
+					return;
+				}
+				prev->next_observer = observer->next_observer;
+			}
+			observer->next_observer = 0;
+			observer_count()--;
+		}
+#endif
+		inline int dispatch_result(lua_State *l, int result)
+		{
+			if (result == YIELD_CURRENT_THREAD)
+			{
+				return lua_yield(l, 0);
+			}
+			if (is_raise_error(result))
+			{
+				return lua_error(l);
+			}
+			return result;
+		}
+		//! call Invoke, and notify to observers if exists
+		template<int(*Invoke)(lua_State*)>
+		inline int observed_dispatch(lua_State *l)
+		{
+#if KAGUYA_USE_CPP11
+			if (observer_count().load(std::memory_order_relaxed) > 0)
+			{
+				NativeCallObserver* first = get_observer(l);
+				if (first)
+				{
+					for (NativeCallObserver* observer = first; observer; observer = observer->next_observer)
+					{
+						observer->enter(l);
+					}
+					int result = Invoke(l);
+					//list may be changed in Invoke
+					for (NativeCallObserver* observer = get_observer(l); observer; observer = observer->next_observer)
+					{
+						observer->leave(l, result);
+					}
+					return dispatch_result(l, result);
+				}
+			}
+#endif
+			return dispatch_result(l, Invoke(l));
+		}
+
+		inline int functor_invoke(lua_State *l)
 		{
 			FunctorType* fun = pick_match_function(l);
 			if (fun && (*fun))
 			{
+				int result = ARGUMENT_TYPE_MISMATCH;
+#if !KAGUYA_NO_EXCEPTIONS
 				try {
-					return (*fun)->invoke(l);
+#endif
+					result = (*fun)->invoke(l);
+#if !KAGUYA_NO_EXCEPTIONS
 				}
 				catch (LuaTypeMismatch &) {
-					util::traceBack(l, (std::string("maybe...") + build_arg_error_message(l)).c_str());
 				}
 				catch (std::exception & e) {
 					util::traceBack(l, e.what());
+					return RAISE_EXCEPTION;
 				}
 				catch (...) {
 					util::traceBack(l, "Unknown exception");
+					return RAISE_EXCEPTION;
 				}
+#endif
+				if (result != ARGUMENT_TYPE_MISMATCH)
+				{
+					return result;
+				}
+				util::traceBack(l, (std::string("maybe...") + build_arg_error_message(l)).c_str());
+				return RAISE_TYPE_MISMATCH;
 			}
-			else
-			{
-				util::traceBack(l, build_arg_error_message(l).c_str());
-			}
-			return lua_error(l);
+			util::traceBack(l, build_arg_error_message(l).c_str());
+			return RAISE_NO_MATCHING_OVERLOAD;
+		}
+		inline int functor_dispatcher(lua_State *l)
+		{
+			return observed_dispatch<&functor_invoke>(l);
 		}
 
 		inline int functor_destructor(lua_State *state)
@@ -479,9 +913,8 @@ namespace kaguya
 			}
 			else
 			{
-				throw LuaTypeMismatch("type mismatch!!");
+				return nativefunction::NO_MATCHING_OVERLOAD;
 			}
-			return 0;
 		}
 
 		template<typename TupleType, std::size_t ...S> int invoke_tuple_impl(lua_State* state, TupleType&& tuple, nativefunction::cpp11impl::index_tuple<S...>)
@@ -547,7 +980,7 @@ namespace kaguya
 			int32_t currentbestindex = -1;\
 			KAGUYA_PP_REPEAT(N, KAGUYA_FUNCTION_SCOREING);\
 			KAGUYA_PP_REPEAT(N, KAGUYA_FUNCTION_INVOKE);\
-			throw LuaTypeMismatch("type mismatch!!"); \
+			return nativefunction::NO_MATCHING_OVERLOAD; \
 		}\
 		KAGUYA_TEMPLATE_PARAMETER(N)\
 		std::string arg_typename_tuple(standard::tuple<KAGUYA_PP_TEMPLATE_ARG_REPEAT(N)>& tuple)\
@@ -634,26 +1067,46 @@ namespace kaguya
 				+ detail::arg_typename_tuple(*tuple);
 		}
 
-		static int invoke(lua_State *state)
+		static int invoke_functions(lua_State *state)
 		{
 			FunctionTuple* t = static_cast<FunctionTuple*>(lua_touserdata(state, lua_upvalueindex(1)));
 
 			if (t)
 			{
+				int result = nativefunction::ARGUMENT_TYPE_MISMATCH;
+#if !KAGUYA_NO_EXCEPTIONS
 				try {
-					return detail::invoke_tuple(state, *t);
+#endif
+					result = detail::invoke_tuple(state, *t);
+#if !KAGUYA_NO_EXCEPTIONS
 				}
 				catch (LuaTypeMismatch &) {
-					util::traceBack(state, (std::string("maybe...") + build_arg_error_message(state, t)).c_str());
 				}
 				catch (std::exception & e) {
 					util::traceBack(state, e.what());
+					return nativefunction::RAISE_EXCEPTION;
 				}
 				catch (...) {
 					util::traceBack(state, "Unknown exception");
+					return nativefunction::RAISE_EXCEPTION;
 				}
+#endif
+				if (result == nativefunction::NO_MATCHING_OVERLOAD)
+				{
+					util::traceBack(state, (std::string("maybe...") + build_arg_error_message(state, t)).c_str());
+					return nativefunction::RAISE_NO_MATCHING_OVERLOAD;
+				}
+				if (result != nativefunction::ARGUMENT_TYPE_MISMATCH)
+				{
+					return result;
+				}
+				util::traceBack(state, (std::string("maybe...") + build_arg_error_message(state, t)).c_str());
 			}
-			return lua_error(state);
+			return nativefunction::RAISE_TYPE_MISMATCH;
+		}
+		static int invoke(lua_State *state)
+		{
+			return nativefunction::observed_dispatch<&invoke_functions>(state);
 		}
 
 		inline static int tuple_destructor(lua_State *state)
@@ -666,15 +1119,32 @@ namespace kaguya
 			return 0;
 		}
 
-		static int push(lua_State* state, push_type fns)
+		//! push metatable of FunctionTuple userdata. created once per lua_State and shared by all functions of same type
+		static void push_tuple_metatable(lua_State* state)
 		{
-			void* ptr = lua_newuserdata(state, sizeof(FunctionTuple));
-			new(ptr) FunctionTuple(fns.functions);
+			static char key;
+			lua_pushlightuserdata(state, &key);
+			lua_rawget(state, LUA_REGISTRYINDEX);
+			if (lua_istable(state, -1))
+			{
+				return;
+			}
+			lua_pop(state, 1);
 			lua_createtable(state, 0, 2);
 			lua_pushcclosure(state, &tuple_destructor, 0);
 			lua_setfield(state, -2, "__gc");
 			lua_pushvalue(state, -1);
 			lua_setfield(state, -1, "__index");
+			lua_pushlightuserdata(state, &key);
+			lua_pushvalue(state, -2);
+			lua_rawset(state, LUA_REGISTRYINDEX);
+		}
+
+		static int push(lua_State* state, push_type fns)
+		{
+			void* ptr = lua_newuserdata(state, sizeof(FunctionTuple));
+			new(ptr) FunctionTuple(fns.functions);
+			push_tuple_metatable(state);
 			lua_setmetatable(state, -2);
 			lua_pushcclosure(state, &invoke, 1);
 
@@ -776,8 +1246,12 @@ namespace kaguya
 			if (lua_type(l, index) != LUA_TFUNCTION) {
 				return get_type();
 			}
+#if KAGUYA_USE_CPP11
+			return get_type(LuaCallback<T>(l, index));
+#else
 			lua_pushvalue(l, index);
 			return get_type(LuaFunction(l, StackTop()));
+#endif
 		}
 
 		static int push(lua_State* l, push_type v)
@@ -74,7 +74,9 @@ namespace kaguya
 			}
 #define KAGUYA_GET_OFFSET 
 #define KAGUYA_GET_CONCAT_REP(N) ,lua_type_traits<KAGUYA_PP_CAT(A,N)>::get(state, N KAGUYA_GET_OFFSET)
-#define KAGUYA_GET_REP(N) lua_type_traits<KAGUYA_PP_CAT(A,N)>::get(state, N KAGUYA_GET_OFFSET)
+#define KAGUYA_GET_REP(N) *KAGUYA_PP_CAT(a,N)
+#define KAGUYA_TRY_GET_REP(N) typename try_get_traits<KAGUYA_PP_CAT(A,N)>::result_type KAGUYA_PP_CAT(a,N) = try_get<KAGUYA_PP_CAT(A,N)>(state, N KAGUYA_GET_OFFSET);
+#define KAGUYA_ARG_FAILED_REP(N) || !KAGUYA_PP_CAT(a,N)
 
 #define KAGUYA_STRICT_TYPECHECK_REP(N) && lua_type_traits<KAGUYA_PP_CAT(A,N)>::strictCheckType(state, N KAGUYA_GET_OFFSET)
 #define KAGUYA_TYPECHECK_REP(N) && lua_type_traits<KAGUYA_PP_CAT(A,N)>::checkType(state, N KAGUYA_GET_OFFSET)
@@ -82,6 +84,10 @@ namespace kaguya
 
 #define KAGUYA_GET_REPEAT_CONCAT(N) KAGUYA_PP_REPEAT(N,KAGUYA_GET_CONCAT_REP)
 #define KAGUYA_GET_REPEAT(N) KAGUYA_PP_REPEAT_ARG(N,KAGUYA_GET_REP)
+//! convert arguments to local a1...aN. If any conversion failed, return ARGUMENT_TYPE_MISMATCH
+#define KAGUYA_TRY_GET_REPEAT(N) KAGUYA_PP_REPEAT(N,KAGUYA_TRY_GET_REP) if (false KAGUYA_PP_REPEAT(N,KAGUYA_ARG_FAILED_REP)) { return ARGUMENT_TYPE_MISMATCH; }
+//! convert this pointer to local this_. If it is null, return ARGUMENT_TYPE_MISMATCH
+#define KAGUYA_TRY_GET_THIS(TYPE) typename try_get_traits<TYPE*>::result_type this_ = try_get<TYPE*>(state, 1); if (!this_ || !*this_) { return ARGUMENT_TYPE_MISMATCH; }
 
 #define KAGUYA_FUNC_DEF(N) void (*f)(KAGUYA_PP_TEMPLATE_ARG_REPEAT(N))
 #define KAGUYA_FUNC_TYPE(N) void (*)(KAGUYA_PP_TEMPLATE_ARG_REPEAT(N))
@@ -89,6 +95,7 @@ namespace kaguya
 			template<KAGUYA_PP_TEMPLATE_DEF_REPEAT(N)>\
 			inline int call(lua_State* state, KAGUYA_FUNC_DEF(N))\
 			{\
+				KAGUYA_TRY_GET_REPEAT(N)\
 				f(KAGUYA_GET_REPEAT(N));\
 				return 0;\
 			}\
@@ -104,6 +111,7 @@ namespace kaguya
 			template<typename Ret KAGUYA_PP_TEMPLATE_DEF_REPEAT_CONCAT(N)>\
 			inline int call(lua_State* state, KAGUYA_FUNC_DEF(N))\
 			{\
+				KAGUYA_TRY_GET_REPEAT(N)\
 				return lua_type_traits<Ret>::push(state, f(KAGUYA_GET_REPEAT(N)));\
 			}\
 			template<typename Ret KAGUYA_PP_TEMPLATE_DEF_REPEAT_CONCAT(N)>struct is_callable<KAGUYA_FUNC_TYPE(N)> : traits::integral_constant<bool, true> {};\
@@ -143,8 +151,9 @@ namespace kaguya
 			template<typename ThisType KAGUYA_PP_TEMPLATE_DEF_REPEAT_CONCAT(N)>\
 			inline int call(lua_State* state, KAGUYA_FUNC_DEF(N))\
 			{\
-				KAGUYA_MEM_ATTRBUTE ThisType* this_ = lua_type_traits<KAGUYA_MEM_ATTRBUTE ThisType*>::get(state, 1); \
-				(this_->*f)(KAGUYA_GET_REPEAT(N));\
+				KAGUYA_TRY_GET_THIS(KAGUYA_MEM_ATTRBUTE ThisType)\
+				KAGUYA_TRY_GET_REPEAT(N)\
+				((*this_)->*f)(KAGUYA_GET_REPEAT(N));\
 				return 0;\
 			}\
 			template<typename ThisType KAGUYA_PP_TEMPLATE_DEF_REPEAT_CONCAT(N)>struct is_callable<KAGUYA_FUNC_TYPE(N)> : traits::integral_constant<bool, true> {};
@@ -169,8 +178,9 @@ namespace kaguya
 			template<typename ThisType,typename Ret KAGUYA_PP_TEMPLATE_DEF_REPEAT_CONCAT(N)>\
 			inline int call(lua_State* state,KAGUYA_FUNC_DEF(N))\
 			{\
-				KAGUYA_MEM_ATTRBUTE ThisType* this_ = lua_type_traits<KAGUYA_MEM_ATTRBUTE ThisType*>::get(state, 1); \
-				return lua_type_traits<Ret>::push(state, (this_->*f)(KAGUYA_GET_REPEAT(N)));\
+				KAGUYA_TRY_GET_THIS(KAGUYA_MEM_ATTRBUTE ThisType)\
+				KAGUYA_TRY_GET_REPEAT(N)\
+				return lua_type_traits<Ret>::push(state, ((*this_)->*f)(KAGUYA_GET_REPEAT(N)));\
 			}\
 			template<typename ThisType,typename Ret KAGUYA_PP_TEMPLATE_DEF_REPEAT_CONCAT(N)>struct is_callable<KAGUYA_FUNC_TYPE(N)> : traits::integral_constant<bool, true> {};\
 			template<typename ThisType,typename Ret KAGUYA_PP_TEMPLATE_DEF_REPEAT_CONCAT(N)>\
@@ -215,6 +225,7 @@ namespace kaguya
 			template<KAGUYA_PP_TEMPLATE_DEF_REPEAT(N)>\
 			inline int call(lua_State* state,KAGUYA_FUNC_DEF(N))\
 			{\
+				KAGUYA_TRY_GET_REPEAT(N)\
 				f(KAGUYA_GET_REPEAT(N));\
 				return 0;\
 			}\
@@ -230,6 +241,7 @@ namespace kaguya
 			template<typename Ret KAGUYA_PP_TEMPLATE_DEF_REPEAT_CONCAT(N)>\
 			inline int call(lua_State* state, KAGUYA_FUNC_DEF(N))\
 			{\
+				KAGUYA_TRY_GET_REPEAT(N)\
 				return lua_type_traits<Ret>::push(state,f(KAGUYA_GET_REPEAT(N)));\
 			}\
 			template<typename Ret KAGUYA_PP_TEMPLATE_DEF_REPEAT_CONCAT(N)>struct is_callable<KAGUYA_FUNC_TYPE(N)> : traits::integral_constant<bool, true> {};\
@@ -261,7 +273,12 @@ namespace kaguya
 			template<class MemType, class T>
 			int call(lua_State* state, MemType T::* m)
 			{
-				T* this_ = lua_type_traits<T*>::get(state, 1);
+				typename try_get_traits<T*>::result_type self = try_get<T*>(state, 1);
+				if (!self)
+				{
+					return ARGUMENT_TYPE_MISMATCH;
+				}
+				T* this_ = *self;
 				if (lua_gettop(state) == 1)
 				{
 					if (!this_)
@@ -269,7 +286,7 @@ namespace kaguya
 						const T* this_ = lua_type_traits<const T*>::get(state, 1);
 						if (!this_)
 						{
-							throw LuaTypeMismatch("type mismatch!!");
+							return ARGUMENT_TYPE_MISMATCH;
 						}
 						if (is_usertype<MemType>::value && !traits::is_pointer<MemType>::value)
 						{
@@ -296,7 +313,7 @@ namespace kaguya
 				{
 					if (!this_ || !lua_type_traits<MemType>::checkType(state, 2))
 					{
-						throw LuaTypeMismatch("type mismatch!!");
+						return ARGUMENT_TYPE_MISMATCH;
 					}
 					this_->*m = lua_type_traits<MemType>::get(state, 2);
 					return 0;
@@ -358,6 +375,7 @@ namespace kaguya
 			template<typename ClassType KAGUYA_PP_TEMPLATE_DEF_REPEAT_CONCAT(N)>\
 			inline int call(lua_State* state, KAGUYA_FUNC_DEF(N))\
 			{\
+				KAGUYA_TRY_GET_REPEAT(N)\
 				typedef ObjectWrapper<ClassType> wrapper_type;\
 				void *storage = lua_newuserdata(state, sizeof(wrapper_type));\
 				new(storage) wrapper_type(KAGUYA_GET_REPEAT(N));\
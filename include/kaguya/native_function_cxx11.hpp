@@ -20,30 +20,18 @@ namespace kaguya
 			template<class ThisType, class Res, class... FArgs, class... Args>
 			Res invoke(Res(ThisType::*f)(FArgs...), ThisType* this_, Args&&... args)
 			{
-				if (!this_)
-				{
-					throw LuaTypeMismatch("type mismatch!!");
-				}
 				return (this_->*f)(std::forward<Args>(args)...);
 			}
 
 			template<class ThisType, class... FArgs, class... Args>
 			void invoke(void (ThisType::*f)(FArgs...), ThisType* this_, Args&&... args)
 			{
-				if (!this_)
-				{
-					throw LuaTypeMismatch("type mismatch!!");
-				}
 				(this_->*f)(std::forward<Args>(args)...);
 			}
 
 			template<class ThisType, class Res, class... FArgs, class... Args>
 			Res invoke(Res(ThisType::*f)(FArgs...)const, const ThisType* this_, Args&&... args)
 			{
-				if (!this_)
-				{
-					throw LuaTypeMismatch("type mismatch!!");
-				}
 				return (this_->*f)(std::forward<Args>(args)...);
 			}
 
@@ -130,25 +118,102 @@ namespace kaguya
 				typedef invoke_signature_type<Ret, Args...> type;
 			};
 
-			template<class F, class Ret, class... Args, size_t... Indexes>
-			int _call_apply(lua_State* state, const F& f, index_tuple<Indexes...>, invoke_signature_type<Ret, Args...>)
+			inline bool all_true()
 			{
-				return lua_type_traits<Ret>::push(state, invoke(f, lua_type_traits<Args>::get(state, Indexes)...));
+				return true;
 			}
-			template<class F, class... Args, size_t... Indexes>
-			int _call_apply(lua_State* state, const F& f, index_tuple<Indexes...>, invoke_signature_type<void, Args...>)
+			template<class...Args>bool all_true(bool b, Args... args)
 			{
-				invoke(f, lua_type_traits<Args>::get(state, Indexes)...);
-				return 0;
+				return b && all_true(args...);
 			}
 
-			inline bool all_true()
+			template<class F>
+			struct is_member_function : traits::integral_constant<bool, false> {};
+			template <typename T, typename Ret, typename... Args>
+			struct is_member_function<Ret(T::*)(Args...)> : traits::integral_constant<bool, true> {};
+			template <typename T, typename Ret, typename... Args>
+			struct is_member_function<Ret(T::*)(Args...) const> : traits::integral_constant<bool, true> {};
+
+			template<class ArgsTuple>
+			bool _null_this(const ArgsTuple& args, traits::integral_constant<bool, true>)
 			{
-				return true;
+				return !*std::get<0>(args);
 			}
-			template<class...Args>bool all_true(bool b, Args... args)
+			template<class ArgsTuple>
+			bool _null_this(const ArgsTuple& args, traits::integral_constant<bool, false>)
 			{
-				return b && all_true(args...);
+				return false;
+			}
+
+			//! convert all arguments before call. If any conversion failed, return false.
+			template<class F, class ArgsTuple, size_t... Indexes>
+			bool _converted_all(const ArgsTuple& args, index_tuple<Indexes...>)
+			{
+				return all_true(bool(std::get<Indexes - 1>(args))...) && !_null_this(args, is_member_function<F>());
+			}
+
+			//! registered class returned by value. constructed in place of userdata.
+			template<class Ret>
+			struct is_emplaceable_result : traits::integral_constant<bool,
+				is_usertype<Ret>::value && !traits::is_pointer<Ret>::value && !traits::is_reference<Ret>::value>
+			{
+			};
+
+			//! deferred call with converted arguments
+			template<class F, class ArgsTuple, class Index, class Signature>
+			struct result_invoker;
+			template<class F, class ArgsTuple, size_t... Indexes, class Ret, class... Args>
+			struct result_invoker<F, ArgsTuple, index_tuple<Indexes...>, invoke_signature_type<Ret, Args...> >
+			{
+				result_invoker(const F& f, ArgsTuple& args) :f_(f), args_(args) {}
+				Ret operator()()const
+				{
+					return invoke(f_, std::forward<typename try_get_traits<Args>::get_type>(*std::get<Indexes - 1>(args_))...);
+				}
+			private:
+				const F& f_;
+				ArgsTuple& args_;
+			};
+
+			template<class Ret, class Invoker>
+			int _push_result(lua_State* state, const Invoker& invoker, traits::integral_constant<bool, false>)
+			{
+				return lua_type_traits<Ret>::push(state, invoker());
+			}
+			template<class Ret, class Invoker>
+			int _push_result(lua_State* state, const Invoker& invoker, traits::integral_constant<bool, true>)
+			{
+				typedef typename traits::remove_const_and_reference<Ret>::type object_type;
+				typedef ObjectWrapper<object_type> wrapper_type;
+				//userdata is allocated before call, return value is constructed into it directly.
+				void *storage = lua_newuserdata(state, sizeof(wrapper_type));
+				new(storage) wrapper_type(types::emplace_result_tag(), invoker);
+				class_userdata::setmetatable<object_type>(state);
+				return 1;
+			}
+
+			template<class F, class Ret, class... Args, size_t... Indexes>
+			int _call_apply(lua_State* state, const F& f, index_tuple<Indexes...> index, invoke_signature_type<Ret, Args...>)
+			{
+				typedef std::tuple<typename try_get_traits<Args>::result_type...> args_type;
+				args_type args{ try_get<Args>(state, Indexes)... };
+				if (!_converted_all<F>(args, index))
+				{
+					return ARGUMENT_TYPE_MISMATCH;
+				}
+				typedef result_invoker<F, args_type, index_tuple<Indexes...>, invoke_signature_type<Ret, Args...> > invoker_type;
+				return _push_result<Ret>(state, invoker_type(f, args), is_emplaceable_result<Ret>());
+			}
+			template<class F, class... Args, size_t... Indexes>
+			int _call_apply(lua_State* state, const F& f, index_tuple<Indexes...> index, invoke_signature_type<void, Args...>)
+			{
+				std::tuple<typename try_get_traits<Args>::result_type...> args{ try_get<Args>(state, Indexes)... };
+				if (!_converted_all<F>(args, index))
+				{
+					return ARGUMENT_TYPE_MISMATCH;
+				}
+				invoke(f, std::forward<typename try_get_traits<Args>::get_type>(*std::get<Indexes - 1>(args))...);
+				return 0;
 			}
 
 			inline std::string join(const char* delim)
@@ -192,7 +257,12 @@ namespace kaguya
 			template<class MemType, class T, class unusedindex>
 			int _call_apply(lua_State* state, MemType T::* m, unusedindex, MemType T::*)
 			{
-				T* this_ = lua_type_traits<T*>::get(state, 1);
+				typename try_get_traits<T*>::result_type self = try_get<T*>(state, 1);
+				if (!self)
+				{
+					return ARGUMENT_TYPE_MISMATCH;
+				}
+				T* this_ = *self;
 				if (lua_gettop(state) == 1)
 				{
 					if (!this_)
@@ -200,7 +270,7 @@ namespace kaguya
 						const T* this_ = lua_type_traits<const T*>::get(state, 1);
 						if (!this_)
 						{
-							throw LuaTypeMismatch("type mismatch!!");
+							return ARGUMENT_TYPE_MISMATCH;
 						}
 						if (is_usertype<MemType>::value && !traits::is_pointer<MemType>::value)
 						{
@@ -227,7 +297,7 @@ namespace kaguya
 				{
 					if (!this_ || !lua_type_traits<MemType>::checkType(state, 2))
 					{
-						throw LuaTypeMismatch("type mismatch!!");
+						return ARGUMENT_TYPE_MISMATCH;
 					}
 					this_->*m = lua_type_traits<MemType>::get(state, 2);
 					return 0;
@@ -280,9 +350,14 @@ namespace kaguya
 			template <class ClassType, class... Args, size_t... Indexes>
 			int _call_apply(lua_State* state, constructor_signature_type<ClassType, Args...>, index_tuple<Indexes...>, constructor_signature_type<ClassType, Args...>)
 			{
+				std::tuple<typename try_get_traits<Args>::result_type...> args{ try_get<Args>(state, Indexes)... };
+				if (!all_true(bool(std::get<Indexes - 1>(args))...))
+				{
+					return ARGUMENT_TYPE_MISMATCH;
+				}
 				typedef ObjectWrapper<ClassType> wrapper_type;
 				void *storage = lua_newuserdata(state, sizeof(wrapper_type));
-				new(storage) wrapper_type(lua_type_traits<Args>::get(state, Indexes)...);
+				new(storage) wrapper_type(std::forward<typename try_get_traits<Args>::get_type>(*std::get<Indexes - 1>(args))...);
 
 				class_userdata::setmetatable<ClassType>(state);
 				return 1;
@@ -9,6 +9,7 @@
 #include <cstring>
 #include <typeinfo>
 #include <algorithm>
+#include <iosfwd>
 
 #include "kaguya/config.hpp"
 #include "kaguya/traits.hpp"
@@ -20,10 +21,17 @@ namespace kaguya
 	{
 		template<typename T>
 		struct typetag {};
+
+		//! tag for construct object from result of function call.
+		struct emplace_result_tag {};
 	}
 
 #define KAGUYA_METATABLE_PREFIX "kaguya_object_type_"
 #define KAGUYA_METATABLE_TYPE_NAME_KEY -212114
+#define KAGUYA_METATABLE_COPY_FUNCTION_KEY -212115
+#define KAGUYA_METATABLE_SERIALIZE_FUNCTION_KEY -212116
+#define KAGUYA_METATABLE_BASES_KEY -212117
+#define KAGUYA_METATABLE_INHERITED_MEMBERS_KEY -212118
 
 	template<typename T>
 	inline const std::string& metatableName()
@@ -71,10 +79,35 @@ namespace kaguya
 			}
 			return false;
 		}
+		/**
+		* @brief create metatable like luaL_newmetatable, with hash part pre-sized for member_count fields.
+		* Kaguya internal fields are counted. If already registered, push it and return false.
+		*/
+		inline bool newmetatable(lua_State* l, const char* metatablename, int member_count)
+		{
+			lua_getfield(l, LUA_REGISTRYINDEX, metatablename);
+			if (!lua_isnil(l, -1))
+			{
+				return false;
+			}
+			lua_pop(l, 1);
+			lua_createtable(l, 0, member_count + 2);
+			lua_pushstring(l, metatablename);
+			lua_setfield(l, -2, "__name");
+			lua_pushstring(l, metatablename);
+			lua_rawseti(l, -2, KAGUYA_METATABLE_TYPE_NAME_KEY);
+			lua_pushvalue(l, -1);
+			lua_setfield(l, LUA_REGISTRYINDEX, metatablename);
+			return true;
+		}
 		template<typename T>bool newmetatable(lua_State* l)
 		{
 			return newmetatable(l, metatableName<T>().c_str());
 		}
+		template<typename T>bool newmetatable(lua_State* l, int member_count)
+		{
+			return newmetatable(l, metatableName<T>().c_str(), member_count);
+		}
 		template<typename T>void setmetatable(lua_State* l)
 		{
 			if (available_metatable<T>(l))
@@ -147,6 +180,9 @@ namespace kaguya
 #if KAGUYA_USE_CPP11
 		template<class... Args>
 		ObjectWrapper(Args&&... args) : object_(std::forward<Args>(args)...) {}
+		//! construct object from return value of f() without intermediate copy.
+		template<class F>
+		ObjectWrapper(types::emplace_result_tag, const F& f) : object_(f()) {}
 #else
 
 		ObjectWrapper() : object_() {}
@@ -196,28 +232,39 @@ namespace kaguya
 	};
 
 
+	//! base of shared_ptr holder. owner is used for conversion to shared_ptr of base class.
 	struct ObjectSharedPointerWrapper : ObjectWrapperBase
 	{
+		virtual standard::shared_ptr<void> object()const = 0;
+		virtual const std::type_info& shared_ptr_type()const = 0;
+	};
 
-		template<typename T>
-		ObjectSharedPointerWrapper(const standard::shared_ptr<T>& sptr) :object_(sptr), type_(metatableType<T>()),
-			shared_ptr_type_(metatableType<standard::shared_ptr<T> >()) {}
+	/**
+	* @brief hold shared_ptr<T> without type erasure.
+	* T* and T& are borrowed from held pointer, reference count is changed only if shared_ptr is taken.
+	*/
+	template<class T>
+	struct ObjectTypedSharedPointerWrapper : ObjectSharedPointerWrapper
+	{
+		ObjectTypedSharedPointerWrapper(const standard::shared_ptr<T>& sptr) :object_(sptr) {}
 #if KAGUYA_USE_RVALUE_REFERENCE
-		template<typename T>
-		ObjectSharedPointerWrapper(standard::shared_ptr<T>&& sptr) : object_(std::move(sptr)), type_(metatableType<T>()),
-			shared_ptr_type_(metatableType<standard::shared_ptr<T> >()) {}
+		ObjectTypedSharedPointerWrapper(standard::shared_ptr<T>&& sptr) : object_(std::move(sptr)) {}
 #endif
 		virtual bool is_native_type(const std::type_info& type)
 		{
-			return shared_ptr_type_ == type;
+			return metatableType<standard::shared_ptr<T> >() == type;
 		}
 		virtual const std::type_info& type()
 		{
-			return type_;
+			return metatableType<T>();
 		}
 		virtual void* get()
 		{
-			return object_.get();
+			if (traits::is_const<T>::value)
+			{
+				return 0;
+			}
+			return const_cast<void*>(static_cast<const void*>(object_.get()));
 		}
 		virtual const void* cget()
 		{
@@ -226,13 +273,16 @@ namespace kaguya
 		virtual const void* native_cget() { return &object_; };
 		virtual void* native_get() { return &object_; };
 
-		const standard::shared_ptr<void> object()const { return object_; }
-		const std::type_info& shared_ptr_type()const { return shared_ptr_type_; }
+		virtual standard::shared_ptr<void> object()const
+		{
+			return standard::const_pointer_cast<typename traits::remove_const<T>::type>(object_);
+		}
+		virtual const std::type_info& shared_ptr_type()const
+		{
+			return metatableType<standard::shared_ptr<T> >();
+		}
 	private:
-		standard::shared_ptr<void> object_;
-		const std::type_info& type_;
-
-		const std::type_info& shared_ptr_type_;
+		standard::shared_ptr<T> object_;
 	};
 
 	template<class T>
@@ -318,15 +368,8 @@ namespace kaguya
 		{
 			return static_cast<T*>(static_cast<F*>(from));
 		}
-		template<typename T, typename F>
-		static standard::shared_ptr<void> base_shared_pointer_cast(const standard::shared_ptr<void>& from)
-		{
-			return standard::shared_ptr<T>(standard::static_pointer_cast<F>(from));
-		}
-
 
 		typedef void* (*convert_function_type)(void*);
-		typedef standard::shared_ptr<void>(*shared_ptr_convert_function_type)(const standard::shared_ptr<void>&);
 		typedef std::pair<std::string, std::string> convert_map_key;
 
 
@@ -334,7 +377,6 @@ namespace kaguya
 		void add_type_conversion()
 		{
 			add_function(metatableType<ToType>(), metatableType<FromType>(), &base_pointer_cast<ToType, FromType>);
-			add_function(metatableType<standard::shared_ptr<ToType> >(), metatableType<standard::shared_ptr<FromType> >(), &base_shared_pointer_cast<ToType, FromType>);
 		}
 
 
@@ -373,21 +415,16 @@ namespace kaguya
 		template<typename TO>
 		standard::shared_ptr<TO> get_shared_pointer(ObjectWrapperBase* from)const
 		{
-			const std::type_info& to_type = metatableType<standard::shared_ptr<TO> >();
 			ObjectSharedPointerWrapper* ptr = dynamic_cast<ObjectSharedPointerWrapper*>(from);
 			if (!ptr) {
 				return standard::shared_ptr<TO>();
 			}
-			if (to_type == from->type())
-			{
-				return standard::static_pointer_cast<TO>(ptr->object());
-			}
-			std::map<convert_map_key, std::vector<shared_ptr_convert_function_type> >::const_iterator match = shared_ptr_function_map_.find(convert_map_key(to_type.name(), ptr->shared_ptr_type().name()));
-			if (match != shared_ptr_function_map_.end())
-			{
-				return standard::static_pointer_cast<TO>(pcvt_list_apply(ptr->object(), match->second));
+			const TO* converted = get_const_pointer<TO>(from);
+			if (!converted) {
+				return standard::shared_ptr<TO>();
 			}
-			return standard::shared_ptr<TO>();
+			//share ownership with held pointer
+			return standard::shared_ptr<TO>(ptr->object(), const_cast<TO*>(converted));
 		}
 		standard::shared_ptr<void> get_shared_pointer(ObjectWrapperBase* from)const
 		{
@@ -409,10 +446,11 @@ namespace kaguya
 		{
 			return get_const_pointer<T>(from);
 		}
+		//! for type check. return pointer without copy of shared_ptr
 		template<class T>
-		standard::shared_ptr<T> get_pointer(ObjectWrapperBase* from, types::typetag<standard::shared_ptr<T> > tag)
+		const T* get_pointer(ObjectWrapperBase* from, types::typetag<standard::shared_ptr<T> > tag)
 		{
-			return get_shared_pointer<T>(from);
+			return dynamic_cast<ObjectSharedPointerWrapper*>(from) ? get_const_pointer<T>(from) : 0;
 		}
 
 
@@ -436,9 +474,9 @@ namespace kaguya
 			else
 			{
 				void* ptr = lua_newuserdata(state, sizeof(PointerConverter));//dummy data for gc call
-				if (!ptr) { throw std::runtime_error("critical error. maybe failed memory allocation"); }//critical error
+				if (!ptr) { KAGUYA_THROW(std::runtime_error("critical error. maybe failed memory allocation")); }//critical error
 				PointerConverter* converter = new(ptr) PointerConverter();
-				if (!converter) { throw std::runtime_error("critical error. maybe failed memory allocation"); }//critical error
+				if (!converter) { KAGUYA_THROW(std::runtime_error("critical error. maybe failed memory allocation")); }//critical error
 
 				lua_createtable(state, 0, 0);
 				lua_pushcclosure(state, &deleter, 0);
@@ -479,33 +517,6 @@ namespace kaguya
 			std::vector<convert_function_type> flist; flist.push_back(f);
 			function_map_[convert_map_key(to_type.name(), from_type.name())] = flist;
 		}
-		void add_function(const std::type_info& to_type, const std::type_info& from_type, shared_ptr_convert_function_type f)
-		{
-			std::map<convert_map_key, std::vector<shared_ptr_convert_function_type> > add_map;
-			for (std::map<convert_map_key, std::vector<shared_ptr_convert_function_type> >::iterator it = shared_ptr_function_map_.begin();
-			it != shared_ptr_function_map_.end(); ++it)
-			{
-//				if (it->first.first == from_type.name())
-//				{
-//					std::vector<shared_ptr_convert_function_type> newlist = it->second;
-//					newlist.push_back(f);
-//					add_map[convert_map_key(to_type.name(), it->first.second)] = newlist;
-//				}
-
-				if (it->first.second == to_type.name())
-				{
-					std::vector<shared_ptr_convert_function_type> newlist;
-					newlist.push_back(f);
-					newlist.insert(newlist.end(), it->second.begin(), it->second.end());
-					add_map[convert_map_key(it->first.first, from_type.name())] = newlist;
-				}
-			}
-			shared_ptr_function_map_.insert(add_map.begin(), add_map.end());
-
-			std::vector<shared_ptr_convert_function_type> flist; flist.push_back(f);
-			shared_ptr_function_map_[convert_map_key(to_type.name(), from_type.name())] = flist;
-		}
-
 		void* pcvt_list_apply(void* ptr, const std::vector<convert_function_type>& flist)const
 		{
 			for (std::vector<convert_function_type>::const_iterator i = flist.begin(); i != flist.end(); ++i)
@@ -514,25 +525,10 @@ namespace kaguya
 			}
 			return ptr;
 		}
-		standard::shared_ptr<void> pcvt_list_apply(standard::shared_ptr<void> ptr, const std::vector<shared_ptr_convert_function_type>& flist)const
-		{
-			for (std::vector<shared_ptr_convert_function_type>::const_iterator i = flist.begin(); i != flist.end(); ++i)
-			{
-
-#if KAGUYA_USE_CPP11
-				ptr = (*i)(std::move(ptr));
-#else
-				ptr = (*i)(ptr);
-#endif
-			}
-			return ptr;
-		}
-
 
 		PointerConverter() {}
 
 		std::map<convert_map_key, std::vector<convert_function_type> > function_map_;
-		std::map<convert_map_key, std::vector<shared_ptr_convert_function_type> > shared_ptr_function_map_;
 
 
 
@@ -664,6 +660,204 @@ namespace kaguya
 
 
 
+	namespace class_userdata
+	{
+		//! push copy of userdata at index in from state to another state.return false if can not copy
+		typedef bool(*copy_function_type)(lua_State* from, int index, lua_State* to);
+
+		template<typename T>bool copy_object(lua_State* from, int index, lua_State* to)
+		{
+			const T* pointer = get_const_pointer(from, index, types::typetag<T>());
+			if (!pointer)
+			{
+				return false;
+			}
+			return lua_type_traits<T>::push(to, *pointer) == 1;
+		}
+
+		//! set copy function to metatable at metatable_index
+		inline void set_copy_function(lua_State* l, int metatable_index, copy_function_type f)
+		{
+			if (metatable_index < 0)
+			{
+				metatable_index = lua_gettop(l) + 1 + metatable_index;
+			}
+			copy_function_type* storage = static_cast<copy_function_type*>(lua_newuserdata(l, sizeof(copy_function_type)));
+			*storage = f;
+			lua_rawseti(l, metatable_index, KAGUYA_METATABLE_COPY_FUNCTION_KEY);
+		}
+		//! get copy function from metatable of userdata at index. return 0 if not registered
+		inline copy_function_type get_copy_function(lua_State* l, int index)
+		{
+			copy_function_type f = 0;
+			if (lua_getmetatable(l, index))
+			{
+				lua_rawgeti(l, -1, KAGUYA_METATABLE_COPY_FUNCTION_KEY);
+				copy_function_type* storage = static_cast<copy_function_type*>(lua_touserdata(l, -1));
+				if (storage)
+				{
+					f = *storage;
+				}
+				lua_pop(l, 2);
+			}
+			return f;
+		}
+
+		//! write userdata at index to stream.return false if can not serialize
+		typedef bool(*serialize_function_type)(lua_State* l, int index, std::ostream& os);
+		//! push object restored from data written by serialize_function_type.return false if can not deserialize
+		typedef bool(*deserialize_function_type)(lua_State* l, const char* data, size_t size);
+
+		struct serialize_functions
+		{
+			serialize_function_type serialize;
+			deserialize_function_type deserialize;
+		};
+
+		//! set serialize functions to metatable at metatable_index
+		inline void set_serialize_functions(lua_State* l, int metatable_index, serialize_function_type serialize, deserialize_function_type deserialize)
+		{
+			if (metatable_index < 0)
+			{
+				metatable_index = lua_gettop(l) + 1 + metatable_index;
+			}
+			serialize_functions* storage = static_cast<serialize_functions*>(lua_newuserdata(l, sizeof(serialize_functions)));
+			storage->serialize = serialize;
+			storage->deserialize = deserialize;
+			lua_rawseti(l, metatable_index, KAGUYA_METATABLE_SERIALIZE_FUNCTION_KEY);
+		}
+		//! get serialize functions from metatable at metatable_index. return 0 if not registered
+		inline const serialize_functions* get_serialize_functions_from_metatable(lua_State* l, int metatable_index)
+		{
+			lua_rawgeti(l, metatable_index, KAGUYA_METATABLE_SERIALIZE_FUNCTION_KEY);
+			const serialize_functions* storage = static_cast<const serialize_functions*>(lua_touserdata(l, -1));
+			lua_pop(l, 1);
+			return storage;//kept alive by metatable
+		}
+
+		//! set array of base class metatables on top of stack to metatable at metatable_index. pop the array.
+		inline void set_base_metatables(lua_State* l, int metatable_index)
+		{
+			lua_rawseti(l, metatable_index, KAGUYA_METATABLE_BASES_KEY);
+		}
+		inline void copy_base_members(lua_State* l, int target_index, int metatable_index, int inherited_index)
+		{
+			lua_rawgeti(l, metatable_index, KAGUYA_METATABLE_BASES_KEY);
+			if (!lua_istable(l, -1))
+			{
+				lua_pop(l, 1);
+				return;
+			}
+			int bases_index = lua_gettop(l);
+			for (int i = 1;; ++i)
+			{
+				lua_rawgeti(l, bases_index, i);
+				if (!lua_istable(l, -1))
+				{
+					lua_pop(l, 1);
+					break;
+				}
+				int base_index = lua_gettop(l);
+				lua_pushnil(l);
+				while (lua_next(l, base_index))
+				{
+					//metamethods are not inherited
+					if (lua_type(l, -2) == LUA_TSTRING && std::strncmp(lua_tostring(l, -2), "__", 2) != 0)
+					{
+						lua_pushvalue(l, -2);
+						lua_rawget(l, target_index);
+						bool exists = !lua_isnil(l, -1);
+						lua_pop(l, 1);
+						if (!exists)
+						{
+							lua_pushvalue(l, -2);
+							lua_pushvalue(l, -2);
+							lua_rawset(l, target_index);
+							lua_pushvalue(l, -2);
+							lua_pushvalue(l, -2);
+							lua_rawset(l, inherited_index);
+						}
+					}
+					lua_pop(l, 1);
+				}
+				//members of base of base
+				copy_base_members(l, target_index, base_index, inherited_index);
+				lua_pop(l, 1);
+			}
+			lua_pop(l, 1);
+		}
+		/**
+		* @brief copy members of all base class metatables into metatable at metatable_index.
+		* Members already in the metatable are not overwritten. Metamethods("__" prefixed keys) are not copied.
+		* Members copied by previous call are removed before copy, if not overwritten after.
+		*/
+		inline void flatten_inherited_members(lua_State* l, int metatable_index)
+		{
+			util::ScopedSavedStack save(l);
+			if (metatable_index < 0)
+			{
+				metatable_index = lua_gettop(l) + 1 + metatable_index;
+			}
+			lua_rawgeti(l, metatable_index, KAGUYA_METATABLE_INHERITED_MEMBERS_KEY);
+			if (lua_istable(l, -1))
+			{
+				int old_index = lua_gettop(l);
+				lua_pushnil(l);
+				while (lua_next(l, old_index))
+				{
+					lua_pushvalue(l, -2);
+					lua_rawget(l, metatable_index);
+					if (lua_rawequal(l, -1, -2))
+					{
+						lua_pushvalue(l, -3);
+						lua_pushnil(l);
+						lua_rawset(l, metatable_index);
+					}
+					lua_pop(l, 2);
+				}
+			}
+			lua_pop(l, 1);
+
+			lua_newtable(l);
+			copy_base_members(l, metatable_index, metatable_index, lua_gettop(l));
+			lua_rawseti(l, metatable_index, KAGUYA_METATABLE_INHERITED_MEMBERS_KEY);
+		}
+		//! push "_prop_" prefixed key of property accessor, without std::string concatenation
+		inline void push_property_key(lua_State* l, const char* name, size_t length)
+		{
+			lua_pushliteral(l, "_prop_");
+			lua_pushlstring(l, name, length);
+			lua_concat(l, 2);
+		}
+		//! metatable at metatable_index has property accessor("_prop_" prefixed key)
+		inline bool has_property(lua_State* l, int metatable_index)
+		{
+			util::ScopedSavedStack save(l);
+			if (metatable_index < 0)
+			{
+				metatable_index = lua_gettop(l) + 1 + metatable_index;
+			}
+			lua_pushnil(l);
+			while (lua_next(l, metatable_index))
+			{
+				if (lua_type(l, -2) == LUA_TSTRING && std::strncmp(lua_tostring(l, -2), "_prop_", 6) == 0)
+				{
+					return true;
+				}
+				lua_pop(l, 1);
+			}
+			return false;
+		}
+		//! metatable at metatable_index is flattened by flatten_inherited_members
+		inline bool is_flattened(lua_State* l, int metatable_index)
+		{
+			lua_rawgeti(l, metatable_index, KAGUYA_METATABLE_INHERITED_MEMBERS_KEY);
+			bool flattened = lua_istable(l, -1);
+			lua_pop(l, 1);
+			return flattened;
+		}
+	}
+
 	template<class T>
 	standard::shared_ptr<T> get_shared_pointer(lua_State* l, int index, types::typetag<T> tag)
 	{
@@ -0,0 +1,133 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <new>
+
+#include "kaguya/config.hpp"
+
+namespace kaguya
+{
+	/**
+	* @brief minimal optional value. result of conversion that can fail without exception.
+	* @see try_get
+	*/
+	template<typename T>
+	class optional
+	{
+		typedef void (optional::*bool_type)() const;
+		void this_type_does_not_support_comparisons() const {}
+	public:
+		optional() :value_(0)
+		{
+		}
+		optional(const T& value) :value_(new(storage_.data) T(value))
+		{
+		}
+		optional(const optional& other) :value_(other.value_ ? new(storage_.data) T(*other.value_) : 0)
+		{
+		}
+#if KAGUYA_USE_RVALUE_REFERENCE
+		optional(T&& value) :value_(new(storage_.data) T(std::move(value)))
+		{
+		}
+		optional(optional&& other) :value_(other.value_ ? new(storage_.data) T(std::move(*other.value_)) : 0)
+		{
+		}
+#endif
+		~optional()
+		{
+			reset();
+		}
+		optional& operator=(const optional& other)
+		{
+			if (this != &other)
+			{
+				reset();
+				if (other.value_)
+				{
+					value_ = new(storage_.data) T(*other.value_);
+				}
+			}
+			return *this;
+		}
+
+		void reset()
+		{
+			if (value_)
+			{
+				value_->~T();
+				value_ = 0;
+			}
+		}
+
+		bool has_value()const { return value_ != 0; }
+
+		operator bool_type() const
+		{
+			return value_ ? &optional::this_type_does_not_support_comparisons : 0;
+		}
+
+		T& value() { return *value_; }
+		const T& value()const { return *value_; }
+		T& operator*() { return *value_; }
+		const T& operator*()const { return *value_; }
+		T* operator->() { return value_; }
+		const T* operator->()const { return value_; }
+
+		T value_or(const T& default_value)const
+		{
+			return value_ ? *value_ : default_value;
+		}
+	private:
+		union storage_type
+		{
+			char data[sizeof(T)];
+			long double align_double_;
+			long long align_integer_;
+			void* align_pointer_;
+		} storage_;
+		T* value_;
+	};
+
+	//! optional for reference get_type. hold pointer
+	template<typename T>
+	class optional<T&>
+	{
+		typedef void (optional::*bool_type)() const;
+		void this_type_does_not_support_comparisons() const {}
+	public:
+		optional() :value_(0)
+		{
+		}
+		optional(T& value) :value_(&value)
+		{
+		}
+
+		void reset()
+		{
+			value_ = 0;
+		}
+
+		bool has_value()const { return value_ != 0; }
+
+		operator bool_type() const
+		{
+			return value_ ? &optional::this_type_does_not_support_comparisons : 0;
+		}
+
+		T& value()const { return *value_; }
+		T& operator*()const { return *value_; }
+		T* operator->()const { return value_; }
+
+		T& value_or(T& default_value)const
+		{
+			return value_ ? *value_ : default_value;
+		}
+	private:
+		T* value_;
+	};
+}
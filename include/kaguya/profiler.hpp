@@ -0,0 +1,254 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "kaguya/config.hpp"
+
+#if KAGUYA_USE_CPP11
+#include <map>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <ostream>
+#include <algorithm>
+
+#include "kaguya/utility.hpp"
+#include "kaguya/native_function.hpp"
+#include "kaguya/chained_hook.hpp"
+
+namespace kaguya
+{
+	/**
+	* @brief sampling profiler of one lua_State.
+	* Lua call stack is sampled by instruction count hook, and aggregated by call stack and by function and source line.
+	* Native function calls dispatched by kaguya are timed at entry and exit, and aggregated by called name.
+	* Coroutines created while running inherit the sampling hook. Coroutines created before start are not sampled.
+	* Hook installed before start(e.g. ScopedExecutionLimit) is called from the sampling hook, and restored at stop.
+	* Hooks installed after start must be removed before stop.
+	* If not started, there is no hook and no timing.
+	*/
+	class Profiler :public nativefunction::NativeCallObserver
+	{
+	public:
+		struct NativeCallStats
+		{
+			NativeCallStats() :calls(0), total(0), max(0) {}
+			size_t calls;
+			std::chrono::nanoseconds total;//!< including Lua functions called from the native function
+			std::chrono::nanoseconds max;
+		};
+		typedef std::map<std::string, size_t> SampleCounts;
+		typedef std::map<std::string, NativeCallStats> NativeCalls;
+
+		/**
+		* @param state lua_State
+		* @param sample_interval instruction count between samples
+		*/
+		explicit Profiler(lua_State* state, int sample_interval = 1000) :state_(util::toMainThread(state)), interval_(sample_interval), running_(false), until_sample_(0), sample_count_(0)
+		{
+		}
+		~Profiler()
+		{
+			stop();
+		}
+
+		void start()
+		{
+			if (running_)
+			{
+				return;
+			}
+			set(state_, this);
+			nativefunction::add_observer(state_, this);
+			prev_hook_.save(state_);
+			until_sample_ = interval_;
+			lua_sethook(state_, &sampleHook, prev_hook_.mask(), prev_hook_.count(until_sample_));
+			running_ = true;
+		}
+		void stop()
+		{
+			if (!running_)
+			{
+				return;
+			}
+			prev_hook_.restore(state_);
+			nativefunction::remove_observer(state_, this);
+			set(state_, 0);
+			native_stack_.clear();
+			running_ = false;
+		}
+		bool running()const { return running_; }
+
+		int sampleInterval()const { return interval_; }
+		//! takes effect at next start
+		void setSampleInterval(int instructions) { interval_ = instructions; }
+
+		size_t sampleCount()const { return sample_count_; }
+		//! samples by call stack. key is frames from root to leaf separated by ';'
+		const SampleCounts& stackSamples()const { return stack_samples_; }
+		//! samples by running function and source line
+		const SampleCounts& lineSamples()const { return line_samples_; }
+		const NativeCalls& nativeCalls()const { return native_calls_; }
+
+		/**
+		* @brief write samples in collapsed stack format. e.g. "main (script.lua:0);update (script.lua:10) 42"
+		* Output can be read by flamegraph tools.
+		*/
+		void writeCollapsed(std::ostream& os)const
+		{
+			for (SampleCounts::const_iterator it = stack_samples_.begin(); it != stack_samples_.end(); ++it)
+			{
+				os << it->first << ' ' << it->second << '\n';
+			}
+		}
+
+		void clear()
+		{
+			sample_count_ = 0;
+			stack_samples_.clear();
+			line_samples_.clear();
+			native_calls_.clear();
+		}
+
+		virtual void enter(lua_State* state)
+		{
+			native_stack_.push_back(NativeFrame(nativefunction::called_function_name(state), std::chrono::steady_clock::now()));
+		}
+		virtual void leave(lua_State*, int)
+		{
+			if (native_stack_.empty())
+			{
+				return;
+			}
+			std::chrono::nanoseconds elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - native_stack_.back().second);
+			NativeCallStats& stats = native_calls_[native_stack_.back().first];
+			native_stack_.pop_back();
+			stats.calls++;
+			stats.total += elapsed;
+			if (stats.max < elapsed)
+			{
+				stats.max = elapsed;
+			}
+		}
+
+	private:
+		typedef std::pair<const char*, std::chrono::steady_clock::time_point> NativeFrame;
+
+		static void* registryKey()
+		{
+			static char key;
+			return &key;
+		}
+		static Profiler* get(lua_State* state)
+		{
+			util::ScopedSavedStack save(state);
+			lua_pushlightuserdata(state, registryKey());
+			lua_rawget(state, LUA_REGISTRYINDEX);
+			return static_cast<Profiler*>(lua_touserdata(state, -1));
+		}
+		static void set(lua_State* state, Profiler* profiler)
+		{
+			util::ScopedSavedStack save(state);
+			lua_pushlightuserdata(state, registryKey());
+			if (profiler)
+			{
+				lua_pushlightuserdata(state, profiler);
+			}
+			else
+			{
+				lua_pushnil(state);
+			}
+			lua_rawset(state, LUA_REGISTRYINDEX);
+		}
+
+		static void sampleHook(lua_State* l, lua_Debug* ar)
+		{
+			Profiler* profiler = get(l);
+			if (!profiler)
+			{
+				//coroutine created while running, and resumed after stop.
+				lua_sethook(l, 0, 0, 0);
+				return;
+			}
+			util::ChainedHook& prev = profiler->prev_hook_;
+			if (ar->event != LUA_HOOKCOUNT)
+			{
+				prev.call(l, ar, 0);
+				return;
+			}
+			int executed = lua_gethookcount(l);
+			profiler->until_sample_ -= executed;
+			if (profiler->until_sample_ <= 0)
+			{
+				profiler->sample(l);
+				profiler->until_sample_ = profiler->interval_;
+			}
+			prev.call(l, ar, executed);//may raise error
+			lua_sethook(l, &sampleHook, prev.mask(), prev.count(profiler->until_sample_));
+		}
+
+		static std::string frameName(const lua_Debug& ar, int line)
+		{
+			std::string name = ar.name ? ar.name : (*ar.what == 'm' ? "main" : "?");
+			if (*ar.what == 'C')
+			{
+				return name + " [C]";
+			}
+			std::string source = ar.short_src;
+			std::replace(source.begin(), source.end(), ';', ',');//frame separator of collapsed stack
+			return name + " (" + source + ":" + std::to_string(line) + ")";
+		}
+
+		void sample(lua_State* l)
+		{
+			frames_.clear();
+			lua_Debug ar;
+			for (int level = 0; lua_getstack(l, level, &ar); ++level)
+			{
+				if (!lua_getinfo(l, "Sln", &ar))
+				{
+					break;
+				}
+				if (level == 0)
+				{
+					line_samples_[frameName(ar, ar.currentline)]++;
+				}
+				frames_.push_back(frameName(ar, ar.linedefined));
+			}
+			if (frames_.empty())
+			{
+				return;
+			}
+			std::string stack;
+			for (std::vector<std::string>::reverse_iterator it = frames_.rbegin(); it != frames_.rend(); ++it)
+			{
+				if (!stack.empty())
+				{
+					stack += ';';
+				}
+				stack += *it;
+			}
+			stack_samples_[stack]++;
+			sample_count_++;
+		}
+
+		Profiler(const Profiler&);
+		Profiler& operator=(const Profiler&);
+
+		lua_State* state_;
+		int interval_;
+		bool running_;
+		util::ChainedHook prev_hook_;
+		int until_sample_;
+		size_t sample_count_;
+		SampleCounts stack_samples_;
+		SampleCounts line_samples_;
+		NativeCalls native_calls_;
+		std::vector<NativeFrame> native_stack_;
+		std::vector<std::string> frames_;
+	};
+}
+#endif
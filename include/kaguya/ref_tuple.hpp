@@ -6,6 +6,7 @@
 #pragma once
 
 #include "kaguya/config.hpp"
+#include "kaguya/type.hpp"
 
 namespace kaguya
 {
@@ -0,0 +1,292 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "kaguya/config.hpp"
+
+#if KAGUYA_USE_CPP11
+#include <map>
+#include <deque>
+#include <chrono>
+#include <functional>
+
+#include "kaguya/lua_ref.hpp"
+#include "kaguya/lua_ref_function.hpp"
+#include "kaguya/chained_hook.hpp"
+
+namespace kaguya
+{
+	class TimeSliceScheduler;
+
+	/**
+	* @brief coroutine run by TimeSliceScheduler, with CPU accounting.
+	*/
+	class ScheduledThread
+	{
+	public:
+		ScheduledThread(const LuaThread& thread, int priority, int budget) :thread_(thread), priority_(priority), budget_(budget)
+			, resume_count_(0), preempt_count_(0), cpu_time_(0), finished_(false)
+		{
+		}
+
+		const LuaThread& thread()const { return thread_; }
+		int priority()const { return priority_; }
+		//! instruction count of one time slice
+		int budget()const { return budget_; }
+
+		//! number of time slices
+		size_t resumeCount()const { return resume_count_; }
+		//! number of time slices ended by budget
+		size_t preemptCount()const { return preempt_count_; }
+		//! wall clock time spent in resume
+		std::chrono::nanoseconds cpuTime()const { return cpu_time_; }
+
+		//! coroutine returned or dead by error
+		bool finished()const { return finished_; }
+	private:
+		friend class TimeSliceScheduler;
+
+		LuaThread thread_;
+		int priority_;
+		int budget_;
+		size_t resume_count_;
+		size_t preempt_count_;
+		std::chrono::nanoseconds cpu_time_;
+		bool finished_;
+		util::ChainedHook prev_hook_;//!< hook of the coroutine out of time slice
+	};
+
+	/**
+	* @brief run many coroutines in one lua_State by time slice.
+	* Highest priority coroutine runs first, same priority coroutines run round-robin.
+	* Time slice ends by coroutine.yield, or by instruction count hook when the budget is spent.
+	* Budget can not end a slice while the coroutine is inside C function call(e.g. pcall or C++ function call Lua function).
+	* In that case slice ends soon after the call returned.
+	* Preemption by budget requires Lua 5.3 or later, other versions use explicit yield only.
+	* Hook of the coroutine(e.g. inherited ScopedExecutionLimit or Profiler) is called from the slice hook, and restored after the slice.
+	* One scheduler per lua_State.
+	*/
+	class TimeSliceScheduler
+	{
+	public:
+		typedef standard::shared_ptr<ScheduledThread> ThreadPtr;
+
+		/**
+		* @param state lua_State
+		* @param budget default instruction count of one time slice
+		*/
+		explicit TimeSliceScheduler(lua_State* state, int budget = 10000) :state_(util::toMainThread(state)), budget_(budget), current_(0), current_thread_(0), preempted_(false), remaining_(0), thread_count_(0)
+		{
+			util::ScopedSavedStack save(state_);
+			lua_pushlightuserdata(state_, registryKey());
+			lua_pushlightuserdata(state_, this);
+			lua_settable(state_, LUA_REGISTRYINDEX);
+		}
+		~TimeSliceScheduler()
+		{
+			util::ScopedSavedStack save(state_);
+			lua_pushlightuserdata(state_, registryKey());
+			lua_pushnil(state_);
+			lua_settable(state_, LUA_REGISTRYINDEX);
+		}
+
+		/**
+		* @brief add function as new coroutine.
+		* @param f function
+		* @param priority higher runs first
+		* @param budget instruction count of one time slice. 0 is default budget of scheduler
+		*/
+		ThreadPtr spawn(const LuaFunction& f, int priority = 0, int budget = 0)
+		{
+			LuaThread thread(state_);
+			thread.setFunction(f);
+			return add(thread, priority, budget);
+		}
+		//! add suspended or not started coroutine
+		ThreadPtr add(const LuaThread& thread, int priority = 0, int budget = 0)
+		{
+			ThreadPtr scheduled = standard::make_shared<ScheduledThread>(thread, priority, budget > 0 ? budget : budget_);
+			ready_[priority].push_back(scheduled);
+			thread_count_++;
+			return scheduled;
+		}
+
+		/**
+		* @brief run one time slice of next coroutine.
+		* @return If there are no coroutines, return false.
+		*/
+		bool step()
+		{
+			if (ready_.empty())
+			{
+				return false;
+			}
+			ready_queue_type::iterator queue = ready_.begin();
+			ThreadPtr scheduled = queue->second.front();
+			queue->second.pop_front();
+			if (queue->second.empty())
+			{
+				ready_.erase(queue);
+			}
+
+			lua_State* thread = scheduled->thread_.get<lua_State*>();
+			if (!thread)
+			{
+				finish(*scheduled);
+				return true;
+			}
+#if LUA_VERSION_NUM >= 503
+			util::ChainedHook& prev = scheduled->prev_hook_;
+			prev.save(thread);
+			remaining_ = scheduled->budget_;
+			lua_sethook(thread, &countHook, prev.mask(), prev.count(remaining_));
+#endif
+			current_ = scheduled.get();
+			current_thread_ = thread;
+			preempted_ = false;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			scheduled->thread_.resume<void>();
+			scheduled->cpu_time_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+			current_ = 0;
+			current_thread_ = 0;
+#if LUA_VERSION_NUM >= 503
+			scheduled->prev_hook_.restore(thread);
+#endif
+			scheduled->resume_count_++;
+			if (preempted_)
+			{
+				scheduled->preempt_count_++;
+			}
+			if (lua_status(thread) == LUA_YIELD)
+			{
+				ready_[scheduled->priority_].push_back(scheduled);
+			}
+			else
+			{
+				finish(*scheduled);
+			}
+			return true;
+		}
+
+		/**
+		* @brief run until all coroutines finished.
+		* @return number of time slices
+		*/
+		size_t run()
+		{
+			size_t count = 0;
+			while (step())
+			{
+				count++;
+			}
+			return count;
+		}
+
+		/**
+		* @brief run time slices until duration is elapsed or all coroutines finished.
+		* Last slice may exceed the duration.
+		* @return number of time slices
+		*/
+		template<class Rep, class Period>
+		size_t runFor(const std::chrono::duration<Rep, Period>& duration)
+		{
+			std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + duration;
+			size_t count = 0;
+			while (std::chrono::steady_clock::now() < end && step())
+			{
+				count++;
+			}
+			return count;
+		}
+
+		//! number of coroutines not finished
+		size_t threadCount()const { return thread_count_; }
+
+		//! coroutine running now. If not in time slice, return null
+		const ScheduledThread* current()const { return current_; }
+
+		int budget()const { return budget_; }
+		void setBudget(int budget) { budget_ = budget; }
+
+	private:
+		typedef std::map<int, std::deque<ThreadPtr>, std::greater<int> > ready_queue_type;
+
+		//! instruction count for retry, if hook is called where can not yield
+		static const int RETRY_COUNT = 100;
+
+		static void* registryKey()
+		{
+			static char key;
+			return &key;
+		}
+		static TimeSliceScheduler* get(lua_State* state)
+		{
+			util::ScopedSavedStack save(state);
+			lua_pushlightuserdata(state, registryKey());
+			lua_rawget(state, LUA_REGISTRYINDEX);
+			return static_cast<TimeSliceScheduler*>(lua_touserdata(state, -1));
+		}
+
+#if LUA_VERSION_NUM >= 503
+		static void countHook(lua_State* l, lua_Debug* ar)
+		{
+			TimeSliceScheduler* scheduler = get(l);
+			if (!scheduler || !scheduler->current_)
+			{
+				//coroutine created in time slice inherits hook, and resumed after the slice.
+				lua_sethook(l, 0, 0, 0);
+				return;
+			}
+			util::ChainedHook& prev = scheduler->current_->prev_hook_;
+			if (scheduler->current_thread_ != l)
+			{
+				//coroutine created in time slice inherits hook. it is not scheduled, but keeps hook of scheduled coroutine.
+				prev.restore(l);
+				return;
+			}
+			if (ar->event != LUA_HOOKCOUNT)
+			{
+				prev.call(l, ar, 0);
+				return;
+			}
+			int executed = lua_gethookcount(l);
+			prev.call(l, ar, executed);//may raise error
+			scheduler->remaining_ -= executed;
+			if (scheduler->remaining_ > 0)
+			{
+				lua_sethook(l, &countHook, prev.mask(), prev.count(scheduler->remaining_));
+				return;
+			}
+			lua_sethook(l, &countHook, prev.mask(), prev.count(RETRY_COUNT));
+			if (!lua_isyieldable(l))
+			{
+				return;
+			}
+			scheduler->preempted_ = true;
+			lua_yield(l, 0);
+		}
+#endif
+
+		void finish(ScheduledThread& scheduled)
+		{
+			scheduled.finished_ = true;
+			thread_count_--;
+		}
+
+		TimeSliceScheduler(const TimeSliceScheduler&);
+		TimeSliceScheduler& operator=(const TimeSliceScheduler&);
+
+		lua_State* state_;
+		int budget_;
+		ScheduledThread* current_;
+		lua_State* current_thread_;
+		bool preempted_;
+		int remaining_;
+		size_t thread_count_;
+		ready_queue_type ready_;
+	};
+}
+#endif
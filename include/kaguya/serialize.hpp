@@ -0,0 +1,761 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <string>
+#include <cstring>
+#include <ostream>
+#include <sstream>
+
+#include "kaguya/config.hpp"
+#include "kaguya/utility.hpp"
+#include "kaguya/object.hpp"
+#include "kaguya/error_handler.hpp"
+#include "kaguya/lua_ref.hpp"
+
+namespace kaguya
+{
+	namespace util
+	{
+		/* binary format
+		* header  : "KGYB" version(1 byte)
+		* value   : tag(1 byte) payload
+		*   nil,false,true : no payload
+		*   integer        : zigzag varint
+		*   number         : IEEE754 double 8 bytes, little endian
+		*   string         : varint length, bytes. appended to string dictionary
+		*   string_ref     : varint index of string dictionary
+		*   table          : varint array count, array values, varint hash count, key value pairs
+		*   ref            : varint index of already written table or userdata
+		*   userdata       : value of metatable name(string or string_ref), varint size, bytes written by serialize function
+		*/
+		namespace serialize_format
+		{
+			enum Tag
+			{
+				TAG_NIL = 0,
+				TAG_FALSE,
+				TAG_TRUE,
+				TAG_INTEGER,
+				TAG_NUMBER,
+				TAG_STRING,
+				TAG_STRING_REF,
+				TAG_TABLE,
+				TAG_REF,
+				TAG_USERDATA
+			};
+			static const char magic[4] = { 'K','G','Y','B' };
+			static const unsigned char version = 1;
+
+			inline unsigned long long zigzag(long long v)
+			{
+				return (static_cast<unsigned long long>(v) << 1) ^ static_cast<unsigned long long>(v >> 63);
+			}
+			inline long long unzigzag(unsigned long long v)
+			{
+				return static_cast<long long>(v >> 1) ^ -static_cast<long long>(v & 1);
+			}
+		}
+
+		/**
+		* @brief write Lua value to output stream with binary format.
+		* Shared and cyclic table references are kept.
+		* Userdata are written by serialize function of metatable(@see UserdataMetatable::setSerializeFunction).
+		* Table metatables are not written. Tables nested deeper than KAGUYA_SERIALIZE_MAX_DEPTH are written as nil.
+		*/
+		class Serializer
+		{
+		public:
+			Serializer(lua_State* state, std::ostream& os) :state_(state), os_(os), seen_(0), string_count_(0), ref_count_(0), failed_type_(0), depth_(0), too_deep_(false), buffer_size_(0)
+			{
+			}
+
+			/**
+			* @brief write header and value at index.
+			* @return If all values were written, return true. Otherwise not serializable values are written as nil and return false.
+			*/
+			bool write(int index)
+			{
+				if (index < 0 && index > LUA_REGISTRYINDEX)
+				{
+					index = lua_gettop(state_) + 1 + index;
+				}
+				util::ScopedSavedStack save(state_);
+				lua_checkstack(state_, 4);
+				lua_newtable(state_);//seen map. string -> dictionary index, table or userdata -> ref index
+				seen_ = lua_gettop(state_);
+				writeBytes(serialize_format::magic, sizeof(serialize_format::magic));
+				writeByte(serialize_format::version);
+				writeValue(index);
+				flush();
+				seen_ = 0;
+				return failed_type_ == 0 && os_.good();
+			}
+
+			//! type name of first value that was not serializable. if all written return 0.
+			const char* failedTypeName()const { return failed_type_; }
+			//! true if failed by table nested deeper than KAGUYA_SERIALIZE_MAX_DEPTH
+			bool nestingTooDeep()const { return too_deep_; }
+
+		private:
+			void fail(int type)
+			{
+				if (!failed_type_)
+				{
+					failed_type_ = lua_typename(state_, type);
+				}
+				writeByte(serialize_format::TAG_NIL);
+			}
+			void flush()
+			{
+				if (buffer_size_)
+				{
+					os_.write(buffer_, buffer_size_);
+					buffer_size_ = 0;
+				}
+			}
+			void writeByte(unsigned char v)
+			{
+				if (buffer_size_ == sizeof(buffer_))
+				{
+					flush();
+				}
+				buffer_[buffer_size_++] = static_cast<char>(v);
+			}
+			void writeBytes(const char* data, size_t size)
+			{
+				if (buffer_size_ + size > sizeof(buffer_))
+				{
+					flush();
+					if (size > sizeof(buffer_))
+					{
+						os_.write(data, size);
+						return;
+					}
+				}
+				std::memcpy(buffer_ + buffer_size_, data, size);
+				buffer_size_ += size;
+			}
+			void writeVarint(unsigned long long v)
+			{
+				while (v >= 0x80)
+				{
+					writeByte(static_cast<unsigned char>(v | 0x80));
+					v >>= 7;
+				}
+				writeByte(static_cast<unsigned char>(v));
+			}
+			void writeInteger(long long v)
+			{
+				writeByte(serialize_format::TAG_INTEGER);
+				writeVarint(serialize_format::zigzag(v));
+			}
+			void writeNumber(double v)
+			{
+				unsigned long long bits = 0;
+				std::memcpy(&bits, &v, sizeof(bits));
+				writeByte(serialize_format::TAG_NUMBER);
+				for (int i = 0; i < 8; ++i)
+				{
+					writeByte(static_cast<unsigned char>(bits >> (i * 8)));
+				}
+			}
+
+			//! if already written, write reference and return true
+			bool writeSeen(int index, serialize_format::Tag ref_tag)
+			{
+				lua_pushvalue(state_, index);
+				lua_rawget(state_, seen_);
+				if (lua_isnil(state_, -1))
+				{
+					lua_pop(state_, 1);
+					return false;
+				}
+				writeByte(ref_tag);
+				writeVarint(static_cast<unsigned long long>(lua_tointeger(state_, -1)));
+				lua_pop(state_, 1);
+				return true;
+			}
+			void setSeen(int index, lua_Integer id)
+			{
+				lua_pushvalue(state_, index);
+				lua_pushinteger(state_, id);
+				lua_rawset(state_, seen_);
+			}
+
+			void writeValue(int index)
+			{
+				int type = lua_type(state_, index);
+				switch (type)
+				{
+				case LUA_TNIL:
+					writeByte(serialize_format::TAG_NIL);
+					break;
+				case LUA_TBOOLEAN:
+					writeByte(lua_toboolean(state_, index) ? serialize_format::TAG_TRUE : serialize_format::TAG_FALSE);
+					break;
+				case LUA_TNUMBER:
+				{
+#if LUA_VERSION_NUM >= 503
+					if (lua_isinteger(state_, index))
+					{
+						writeInteger(lua_tointeger(state_, index));
+						break;
+					}
+#else
+					lua_Number n = lua_tonumber(state_, index);
+					if (n >= -9.2e18 && n <= 9.2e18 && n == static_cast<lua_Number>(static_cast<long long>(n)))
+					{
+						writeInteger(static_cast<long long>(n));
+						break;
+					}
+#endif
+					writeNumber(static_cast<double>(lua_tonumber(state_, index)));
+					break;
+				}
+				case LUA_TSTRING:
+					writeString(index);
+					break;
+				case LUA_TTABLE:
+					writeTable(index);
+					break;
+				case LUA_TUSERDATA:
+					writeUserdata(index);
+					break;
+				default:
+					fail(type);
+					break;
+				}
+			}
+
+			void writeString(int index)
+			{
+				if (writeSeen(index, serialize_format::TAG_STRING_REF))
+				{
+					return;
+				}
+				setSeen(index, string_count_++);
+				size_t size = 0;
+				const char* str = lua_tolstring(state_, index, &size);
+				writeByte(serialize_format::TAG_STRING);
+				writeVarint(size);
+				writeBytes(str, size);
+			}
+
+			void writeTable(int index)
+			{
+				if (writeSeen(index, serialize_format::TAG_REF))
+				{
+					return;
+				}
+				if (depth_ >= KAGUYA_SERIALIZE_MAX_DEPTH)
+				{
+					too_deep_ = true;
+					fail(LUA_TTABLE);
+					return;
+				}
+				if (!lua_checkstack(state_, 5))
+				{
+					fail(LUA_TTABLE);
+					return;
+				}
+				setSeen(index, ref_count_++);
+				++depth_;
+#if LUA_VERSION_NUM >= 502
+				size_t array_size = lua_rawlen(state_, index);
+#else
+				size_t array_size = lua_objlen(state_, index);
+#endif
+				size_t hash_size = 0;
+				lua_pushnil(state_);
+				while (lua_next(state_, index) != 0)
+				{
+					lua_pop(state_, 1);
+					if (!isArrayKey(-1, array_size))
+					{
+						hash_size++;
+					}
+				}
+
+				writeByte(serialize_format::TAG_TABLE);
+				writeVarint(array_size);
+				for (size_t i = 1; i <= array_size; ++i)
+				{
+					lua_rawgeti(state_, index, static_cast<lua_Integer>(i));
+					writeValue(lua_gettop(state_));
+					lua_pop(state_, 1);
+				}
+				writeVarint(hash_size);
+				lua_pushnil(state_);
+				while (lua_next(state_, index) != 0)
+				{
+					int value = lua_gettop(state_);
+					if (!isArrayKey(value - 1, array_size))
+					{
+						writeValue(value - 1);
+						writeValue(value);
+					}
+					lua_settop(state_, value - 1);//keep key for next
+				}
+				--depth_;
+			}
+			bool isArrayKey(int index, size_t array_size)
+			{
+				if (lua_type(state_, index) != LUA_TNUMBER)
+				{
+					return false;
+				}
+				lua_Number key = lua_tonumber(state_, index);
+				return key >= 1 && key <= static_cast<lua_Number>(array_size) && key == static_cast<lua_Number>(static_cast<size_t>(key));
+			}
+
+			void writeUserdata(int index)
+			{
+				if (writeSeen(index, serialize_format::TAG_REF))
+				{
+					return;
+				}
+				if (!lua_checkstack(state_, 5))
+				{
+					fail(LUA_TUSERDATA);
+					return;
+				}
+				util::ScopedSavedStack save(state_);
+				const class_userdata::serialize_functions* functions = 0;
+				if (lua_getmetatable(state_, index))
+				{
+					int metatable = lua_gettop(state_);
+					functions = class_userdata::get_serialize_functions_from_metatable(state_, metatable);
+					lua_rawgeti(state_, metatable, KAGUYA_METATABLE_TYPE_NAME_KEY);
+				}
+				if (!functions || lua_type(state_, -1) != LUA_TSTRING)
+				{
+					fail(LUA_TUSERDATA);
+					return;
+				}
+				std::ostringstream payload;
+				if (!functions->serialize(state_, index, payload))
+				{
+					fail(LUA_TUSERDATA);
+					return;
+				}
+				setSeen(index, ref_count_++);
+				writeByte(serialize_format::TAG_USERDATA);
+				writeString(lua_gettop(state_));
+				const std::string& data = payload.str();
+				writeVarint(data.size());
+				writeBytes(data.data(), data.size());
+			}
+
+			lua_State* state_;
+			std::ostream& os_;
+			int seen_;
+			lua_Integer string_count_;
+			lua_Integer ref_count_;
+			const char* failed_type_;
+			int depth_;
+			bool too_deep_;
+			char buffer_[4096];
+			size_t buffer_size_;
+		};
+
+		/**
+		* @brief read Lua value written by Serializer from memory buffer.
+		* Strings are pushed from buffer directly without intermediate copy.
+		* Tables nested deeper than KAGUYA_SERIALIZE_MAX_DEPTH are rejected.
+		*/
+		class Deserializer
+		{
+		public:
+			Deserializer(lua_State* state, const char* data, size_t size) :state_(state), data_(data), end_(data + size), strings_(0), refs_(0), string_count_(0), ref_count_(0), depth_(0), error_(0)
+			{
+			}
+
+			/**
+			* @brief push value read from buffer.
+			* @return If succeeded, return true. Otherwise push nil and return false.
+			*/
+			bool read()
+			{
+				int top = lua_gettop(state_);
+				if (!lua_checkstack(state_, 5))
+				{
+					lua_pushnil(state_);
+					error_ = "stack overflow";
+					return false;
+				}
+				lua_newtable(state_);//string dictionary
+				strings_ = top + 1;
+				lua_newtable(state_);//table and userdata refs
+				refs_ = top + 2;
+
+				if (!readHeader() || !readValue())
+				{
+					lua_settop(state_, top);
+					lua_pushnil(state_);
+					return false;
+				}
+				lua_replace(state_, top + 1);
+				lua_settop(state_, top + 1);
+				return true;
+			}
+
+			//! error message of last read. if succeeded return 0.
+			const char* errorMessage()const { return error_; }
+
+		private:
+			bool fail(const char* message)
+			{
+				if (!error_)
+				{
+					error_ = message;
+				}
+				return false;
+			}
+			bool readHeader()
+			{
+				const char* header = readBytes(sizeof(serialize_format::magic) + 1);
+				if (!header || std::memcmp(header, serialize_format::magic, sizeof(serialize_format::magic)) != 0)
+				{
+					return fail("invalid header");
+				}
+				if (static_cast<unsigned char>(header[sizeof(serialize_format::magic)]) != serialize_format::version)
+				{
+					return fail("unsupported version");
+				}
+				return true;
+			}
+			const char* readBytes(size_t size)
+			{
+				if (static_cast<size_t>(end_ - data_) < size)
+				{
+					fail("unexpected end of data");
+					return 0;
+				}
+				const char* p = data_;
+				data_ += size;
+				return p;
+			}
+			bool readVarint(unsigned long long& v)
+			{
+				v = 0;
+				for (int shift = 0; shift < 64; shift += 7)
+				{
+					if (data_ == end_)
+					{
+						return fail("unexpected end of data");
+					}
+					unsigned char byte = static_cast<unsigned char>(*data_++);
+					v |= static_cast<unsigned long long>(byte & 0x7F) << shift;
+					if (!(byte & 0x80))
+					{
+						return true;
+					}
+				}
+				return fail("invalid varint");
+			}
+			bool readSize(size_t& size)
+			{
+				unsigned long long v = 0;
+				if (!readVarint(v))
+				{
+					return false;
+				}
+				if (v > static_cast<unsigned long long>(end_ - data_))
+				{//every element needs 1 byte at least
+					return fail("invalid size");
+				}
+				size = static_cast<size_t>(v);
+				return true;
+			}
+
+			//! push value. if failed, stack top is undefined
+			bool readValue()
+			{
+				if (data_ == end_)
+				{
+					return fail("unexpected end of data");
+				}
+				unsigned char tag = static_cast<unsigned char>(*data_++);
+				switch (tag)
+				{
+				case serialize_format::TAG_NIL:
+					lua_pushnil(state_);
+					return true;
+				case serialize_format::TAG_FALSE:
+					lua_pushboolean(state_, 0);
+					return true;
+				case serialize_format::TAG_TRUE:
+					lua_pushboolean(state_, 1);
+					return true;
+				case serialize_format::TAG_INTEGER:
+				{
+					unsigned long long v = 0;
+					if (!readVarint(v))
+					{
+						return false;
+					}
+#if LUA_VERSION_NUM >= 503
+					lua_pushinteger(state_, static_cast<lua_Integer>(serialize_format::unzigzag(v)));
+#else
+					lua_pushnumber(state_, static_cast<lua_Number>(serialize_format::unzigzag(v)));
+#endif
+					return true;
+				}
+				case serialize_format::TAG_NUMBER:
+				{
+					const char* p = readBytes(8);
+					if (!p)
+					{
+						return false;
+					}
+					unsigned long long bits = 0;
+					for (int i = 0; i < 8; ++i)
+					{
+						bits |= static_cast<unsigned long long>(static_cast<unsigned char>(p[i])) << (i * 8);
+					}
+					double v = 0;
+					std::memcpy(&v, &bits, sizeof(v));
+					lua_pushnumber(state_, static_cast<lua_Number>(v));
+					return true;
+				}
+				case serialize_format::TAG_STRING:
+				{
+					size_t size = 0;
+					if (!readSize(size))
+					{
+						return false;
+					}
+					const char* str = readBytes(size);
+					if (!str)
+					{
+						return false;
+					}
+					lua_pushlstring(state_, str, size);
+					lua_pushvalue(state_, -1);
+					lua_rawseti(state_, strings_, ++string_count_);
+					return true;
+				}
+				case serialize_format::TAG_STRING_REF:
+					return readRef(strings_, string_count_);
+				case serialize_format::TAG_TABLE:
+					return readTable();
+				case serialize_format::TAG_REF:
+					return readRef(refs_, ref_count_);
+				case serialize_format::TAG_USERDATA:
+					return readUserdata();
+				default:
+					return fail("invalid tag");
+				}
+			}
+			bool readRef(int table, lua_Integer count)
+			{
+				unsigned long long v = 0;
+				if (!readVarint(v))
+				{
+					return false;
+				}
+				if (v >= static_cast<unsigned long long>(count))
+				{
+					return fail("invalid reference");
+				}
+				lua_rawgeti(state_, table, static_cast<lua_Integer>(v) + 1);
+				return true;
+			}
+
+			bool readTable()
+			{
+				if (depth_ >= KAGUYA_SERIALIZE_MAX_DEPTH)
+				{
+					return fail("nesting too deep");
+				}
+				if (!lua_checkstack(state_, 5))
+				{
+					return fail("stack overflow");
+				}
+				++depth_;
+				bool result = readTableContents();
+				--depth_;
+				return result;
+			}
+			bool readTableContents()
+			{
+				size_t array_size = 0;
+				if (!readSize(array_size))
+				{
+					return false;
+				}
+				lua_createtable(state_, static_cast<int>(array_size), 0);
+				int table = lua_gettop(state_);
+				lua_pushvalue(state_, table);
+				lua_rawseti(state_, refs_, ++ref_count_);
+				for (size_t i = 1; i <= array_size; ++i)
+				{
+					if (!readValue())
+					{
+						return false;
+					}
+					if (lua_isnil(state_, -1))
+					{
+						lua_pop(state_, 1);
+					}
+					else
+					{
+						lua_rawseti(state_, table, static_cast<lua_Integer>(i));
+					}
+				}
+				size_t hash_size = 0;
+				if (!readSize(hash_size))
+				{
+					return false;
+				}
+				for (size_t i = 0; i < hash_size; ++i)
+				{
+					if (!readValue() || !readValue())
+					{
+						return false;
+					}
+					if (lua_isnil(state_, -2))
+					{//key was not serializable
+						lua_pop(state_, 2);
+					}
+					else
+					{
+						lua_rawset(state_, table);
+					}
+				}
+				return true;
+			}
+
+			bool readUserdata()
+			{
+				lua_Integer id = ++ref_count_;
+				if (!readValue())
+				{
+					return false;
+				}
+				if (lua_type(state_, -1) != LUA_TSTRING)
+				{
+					return fail("invalid userdata type name");
+				}
+				luaL_getmetatable(state_, lua_tostring(state_, -1));
+				const class_userdata::serialize_functions* functions = 0;
+				if (lua_istable(state_, -1))
+				{
+					functions = class_userdata::get_serialize_functions_from_metatable(state_, lua_gettop(state_));
+				}
+				lua_pop(state_, 2);
+				if (!functions)
+				{
+					return fail("userdata type is not deserializable");
+				}
+				size_t size = 0;
+				if (!readSize(size))
+				{
+					return false;
+				}
+				const char* data = readBytes(size);
+				if (!data)
+				{
+					return false;
+				}
+				int top = lua_gettop(state_);
+				if (!functions->deserialize(state_, data, size) || lua_gettop(state_) != top + 1)
+				{
+					return fail("userdata deserialize function failed");
+				}
+				lua_pushvalue(state_, -1);
+				lua_rawseti(state_, refs_, id);
+				return true;
+			}
+
+			lua_State* state_;
+			const char* data_;
+			const char* end_;
+			int strings_;
+			int refs_;
+			lua_Integer string_count_;
+			lua_Integer ref_count_;
+			int depth_;
+			const char* error_;
+		};
+
+		/**
+		* @brief write value at index to stream.
+		* @return If all values were written, return true. Otherwise send error message to error handler and return false.
+		*/
+		inline bool serializeStackValue(lua_State* l, int index, std::ostream& os)
+		{
+			Serializer serializer(l, os);
+			if (!serializer.write(index))
+			{
+				std::string message = "serialize failed. ";
+				if (serializer.nestingTooDeep())
+				{
+					message += "nesting too deep";
+				}
+				else
+				{
+					message += serializer.failedTypeName() ? std::string("can not serialize ") + serializer.failedTypeName() : std::string("stream error");
+				}
+				except::OtherError(l, message);
+				return false;
+			}
+			return true;
+		}
+		/**
+		* @brief push value read from buffer written by serializeStackValue.
+		* @return If succeeded, return true. Otherwise send error message to error handler, push nil and return false.
+		*/
+		inline bool deserializeToStack(lua_State* l, const char* data, size_t size)
+		{
+			Deserializer deserializer(l, data, size);
+			if (!deserializer.read())
+			{
+				except::OtherError(l, std::string("deserialize failed. ") + deserializer.errorMessage());
+				return false;
+			}
+			return true;
+		}
+	}
+
+	/**
+	* @brief write Lua value to stream with compact binary format.
+	* @param os output stream. It should be opened in binary mode.
+	* @param value LuaRef,LuaTable,LuaStackRef etc.
+	* @return If all values were written, return true.
+	*/
+	template<typename RefType>
+	bool serialize(std::ostream& os, const RefType& value)
+	{
+		lua_State* state = value.state();
+		if (!state)
+		{
+			return false;
+		}
+		util::ScopedSavedStack save(state);
+		int index = value.pushStackIndex(state);
+		return util::serializeStackValue(state, index, os);
+	}
+
+	/**
+	* @brief read Lua value written by serialize.
+	* @param l destination state
+	* @param data pointer to serialized data. strings are read from this buffer directly.
+	* @param size size of data
+	* @return reference of read value. If failed, return nil reference.
+	*/
+	inline LuaRef deserialize(lua_State* l, const char* data, size_t size)
+	{
+		util::deserializeToStack(l, data, size);
+		return LuaRef(l, StackTop());
+	}
+	//! read Lua value written by serialize
+	inline LuaRef deserialize(lua_State* l, const std::string& data)
+	{
+		return deserialize(l, data.data(), data.size());
+	}
+}
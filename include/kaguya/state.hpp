@@ -15,6 +15,10 @@
 
 #include "kaguya/lua_ref_table.hpp"
 #include "kaguya/lua_ref_function.hpp"
+#include "kaguya/deep_copy.hpp"
+#include "kaguya/serialize.hpp"
+#include "kaguya/field_path.hpp"
+#include "kaguya/thread_pool.hpp"
 
 namespace kaguya
 {
@@ -71,6 +75,7 @@ namespace kaguya
 		standard::shared_ptr<void> allocator_holder_;
 		lua_State *state_;
 		bool created_;
+		LuaThreadPool thread_pool_;
 
 		//non copyable
 		State(const State&);
@@ -103,7 +108,7 @@ namespace kaguya
 		* @name constructor
 		* @brief create Lua state with lua standard library
 		*/
-		State() :allocator_holder_(), state_(luaL_newstate()), created_(true)
+		State() :allocator_holder_(), state_(luaL_newstate()), created_(true), thread_pool_(state_)
 		{
 			lua_atpanic(state_, &default_panic);
 			init();
@@ -116,7 +121,7 @@ namespace kaguya
 		* @param allocator allocator for memory allocation @see DefaultAllocator
 		*/
 		template<typename Allocator>
-		State(standard::shared_ptr<Allocator> allocator) :allocator_holder_(allocator), state_(lua_newstate(&AllocatorFunction<Allocator>, allocator_holder_.get())), created_(true)
+		State(standard::shared_ptr<Allocator> allocator) :allocator_holder_(allocator), state_(lua_newstate(&AllocatorFunction<Allocator>, allocator_holder_.get())), created_(true), thread_pool_(state_)
 		{
 			lua_atpanic(state_, &default_panic);
 			init();
@@ -130,7 +135,7 @@ namespace kaguya
 		* e.g. LoadLibs libs;libs.push_back(LoadLib("libname",libfunction));State state(libs);
 		* e.g. State state({{"libname",libfunction}}); for c++ 11
 		*/
-		State(const LoadLibs& libs) : allocator_holder_(), state_(luaL_newstate()), created_(true)
+		State(const LoadLibs& libs) : allocator_holder_(), state_(luaL_newstate()), created_(true), thread_pool_(state_)
 		{
 			lua_atpanic(state_, &default_panic);
 			init();
@@ -142,7 +147,7 @@ namespace kaguya
 		* @param allocator allocator for memory allocation @see DefaultAllocator
 		*/
 		template<typename Allocator>
-		State(const LoadLibs& libs, standard::shared_ptr<Allocator> allocator) : allocator_holder_(allocator), state_(lua_newstate(&AllocatorFunction<Allocator>, allocator_holder_.get())), created_(true)
+		State(const LoadLibs& libs, standard::shared_ptr<Allocator> allocator) : allocator_holder_(allocator), state_(lua_newstate(&AllocatorFunction<Allocator>, allocator_holder_.get())), created_(true), thread_pool_(state_)
 		{
 			lua_atpanic(state_, &default_panic);
 			init();
@@ -155,12 +160,13 @@ namespace kaguya
 		* @brief construct using created lua_State. 
 		* @param lua created lua_State. It is not call lua_close() in this class
 		*/
-		State(lua_State* lua) :state_(lua), created_(false)
+		State(lua_State* lua) :state_(lua), created_(false), thread_pool_(state_)
 		{
 			init();
 		}
 		~State()
 		{
+			thread_pool_.clear();
 			if (created_)
 			{
 				lua_close(state_);
@@ -373,6 +379,23 @@ namespace kaguya
 		{
 			return dostring(str.c_str(), env);
 		}
+		/**
+		* @brief Loads and runs the given string with execution limit.
+		* If the limit is exceeded, error handler is called with KAGUYA_ERRLIMIT.
+		* @param str lua script cpde
+		* @param limit instruction count and timeout
+		* @param env execute env table
+		* @return If there are no errors, returns true.Otherwise return false
+		*/
+		bool dostringWithLimit(const char* str, const ExecutionLimit& limit, const LuaTable& env = LuaTable())
+		{
+			ScopedExecutionLimit scope(state_, limit);
+			return dostring(str, env);
+		}
+		bool dostringWithLimit(const std::string& str, const ExecutionLimit& limit, const LuaTable& env = LuaTable())
+		{
+			return dostringWithLimit(str.c_str(), limit, env);
+		}
 		bool operator()(const std::string& str)
 		{
 			return dostring(str);
@@ -401,6 +424,17 @@ namespace kaguya
 			return TableKeyReference<const char*>(state_, table_index, str, stack_top, NoTypeCheck());
 		}
 
+		/**
+		* @brief return prepared reference to global field by dotted path.
+		* state.fieldPath("config.limits.rate") refers same field as state["config"]["limits"]["rate"],
+		* but splits the path once and walks it with prepared keys at each access.
+		* @param path dotted path e.g. "config.limits.rate"
+		*/
+		FieldPath fieldPath(const std::string& path)
+		{
+			return FieldPath(state_, path);
+		}
+
 		//! return global table
 		LuaTable globalTable()
 		{
@@ -422,6 +456,44 @@ namespace kaguya
 		}
 #endif
 
+		//! return interned table key. @see LuaKey
+		LuaKey newKey(const char* str)
+		{
+			return LuaKey(state_, str);
+		}
+		//! return interned table key. @see LuaKey
+		LuaKey newKey(const std::string& str)
+		{
+			return LuaKey(state_, str);
+		}
+
+		/**
+		* @brief copy value of other Lua state to this state. @see kaguya::deepCopy
+		* @param value source value. LuaRef,LuaTable,LuaStackRef etc.
+		* @return reference of copied value
+		*/
+		template<typename RefType>
+		LuaRef deepCopy(const RefType& value)
+		{
+			return kaguya::deepCopy(state_, value);
+		}
+
+		/**
+		* @brief read value written by kaguya::serialize to this state.
+		* @param data pointer to serialized data. strings are read from this buffer directly.
+		* @param size size of data
+		* @return reference of read value. If failed, return nil reference.
+		*/
+		LuaRef deserialize(const char* data, size_t size)
+		{
+			return kaguya::deserialize(state_, data, size);
+		}
+		//! read value written by kaguya::serialize to this state.
+		LuaRef deserialize(const std::string& data)
+		{
+			return kaguya::deserialize(state_, data);
+		}
+
 		//! return new Lua table
 		LuaTable newTable()
 		{
@@ -433,17 +505,28 @@ namespace kaguya
 			return LuaTable(state_, NewTable(reserve_array, reserve_record));
 		}
 
-		//! create new Lua thread
+		//! create new Lua thread. Thread returned by releaseThread is reused.
 		LuaThread newThread()
 		{
-			return LuaThread(state_);
+			return thread_pool_.newThread();
 		}
-		//! create new Lua thread with function
+		//! create new Lua thread with function. Thread returned by releaseThread is reused.
 		LuaThread newThread(const LuaFunction& f)
 		{
-			LuaThread cor(state_);
-			cor.setFunction(f);
-			return cor;
+			return thread_pool_.newThread(f);
+		}
+		/**
+		* @brief return finished thread for reuse by newThread. On success, thread become nil reference.
+		* @return If thread is not finished(suspended, running or dead by error), return false.
+		*/
+		bool releaseThread(LuaThread& thread)
+		{
+			return thread_pool_.release(thread);
+		}
+		//! free list of threads used by newThread. e.g. stats or capacity
+		LuaThreadPool& threadPool()
+		{
+			return thread_pool_;
 		}
 
 		//push to Lua stack
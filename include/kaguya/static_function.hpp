@@ -0,0 +1,114 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <string>
+
+#include "kaguya/config.hpp"
+#include "kaguya/utility.hpp"
+#include "kaguya/native_function.hpp"
+
+namespace kaguya
+{
+	namespace nativefunction
+	{
+		//! call f with arguments on the stack. same error handling as bound functions
+		template<typename F>
+		int invoke_static(lua_State* state, const F& f)
+		{
+			int result = ARGUMENT_TYPE_MISMATCH;
+#if !KAGUYA_NO_EXCEPTIONS
+			try {
+#endif
+				result = call(state, f);
+#if !KAGUYA_NO_EXCEPTIONS
+			}
+			catch (LuaTypeMismatch &) {
+			}
+			catch (std::exception & e) {
+				util::traceBack(state, e.what());
+				return RAISE_EXCEPTION;
+			}
+			catch (...) {
+				util::traceBack(state, "Unknown exception");
+				return RAISE_EXCEPTION;
+			}
+#endif
+			if (result != ARGUMENT_TYPE_MISMATCH)
+			{
+				return result;
+			}
+			util::traceBack(state, ("Argument mismatch:" + argmentTypes(state) + "\t candidate is:\n\t\t" + argTypesName(f)).c_str());
+			return RAISE_TYPE_MISMATCH;
+		}
+
+		/**
+		* @brief lua_CFunction of function or member pointer fixed at compile time.
+		* Push is lua_pushcfunction. No upvalue, no userdata and no heap allocation.
+		*/
+		template<typename F, F f>
+		struct static_function
+		{
+			static int invoke_function(lua_State* state)
+			{
+				return invoke_static(state, f);
+			}
+			static int invoke(lua_State* state)
+			{
+				return observed_dispatch<&invoke_function>(state);
+			}
+		};
+
+		//! lua_CFunction of constructor. Signature is function type e.g. Vec3(double, double, double)
+		template<typename Signature>
+		struct static_constructor
+		{
+			static int invoke_function(lua_State* state)
+			{
+				return invoke_static(state, typename functionToConstructorSignature<Signature>::type());
+			}
+			static int invoke(lua_State* state)
+			{
+				return observed_dispatch<&invoke_function>(state);
+			}
+		};
+
+		//! deduce type of F for KAGUYA_STATIC_FUNCTION without decltype
+		template<typename F>
+		struct static_function_deducer
+		{
+			template<F f>
+			lua_CFunction get()const
+			{
+				return &static_function<F, f>::invoke;
+			}
+		};
+		template<typename F>
+		static_function_deducer<F> deduce_static_function(F)
+		{
+			return static_function_deducer<F>();
+		}
+	}
+}
+
+/**
+* @brief lua_CFunction of function or member pointer F, for entry of luaL_Reg array.
+* e.g.
+* @code
+* static const luaL_Reg vec3_functions[] = {
+*   { "length", KAGUYA_STATIC_FUNCTION(&Vec3::length) },
+*   { "new", KAGUYA_STATIC_CONSTRUCTOR(Vec3(double, double, double)) },
+*   { 0, 0 }
+* };
+* @endcode
+*/
+#if KAGUYA_USE_CPP11
+#define KAGUYA_STATIC_FUNCTION(F) &kaguya::nativefunction::static_function<decltype(F), F>::invoke
+#else
+#define KAGUYA_STATIC_FUNCTION(F) kaguya::nativefunction::deduce_static_function(F).get<F>()
+#endif
+//! lua_CFunction of constructor, for entry of luaL_Reg array.
+#define KAGUYA_STATIC_CONSTRUCTOR(SIGNATURE) &kaguya::nativefunction::static_constructor<SIGNATURE>::invoke
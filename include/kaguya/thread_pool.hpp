@@ -0,0 +1,138 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <vector>
+
+#include "kaguya/config.hpp"
+#include "kaguya/lua_ref.hpp"
+#include "kaguya/lua_ref_function.hpp"
+
+namespace kaguya
+{
+	/**
+	* @brief free list of finished Lua threads.
+	* Released thread keeps its Lua stack and CallInfo chain, and is reused by next newThread.
+	* Do not use other LuaThread that refer the released thread.
+	*/
+	class LuaThreadPool
+	{
+	public:
+		struct Stats
+		{
+			Stats() :created(0), reused(0), released(0), discarded(0) {}
+			size_t created;//!< created by lua_newthread
+			size_t reused;//!< taken from free list
+			size_t released;//!< returned to free list
+			size_t discarded;//!< not reusable at release, or free list is full
+
+			//! ratio of reused thread in newThread
+			double reuseRate()const
+			{
+				size_t total = created + reused;
+				return total ? double(reused) / double(total) : 0.0;
+			}
+		};
+
+		/**
+		* @param state lua_State
+		* @param capacity max size of free list
+		*/
+		explicit LuaThreadPool(lua_State* state, size_t capacity = 64) :state_(state), capacity_(capacity)
+		{
+		}
+
+		//! create new Lua thread or reuse released thread
+		LuaThread newThread()
+		{
+			if (free_.empty())
+			{
+				stats_.created++;
+				return LuaThread(state_);
+			}
+			stats_.reused++;
+			LuaThread thread;
+			thread.swap(free_.back());
+			free_.pop_back();
+			return thread;
+		}
+		//! create new Lua thread or reuse released thread, with function
+		LuaThread newThread(const LuaFunction& f)
+		{
+			LuaThread thread = newThread();
+			thread.setFunction(f);
+			return thread;
+		}
+
+		/**
+		* @brief return finished thread to free list. On success, thread become nil reference.
+		* @return If thread is suspended, running or dead by error, return false and thread is not changed.
+		*/
+		bool release(LuaThread& thread)
+		{
+			lua_State* co = thread.isNilref() ? 0 : thread.get<lua_State*>();
+			if (!co || !reusable(co))
+			{
+				stats_.discarded++;
+				return false;
+			}
+			if (free_.size() >= capacity_)
+			{
+				stats_.discarded++;
+				thread = LuaThread();
+				return true;
+			}
+			lua_settop(co, 0);
+			//same as lua_newthread
+			lua_sethook(co, lua_gethook(state_), lua_gethookmask(state_), lua_gethookcount(state_));
+			free_.push_back(LuaThread());
+			free_.back().swap(thread);
+			stats_.released++;
+			return true;
+		}
+
+		//! number of threads in free list
+		size_t freeCount()const { return free_.size(); }
+
+		size_t capacity()const { return capacity_; }
+		void setCapacity(size_t capacity)
+		{
+			capacity_ = capacity;
+			if (free_.size() > capacity_)
+			{
+				free_.resize(capacity_);
+			}
+		}
+
+		const Stats& stats()const { return stats_; }
+		void resetStats() { stats_ = Stats(); }
+
+		//! release all threads in free list
+		void clear()
+		{
+			free_.clear();
+		}
+
+	private:
+		static bool reusable(lua_State* co)
+		{
+			if (lua_status(co) != 0)//suspended or dead by error
+			{
+				return false;
+			}
+			lua_Debug ar;
+			return lua_getstack(co, 0, &ar) == 0;//not running
+		}
+
+		LuaThreadPool(const LuaThreadPool&);
+		LuaThreadPool& operator=(const LuaThreadPool&);
+
+		lua_State* state_;
+		size_t capacity_;
+		std::vector<LuaThread> free_;
+		Stats stats_;
+	};
+}
@@ -12,6 +12,7 @@
 #include "kaguya/traits.hpp"
 #include "kaguya/object.hpp"
 #include "kaguya/exception.hpp"
+#include "kaguya/optional.hpp"
 
 namespace kaguya
 {
@@ -32,7 +33,7 @@ namespace kaguya
 		const typename traits::remove_reference<T>::type* pointer = get_const_pointer(l, index, types::typetag<typename traits::remove_reference<T>::type>());
 		if (!pointer)
 		{
-			throw LuaTypeMismatch("type mismatch!!");
+			KAGUYA_THROW(LuaTypeMismatch("type mismatch!!"));
 		}
 		return *pointer;
 	}
@@ -90,7 +91,7 @@ namespace kaguya
 			T* pointer = get_pointer(l, index, types::typetag<T>());
 			if (!pointer)
 			{
-				throw LuaTypeMismatch("type mismatch!!");
+				KAGUYA_THROW(LuaTypeMismatch("type mismatch!!"));
 			}
 			return *pointer;
 		}
@@ -157,7 +158,7 @@ namespace kaguya
 			{
 				return 0;
 			}
-			throw LuaTypeMismatch("type mismatch!!");
+			KAGUYA_THROW(LuaTypeMismatch("type mismatch!!"));
 			return 0;
 		}
 		static int push(lua_State* l, push_type v)
@@ -265,7 +266,7 @@ namespace kaguya
 		{
 			if (v)
 			{
-				typedef ObjectSharedPointerWrapper wrapper_type;
+				typedef ObjectTypedSharedPointerWrapper<T> wrapper_type;
 				void *storage = lua_newuserdata(l, sizeof(wrapper_type));
 				new(storage) wrapper_type(v);
 				class_userdata::setmetatable<T>(l);
@@ -303,7 +304,7 @@ namespace kaguya
 		{
 			if (v)
 			{
-				typedef ObjectSharedPointerWrapper wrapper_type;
+				typedef ObjectTypedSharedPointerWrapper<void> wrapper_type;
 				void *storage = lua_newuserdata(l, sizeof(wrapper_type));
 				new(storage) wrapper_type(v);
 			}
@@ -338,7 +339,7 @@ namespace kaguya
 			const get_type* pointer = get_const_pointer(l, index, types::typetag<get_type>());
 			if (!pointer)
 			{
-				throw LuaTypeMismatch("type mismatch!!");
+				KAGUYA_THROW(LuaTypeMismatch("type mismatch!!"));
 			}
 			return *pointer;
 		}
@@ -376,7 +377,7 @@ namespace kaguya
 		static get_type get(lua_State* l, int index)
 		{
 			if (!lua_isnoneornil(l, index)) {
-				throw LuaTypeMismatch("type mismatch!!");
+				KAGUYA_THROW(LuaTypeMismatch("type mismatch!!"));
 			}
 			return nullptr;
 		}
@@ -597,6 +598,134 @@ namespace kaguya
 
 #include "kaguya/gen/push_tuple.inl"
 
+	/**
+	* @brief conversion that reports failure by result instead of exception.
+	* Default is same as lua_type_traits<T>::get. Specialize this if get of lua_type_traits<T> can throw.
+	*/
+	template<typename T, typename Enable = void>
+	struct try_get_traits
+	{
+#if KAGUYA_USE_CPP11
+		typedef decltype(lua_type_traits<T>::get(0, 0)) get_type;
+#else
+		typedef typename lua_type_traits<T>::get_type get_type;
+#endif
+		typedef optional<get_type> result_type;
+
+		static result_type get(lua_State* l, int index)
+		{
+			return result_type(lua_type_traits<T>::get(l, index));
+		}
+	};
+
+	template<typename T> struct try_get_traits < T
+		, typename traits::enable_if<is_usertype<T>::value
+		&& !traits::is_pointer<typename traits::remove_const_reference<T>::type>::value
+		&& !(traits::is_lvalue_reference<T>::value && !traits::is_const<typename traits::remove_reference<T>::type>::value)>::type >
+	{
+		typedef typename traits::remove_const_and_reference<T>::type NCRT;
+		typedef typename lua_type_traits<T>::get_type get_type;
+		typedef optional<get_type> result_type;
+
+		static result_type get(lua_State* l, int index)
+		{
+			const NCRT* pointer = get_const_pointer(l, index, types::typetag<NCRT>());
+			if (!pointer)
+			{
+				return result_type();
+			}
+			return result_type(*pointer);
+		}
+	};
+
+	template<typename REF> struct try_get_traits < REF
+		, typename traits::enable_if<is_usertype<REF>::value
+		&& !traits::is_pointer<typename traits::remove_const_reference<REF>::type>::value
+		&& traits::is_lvalue_reference<REF>::value && !traits::is_const<typename traits::remove_reference<REF>::type>::value>::type >
+	{
+		typedef typename traits::remove_reference<REF>::type T;
+		typedef REF get_type;
+		typedef optional<get_type> result_type;
+
+		static result_type get(lua_State* l, int index)
+		{
+			T* pointer = get_pointer(l, index, types::typetag<T>());
+			if (!pointer)
+			{
+				return result_type();
+			}
+			return result_type(*pointer);
+		}
+	};
+
+	template<typename PTR> struct try_get_traits < PTR
+		, typename traits::enable_if<is_usertype<PTR>::value
+		&& traits::is_pointer<typename traits::remove_const_reference<PTR>::type>::value>::type >
+	{
+		typedef typename lua_type_traits<PTR>::get_type get_type;
+		typedef optional<get_type> result_type;
+
+		static result_type get(lua_State* l, int index)
+		{
+			int type = lua_type(l, index);
+			if (type == LUA_TUSERDATA
+				|| type == LUA_TLIGHTUSERDATA
+				|| type == LUA_TNIL
+				|| type == LUA_TNONE
+				|| (type == LUA_TNUMBER && lua_tonumber(l, index) == 0)) //allow zero for nullptr;
+			{
+				return result_type(lua_type_traits<PTR>::get(l, index));
+			}
+			return result_type();
+		}
+	};
+
+	//! get_type of lua_type_traits<const char*> is std::string, but argument needs pointer.
+	template<>	struct try_get_traits<const char*> {
+		typedef const char* get_type;
+		typedef optional<get_type> result_type;
+
+		static result_type get(lua_State* l, int index)
+		{
+			return result_type(lua_type_traits<const char*>::get(l, index));
+		}
+	};
+
+#if KAGUYA_USE_CPP11
+	template<>	struct try_get_traits<std::nullptr_t> {
+		typedef std::nullptr_t get_type;
+		typedef optional<get_type> result_type;
+
+		static result_type get(lua_State* l, int index)
+		{
+			if (!lua_isnoneornil(l, index)) {
+				return result_type();
+			}
+			return result_type(nullptr);
+		}
+	};
+#endif
+
+	/**
+	* @brief get value at index without exception.
+	* @return converted value. If value is not convertible to T, return empty optional.
+	*/
+	template<typename T>
+	inline typename try_get_traits<T>::result_type try_get(lua_State* l, int index)
+	{
+		return try_get_traits<T>::get(l, index);
+	}
+
+	namespace nativefunction
+	{
+		//! returned from call when arguments were not convertible. dispatcher raise Lua error with this.
+		static const int ARGUMENT_TYPE_MISMATCH = -1;
+		//! returned from call when result is not ready(e.g. AsyncResult). dispatcher yield current thread.
+		static const int YIELD_CURRENT_THREAD = -2;
+		//! returned from overloaded functions when no candidate matched to arguments.
+		static const int NO_MATCHING_OVERLOAD = -3;
+	}
+
 	struct NewTable {
 		NewTable() :reserve_array_(0), reserve_record_(0) {}
 		NewTable(int reserve_array, int reserve_record_) :reserve_array_(reserve_array), reserve_record_(reserve_record_) {}
@@ -818,15 +947,10 @@ namespace kaguya
 		template<typename T>
 		inline typename traits::enable_if<!traits::is_convertible<T*, LuaBasicTypeFunctions<T>*>::value, bool>::type operator==(const T& rhs)const
 		{
-			try
-			{
-				return get<T>() == rhs;
-			}
-			catch (const LuaTypeMismatch&)
-			{
-				return false;
-			}
-			return false;
+			lua_State* state = state_();
+			util::ScopedSavedStack save(state);
+			typename try_get_traits<T>::result_type value = try_get<T>(state, pushStackIndex_(state));
+			return value && static_cast<typename lua_type_traits<T>::get_type>(*value) == rhs;
 		}
 		template<typename T>
 		inline typename traits::enable_if<!traits::is_convertible<T*, LuaBasicTypeFunctions<T>*>::value, bool>::type operator!=(const T& rhs)const
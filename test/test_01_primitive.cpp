@@ -1,3 +1,4 @@
+#include <limits>
 #include "kaguya/kaguya.hpp"
 #include "test_util.hpp"
 
@@ -225,5 +226,30 @@ KAGUYA_TEST_FUNCTION_DEF(vector_set2)(kaguya::State& state)
 	TEST_CHECK(state["value"] != m);
 }
 
+struct TryGetObject {};
+KAGUYA_TEST_FUNCTION_DEF(try_get)(kaguya::State& state)
+{
+	lua_State* L = state.state();
+	lua_pushinteger(L, 32);
+	lua_pushstring(L, "text");
+	lua_pushnil(L);
+
+	kaguya::optional<int> number = kaguya::try_get<int>(L, -3);
+	TEST_CHECK(number);
+	TEST_EQUAL(*number, 32);
+	kaguya::optional<std::string> text = kaguya::try_get<std::string>(L, -2);
+	TEST_CHECK(text);
+	TEST_EQUAL(*text, "text");
+
+	TEST_CHECK(kaguya::try_get<void*>(L, -1));
+	TEST_EQUAL(*kaguya::try_get<void*>(L, -1), (void*)0);
+	TEST_CHECK(!kaguya::try_get<void*>(L, -2));
+
+	TEST_CHECK(!kaguya::try_get<const TryGetObject&>(L, -3));
+	TEST_CHECK(!kaguya::try_get<TryGetObject&>(L, -2));
+	TEST_EQUAL(kaguya::try_get<TryGetObject*>(L, -2).value_or((TryGetObject*)0), (TryGetObject*)0);
+	lua_pop(L, 3);
+}
+
 
 KAGUYA_TEST_GROUP_END(test_01_primitive)
@@ -489,6 +489,48 @@ KAGUYA_TEST_FUNCTION_DEF(shared_ptr_null)(kaguya::State& state)
 	TEST_EQUAL(ptr, 0);
 }
 
+long borrowed_use_count = 0;
+kaguya::standard::shared_ptr<Base> kept_base;
+int borrow_derived_function(const kaguya::standard::shared_ptr<Derived>& d, Base& b)
+{
+	borrowed_use_count = d.use_count();
+	return d->b + b.a;
+}
+void keep_base_function(kaguya::standard::shared_ptr<Base> b)
+{
+	kept_base = b;
+}
+KAGUYA_TEST_FUNCTION_DEF(shared_ptr_borrow)(kaguya::State& state)
+{
+	state["Base"].setClass(kaguya::UserdataMetatable<Base>());
+	state["Derived"].setClass(kaguya::UserdataMetatable<Derived, Base>());
+
+	kaguya::standard::shared_ptr<Derived> derived(new Derived());
+	state["derived"] = derived;
+	TEST_EQUAL(derived.use_count(), 2);
+
+	state["base_function"] = &base_function;
+	state["derived_function"] = &derived_function;
+	TEST_CHECK(state("assert(1 == base_function(derived) and 2 == derived_function(derived))"));
+	TEST_EQUAL(derived.use_count(), 2);
+
+	state["borrow_derived_function"] = &borrow_derived_function;
+	TEST_CHECK(state("assert(3 == borrow_derived_function(derived, derived))"));
+	TEST_EQUAL(borrowed_use_count, 3);
+	TEST_EQUAL(derived.use_count(), 2);
+
+	//shared_ptr of base class shares ownership
+	state["keep_base_function"] = &keep_base_function;
+	TEST_CHECK(state("keep_base_function(derived)"));
+	TEST_EQUAL(derived.use_count(), 3);
+	TEST_EQUAL(kept_base.get(), static_cast<Base*>(derived.get()));
+	state["derived"] = kaguya::NilValue();
+	state.garbageCollect();
+	TEST_EQUAL(derived.use_count(), 2);
+	kept_base.reset();
+	TEST_EQUAL(derived.use_count(), 1);
+}
+
 struct Base2
 {
 	Base2() :b(0) {};
@@ -557,6 +599,69 @@ KAGUYA_TEST_FUNCTION_DEF(multiple_inheritance)(kaguya::State& state)
 	TEST_CHECK(state("assert(constobj:consttest2()==1560)"));
 }
 
+KAGUYA_TEST_FUNCTION_DEF(flatten_inheritance)(kaguya::State& state)
+{
+	state["Base"].setClass(kaguya::UserdataMetatable<Base>()
+		.addProperty("a", &Base::a)
+		);
+	state["Derived"].setClass(kaguya::UserdataMetatable<Derived, Base>()
+		.flattenInheritance()
+		.addFunction("b", &Derived::b)
+		);
+	state["Derived2"].setClass(kaguya::UserdataMetatable<Derived2, Derived>()
+		.flattenInheritance()
+		.addFunction("c", &Derived2::c)
+		);
+	state["Base2"].setClass(kaguya::UserdataMetatable<Base2>()
+		.addFunction("test", &Base2::test)
+		.addFunction("test2", &Base2::test2)
+		);
+	state["MultipleInheritance"].setClass(kaguya::UserdataMetatable<MultipleInheritance, kaguya::MultipleBase<Base, Base2> >()
+		.flattenInheritance()
+		.addFunction("test", &MultipleInheritance::test)
+		);
+
+	Derived2 derived2;
+	state["derived2"] = &derived2;
+	TEST_CHECK(state("derived2.a = 3"));
+	TEST_CHECK(state("derived2:b(4)"));
+	TEST_CHECK(state("derived2:c(5)"));
+	TEST_CHECK(state("assert(derived2.a == 3 and derived2:b() == 4 and derived2:c() == 5)"));
+	TEST_EQUAL(derived2.a, 3);
+	TEST_EQUAL(derived2.b, 4);
+	TEST_EQUAL(derived2.c, 5);
+	//copied from base of base
+	TEST_CHECK(state("assert(rawget(getmetatable(Derived2), 'b') == rawget(getmetatable(Derived), 'b'))"));
+	TEST_CHECK(state("assert(rawget(getmetatable(Derived2), '_prop_a') ~= nil)"));
+
+	MultipleInheritance multiple;
+	state["multiple"] = &multiple;
+	TEST_CHECK(state("assert(multiple:test() == 1192)"));//not overwritten by base
+	TEST_CHECK(state("assert(multiple:test2() == 1192)"));
+	TEST_CHECK(state("multiple.a = 6"));
+	TEST_EQUAL(multiple.a, 6);
+	TEST_CHECK(state("assert(rawget(getmetatable(MultipleInheritance), 'test2') ~= nil)"));
+
+	//members added to base after registration
+	TEST_CHECK(state("getmetatable(Base).added = function(self) return 'added' end"));
+	TEST_CHECK(state("assert(rawget(getmetatable(Derived2), 'added') == nil)"));
+	kaguya::UserdataMetatable<Derived, Base>::refreshInheritedMembers(state.state());
+	kaguya::UserdataMetatable<Derived2, Derived>::refreshInheritedMembers(state.state());
+	TEST_CHECK(state("assert(rawget(getmetatable(Derived2), 'added') ~= nil)"));
+	TEST_CHECK(state("assert(derived2:added() == 'added')"));
+
+	//overridden after flatten is kept at refresh
+	TEST_CHECK(state("getmetatable(Derived2).b = function(self) return 'overridden' end"));
+	kaguya::UserdataMetatable<Derived2, Derived>::refreshInheritedMembers(state.state());
+	TEST_CHECK(state("assert(derived2:b() == 'overridden')"));
+
+	//removed from base
+	TEST_CHECK(state("getmetatable(Base).added = nil"));
+	kaguya::UserdataMetatable<Derived, Base>::refreshInheritedMembers(state.state());
+	kaguya::UserdataMetatable<Derived2, Derived>::refreshInheritedMembers(state.state());
+	TEST_CHECK(state("assert(derived2.added == nil)"));
+}
+
 KAGUYA_TEST_FUNCTION_DEF(add_property)(kaguya::State& state)
 {
 	state["Base"].setClass(kaguya::UserdataMetatable<Base>()
@@ -826,4 +931,49 @@ KAGUYA_TEST_FUNCTION_DEF(null_shared_ptr)(kaguya::State& state)
 	kaguya::standard::shared_ptr<void> sptr = state["test"];
 	TEST_CHECK(!sptr);
 }
+std::string last_error_message;
+void ignore_error_fun(int status, const char* message)
+{
+	last_error_message = message ? message : "";
+}
+
+static const luaL_Reg abc_static_functions[] = {
+	{ "new", KAGUYA_STATIC_CONSTRUCTOR(ABC(int, const std::string&)) },
+	{ "getInt", KAGUYA_STATIC_FUNCTION(&ABC::getInt) },
+	{ "setInt", KAGUYA_STATIC_FUNCTION(&ABC::setInt) },
+	{ "getString", KAGUYA_STATIC_FUNCTION(&ABC::getString) },
+	{ 0, 0 }
+};
+static const luaL_Reg abc_static_properties[] = {
+	{ "intmember", KAGUYA_STATIC_FUNCTION(&ABC::intmember) },
+	{ "stringmember", KAGUYA_STATIC_FUNCTION(&ABC::stringmember) },
+	{ 0, 0 }
+};
+
+KAGUYA_TEST_FUNCTION_DEF(static_binding_table)(kaguya::State& state)
+{
+	state["ABC"].setClass(kaguya::UserdataMetatable<ABC>()
+		.addStaticFunctions(abc_static_functions)
+		.addStaticProperties(abc_static_properties)
+		.addFunction("copy", &ABC::copy)
+	);
+
+	TEST_CHECK(state("value = assert(ABC.new(3, 'str'))"));
+	TEST_CHECK(state("assert(value:getInt() == 3 and value:getString() == 'str')"));
+	TEST_CHECK(state("value:setInt(7) assert(value.intmember == 7)"));
+	TEST_CHECK(state("value.stringmember = 'changed' assert(value:getString() == 'changed')"));
+	TEST_CHECK(state("assert(value:copy().intmember == 7)"));
+
+	ABC abc(5, "cpp");
+	state["abc"] = &abc;
+	TEST_CHECK(state("abc:setInt(abc.intmember * 2)"));
+	TEST_EQUAL(abc.intmember, 10);
+
+	last_error_message = "";
+	state.setErrorHandler(ignore_error_fun);
+	TEST_CHECK(!state("ABC.getInt(nil)"));
+	TEST_CHECK(last_error_message.find("Argument mismatch") != std::string::npos);
+	TEST_CHECK(!state("ABC.setInt('str', 1)"));
+}
+
 KAGUYA_TEST_GROUP_END(test_02_classreg)
@@ -1,3 +1,4 @@
+#include <numeric>
 #include "kaguya/kaguya.hpp"
 #include "test_util.hpp"
 
@@ -219,4 +220,160 @@ KAGUYA_TEST_FUNCTION_DEF(result_to_table)(kaguya::State& state)
 	TEST_EQUAL(state["result"], 1);
 }
 
+struct MismatchArg
+{
+	int value;
+	MismatchArg() :value(3) {}
+	int get()const { return value; }
+};
+int take_mismatch_arg(const MismatchArg& arg) { return arg.value; }
+int take_mismatch_ref(MismatchArg& arg) { return arg.value; }
+
+KAGUYA_TEST_FUNCTION_DEF(argument_mismatch_without_exception)(kaguya::State& state)
+{
+	state["MismatchArg"].setClass(kaguya::UserdataMetatable<MismatchArg>()
+		.setConstructors<MismatchArg()>()
+		.addFunction("get", &MismatchArg::get)
+		.addProperty("value", &MismatchArg::value));
+	state["take_arg"] = kaguya::function(take_mismatch_arg);
+	state["take_ref"] = kaguya::function(take_mismatch_ref);
+	state["take_pointer"] = kaguya::function(pointerfun);
+
+	TEST_CHECK(state("obj = MismatchArg.new() assert(take_arg(obj) == 3 and take_ref(obj) == 3 and obj:get() == 3)"));
+
+	state.setErrorHandler(ignore_error_fun);
+	for (int i = 0; i < 10; ++i)
+	{
+		last_error_message = "";
+		TEST_CHECK(!state("take_arg('str')"));
+		TEST_CHECK(last_error_message.find("Argument mismatch") != std::string::npos);
+		TEST_CHECK(!state("take_ref({})"));
+		TEST_CHECK(!state("take_pointer('str')"));
+		TEST_CHECK(!state("MismatchArg.get(nil)"));
+		TEST_CHECK(!state("MismatchArg.value(3)"));
+	}
+	TEST_CHECK(state("assert(not pcall(take_arg, 1))"));
+	TEST_CHECK(state("assert(take_arg(obj) == 3)"));
+}
+
+double view_sum(const std::string& label, kaguya::VariadicArgView<double> args)
+{
+	TEST_EQUAL(label, "sum");
+	double sum = 0;
+	for (kaguya::VariadicArgView<double>::iterator it = args.begin(); it != args.end(); ++it)
+	{
+		sum += *it;
+	}
+	if (!args.empty())
+	{
+		TEST_EQUAL(args.front(), args[0]);
+		TEST_EQUAL(args.back(), args.at(args.size() - 1));
+		TEST_EQUAL(args.end() - args.begin(), int(args.size()));
+	}
+	double buffer[4];
+	size_t copied = args.copy(buffer, 4);
+	TEST_EQUAL(copied, std::min(args.size(), size_t(4)));
+	for (size_t i = 0; i < copied; ++i)
+	{
+		TEST_EQUAL(buffer[i], args[i]);
+	}
+	return sum;
+}
+int view_count_ints(kaguya::VariadicArgView<int> args)
+{
+	return int(args.size());
+}
+std::string view_join(kaguya::VariadicArgView<std::string> args)
+{
+	return std::accumulate(args.begin(), args.end(), std::string());
+}
+
+KAGUYA_TEST_FUNCTION_DEF(variadic_arg_view)(kaguya::State& state)
+{
+	state["view_sum"] = kaguya::function(view_sum);
+	TEST_CHECK(state("assert(view_sum('sum') == 0)"));
+	TEST_CHECK(state("assert(view_sum('sum', 1) == 1)"));
+	TEST_CHECK(state("assert(view_sum('sum', 1, 2, 3, 4, 5, 6) == 21)"));
+
+	state["view_overload"] = kaguya::overload(view_count_ints, view_join);
+	TEST_CHECK(state("assert(view_overload(1, 2, 3) == 3)"));
+	TEST_CHECK(state("assert(view_overload('a', 'b', 'c') == 'abc')"));
+
+	state.setErrorHandler(ignore_error_fun);
+	TEST_CHECK(!state("view_overload(1, {})"));
+	TEST_CHECK(last_error_message.find("Argument mismatch") != std::string::npos);
+
+	lua_State* L = state.state();
+	int top = lua_gettop(L);
+	for (int i = 1; i <= 6; ++i)
+	{
+		lua_pushinteger(L, i * 10);
+	}
+	kaguya::VariadicArgView<int> view(L, top + 1);
+	TEST_EQUAL(view.size(), 6u);
+	kaguya::VariadicArgView<int> sub = view.subview(2, 3);
+	TEST_EQUAL(sub.size(), 3u);
+	TEST_EQUAL(sub[0], 30);
+	TEST_EQUAL(sub.back(), 50);
+	TEST_EQUAL(view.subview(4).size(), 2u);
+	TEST_CHECK(view.subview(10).empty());
+	int buffer[6] = {};
+	TEST_EQUAL(view.copy(buffer, 6, 4), 2u);
+	TEST_EQUAL(buffer[0], 50);
+	TEST_EQUAL(buffer[1], 60);
+	lua_settop(L, top);
+}
+
+struct Body
+{
+	double x, y, z;
+	Body() :x(1), y(2), z(3) {}
+	kaguya::ResultWriter position(kaguya::ResultWriter results)const
+	{
+		return results(x)(y)(z);
+	}
+};
+kaguya::ResultWriter divmod(int a, int b, kaguya::ResultWriter results)
+{
+	return results(a / b)(a % b);
+}
+kaguya::ResultWriter describe(const std::string& name, kaguya::ResultWriter results)
+{
+	return results(name)(name.size())(true);
+}
+kaguya::ResultWriter many_results(int n, kaguya::ResultWriter results)
+{
+	for (int i = 0; i < n; ++i)
+	{
+		results(i);
+	}
+	return results;
+}
+
+KAGUYA_TEST_FUNCTION_DEF(result_writer)(kaguya::State& state)
+{
+	state["divmod"] = kaguya::function(divmod);
+	TEST_CHECK(state("q, r = divmod(17, 5) assert(q == 3 and r == 2)"));
+	TEST_CHECK(state("assert(select('#', divmod(8, 2)) == 2)"));
+
+	state["describe"] = kaguya::function(describe);
+	TEST_CHECK(state("n, s, b = describe('kaguya') assert(n == 'kaguya' and s == 6 and b == true)"));
+
+	state["Body"].setClass(kaguya::UserdataMetatable<Body>()
+		.setConstructors<Body()>()
+		.addFunction("position", &Body::position));
+	TEST_CHECK(state("x, y, z = Body.new():position() assert(x == 1 and y == 2 and z == 3)"));
+
+	int q = 0, r = 0;
+	state["divmod"].callInto(kaguya::tie(q, r), 23, 7);
+	TEST_EQUAL(q, 3);
+	TEST_EQUAL(r, 2);
+
+	//more results than LUA_MINSTACK
+	state["many_results"] = kaguya::function(many_results);
+	TEST_CHECK(state("local t = {many_results(5000)} assert(#t == 5000 and t[1] == 0 and t[5000] == 4999)"));
+	TEST_CHECK(state("assert(select('#', many_results(21)) == 21)"));
+	TEST_CHECK(state("assert(not pcall(many_results, 2000000))"));
+}
+
 KAGUYA_TEST_GROUP_END(test_03_function)
@@ -49,6 +49,63 @@ KAGUYA_TEST_FUNCTION_DEF(multi_return_function_test)(kaguya::State& state)
 	state["multireturn_pass_through_to_arg"](state["multresfun"]());
 }
 
+KAGUYA_TEST_FUNCTION_DEF(call_into_existing_variables)(kaguya::State& state)
+{
+	state("multresfun = function(i) return i, i * 2, 'text', i + 0.5 end");
+	int a = 0, b = 0;
+	std::string c;
+	double d = 0;
+	kaguya::LuaFunction f = state["multresfun"];
+	int top = lua_gettop(state.state());
+	f.callInto(kaguya::tie(a, b, c, d), 3);
+	TEST_EQUAL(a, 3);
+	TEST_EQUAL(b, 6);
+	TEST_EQUAL(c, "text");
+	TEST_EQUAL(d, 3.5);
+	TEST_EQUAL(lua_gettop(state.state()), top);
+
+	state["multresfun"].callInto(kaguya::tie(a, b), 5);
+	TEST_EQUAL(a, 5);
+	TEST_EQUAL(b, 10);
+
+	state("noargfun = function() return 7 end");
+	state["noargfun"].callInto(kaguya::tie(a));
+	TEST_EQUAL(a, 7);
+
+	state("tbl = {value = 4} function tbl:get(n) return self.value, n end");
+	(state["tbl"]->*"get").callInto(kaguya::tie(a, b), 9);
+	TEST_EQUAL(a, 4);
+	TEST_EQUAL(b, 9);
+
+	//more results than tied variables
+	state("three = function() return 1, 2, 3 end");
+	state["three"].callInto(kaguya::tie(a, b));
+	TEST_EQUAL(a, 1);
+	TEST_EQUAL(b, 2);
+	TEST_EQUAL(lua_gettop(state.state()), top);
+
+	//fewer results than tied variables. rest are nil
+	kaguya::LuaRef rest(state.state(), 1);
+	state("one = function() return 10 end");
+	state["one"].callInto(kaguya::tie(a, rest));
+	TEST_EQUAL(a, 10);
+	TEST_CHECK(rest.isNilref());
+	TEST_EQUAL(lua_gettop(state.state()), top);
+
+	state("errorfun = function() error('failed') end");
+	a = b = 1;
+	try {
+		state["errorfun"].callInto(kaguya::tie(a, b));
+		TEST_CHECK(false);
+	}
+	catch (std::runtime_error&)
+	{
+	}
+	TEST_EQUAL(a, 1);
+	TEST_EQUAL(b, 1);
+	TEST_EQUAL(lua_gettop(state.state()), top);
+}
+
 
 KAGUYA_TEST_FUNCTION_DEF(coroutine)(kaguya::State& state)
 {
@@ -219,4 +276,40 @@ KAGUYA_TEST_FUNCTION_DEF(bind_to_std_function)(kaguya::State& state)
 	state("luacallback(function(v) assert(32 == v) end)");
 }
 
+void coroutine_error_fun(int status, const char* message)
+{
+}
+KAGUYA_TEST_FUNCTION_DEF(coroutine_reuse)(kaguya::State& state)
+{
+	TEST_CHECK(state("corfun = function(arg) coroutine.yield(arg) return arg * 2 end"));
+	kaguya::LuaFunction corfun = state["corfun"];
+
+	kaguya::LuaThread cor = state.newThread(corfun);
+	lua_State* costate = cor.get<lua_State*>();
+	TEST_EQUAL(cor.resume<int>(3), 3);
+	TEST_CHECK(!state.releaseThread(cor));//suspended
+	TEST_EQUAL(cor.resume<int>(), 6);
+	TEST_CHECK(state.releaseThread(cor));
+	TEST_CHECK(cor.isNilref());
+
+	kaguya::LuaThread reused = state.newThread(corfun);
+	TEST_CHECK(reused.get<lua_State*>() == costate);
+	TEST_EQUAL(reused.resume<int>(4), 4);
+	TEST_EQUAL(reused.resume<int>(), 8);
+	TEST_CHECK(reused.isThreadDead());
+
+	TEST_CHECK(state("errfun = function() error('error') end"));
+	state.setErrorHandler(coroutine_error_fun);
+	kaguya::LuaThread errcor = state.newThread(state["errfun"]);
+	errcor.resume<void>();
+	TEST_CHECK(!state.releaseThread(errcor));//dead by error
+
+	const kaguya::LuaThreadPool::Stats& stats = state.threadPool().stats();
+	TEST_EQUAL(stats.created, 2u);
+	TEST_EQUAL(stats.reused, 1u);
+	TEST_EQUAL(stats.released, 1u);
+	TEST_EQUAL(stats.discarded, 2u);
+	TEST_EQUAL(stats.reuseRate(), 1.0 / 3.0);
+}
+
 KAGUYA_TEST_GROUP_END(test_04_lua_function)
@@ -469,4 +469,114 @@ KAGUYA_TEST_FUNCTION_DEF(put_multiple)(kaguya::State& state)
 
 }
 
+struct CountKey
+{
+	CountKey(const kaguya::LuaKey& key, int& count) :key_(key), count_(count) {}
+	void operator()(const kaguya::LuaStackRef& k, const kaguya::LuaStackRef& v)
+	{
+		if (k == key_) { count_ += v.get<int>(); }
+	}
+	const kaguya::LuaKey& key_;
+	int& count_;
+};
+
+KAGUYA_TEST_FUNCTION_DEF(lua_key)(kaguya::State& state)
+{
+	kaguya::LuaKey name = state.newKey("name");
+	kaguya::LuaKey value = state.newKey(std::string("value"));
+	TEST_EQUAL(name, "name");
+	TEST_CHECK(kaguya::LuaKey().isNilref());
+
+	state("tbl = {name='foo',value=3}");
+	kaguya::LuaTable tbl = state["tbl"];
+	TEST_EQUAL(tbl.getField<std::string>(name), "foo");
+	TEST_EQUAL(tbl.getField(value), 3);
+	TEST_EQUAL(tbl[value], 3);
+
+	tbl.setField(name, "bar");
+	TEST_CHECK(state("assert(tbl.name == 'bar')"));
+	tbl[value] = 5;
+	TEST_CHECK(state("assert(tbl.value == 5)"));
+	state["tbl"][name] = "baz";
+	TEST_CHECK(state("assert(tbl.name == 'baz')"));
+
+	kaguya::LuaKey copied = value;
+	TEST_EQUAL(tbl.getField<int>(copied), 5);
+
+	int count = 0;
+	tbl.foreach_table<kaguya::LuaStackRef, kaguya::LuaStackRef>(CountKey(value, count));
+	TEST_EQUAL(count, 5);
+
+	state("meta = setmetatable({}, {__index=function(t,k) return k..'!' end})");
+	kaguya::LuaTable meta = state["meta"];
+	TEST_EQUAL(meta.getField<std::string>(name), "name!");
+}
+
+KAGUYA_TEST_FUNCTION_DEF(lua_table_raw_access)(kaguya::State& state)
+{
+	state("logged = 0 tbl = setmetatable({}, {__index=function(t,k) return 'meta' end, __newindex=function(t,k,v) logged = logged + 1 rawset(t,k,v) end})");
+	kaguya::LuaTable tbl = state["tbl"];
+	TEST_EQUAL(tbl.getField<std::string>("missing"), "meta");
+	TEST_CHECK(tbl.rawGet<kaguya::LuaRef>("missing").isNilref());
+
+	tbl.rawSet("key", 3);
+	tbl.rawSetIndex(1, "first");
+	TEST_CHECK(state("assert(logged == 0)"));
+	TEST_EQUAL(tbl.rawGet<int>("key"), 3);
+	TEST_EQUAL(tbl.rawGetIndex<std::string>(1), "first");
+	TEST_EQUAL(tbl.rawGetIndex<std::string>(2), "");
+
+	tbl.setField("other", 1);
+	TEST_CHECK(state("assert(logged == 1)"));
+}
+
+std::string raw_access_error_message;
+void raw_access_error(int status, const char* message)
+{
+	raw_access_error_message = message ? message : "";
+}
+KAGUYA_TEST_FUNCTION_DEF(lua_table_raw_access_error)(kaguya::State& state)
+{
+	raw_access_error_message = "";
+	state.setErrorHandler(raw_access_error);
+	state("notable = 1");
+	kaguya::LuaRef notable = state["notable"];
+	TEST_EQUAL(notable.rawGet<int>("key"), 0);
+	TEST_CHECK(raw_access_error_message.find("is not table") != std::string::npos);
+	raw_access_error_message = "";
+	notable.rawSetIndex(1, 2);
+	TEST_CHECK(raw_access_error_message.find("is not table") != std::string::npos);
+
+	{
+		kaguya::PinnedTable pinned(notable);
+		TEST_CHECK(!pinned.valid());
+		TEST_EQUAL(pinned.size(), 0u);
+	}
+}
+
+KAGUYA_TEST_FUNCTION_DEF(pinned_table)(kaguya::State& state)
+{
+	state("tbl = setmetatable({}, {__index=function(t,k) return 'meta' end})");
+	kaguya::LuaTable tbl = state["tbl"];
+	int top = lua_gettop(state.state());
+	{
+		kaguya::PinnedTable pinned(tbl);
+		TEST_CHECK(pinned.valid());
+		for (int i = 1; i <= 100; ++i)
+		{
+			pinned.rawSetIndex(i, i * 2);
+		}
+		pinned.rawSet("name", "pinned");
+		pinned.set("value", 5);
+		TEST_EQUAL(pinned.size(), 100u);
+		TEST_EQUAL(pinned.rawGetIndex<int>(50), 100);
+		TEST_EQUAL(pinned.rawGet<std::string>("name"), "pinned");
+		TEST_EQUAL(pinned.get<std::string>("missing"), "meta");
+		TEST_EQUAL(pinned.get<int>("value"), 5);
+		TEST_EQUAL(lua_gettop(state.state()), top + 1);
+	}
+	TEST_EQUAL(lua_gettop(state.state()), top);
+	TEST_CHECK(state("assert(#tbl == 100 and tbl[100] == 200 and tbl.name == 'pinned')"));
+}
+
 KAGUYA_TEST_GROUP_END(test_05_lua_ref)
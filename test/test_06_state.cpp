@@ -189,4 +189,147 @@ KAGUYA_TEST_FUNCTION_DEF(load_from_stream)(kaguya::State& state)
 	TEST_EQUAL(state["value"], true);
 }
 
+KAGUYA_TEST_FUNCTION_DEF(field_path)(kaguya::State& state)
+{
+	state("config = {limits={rate=10}}");
+	kaguya::FieldPath rate = state.fieldPath("config.limits.rate");
+	TEST_EQUAL(rate, 10);
+	TEST_EQUAL(rate.path(), "config.limits.rate");
+
+	state("config.limits.rate = 20");
+	TEST_EQUAL(rate, 20);
+
+	rate = 30;
+	TEST_CHECK(state("assert(config.limits.rate == 30)"));
+
+	state("config.limits = {rate=40}");
+	TEST_CHECK(rate.isStale());
+	TEST_EQUAL(rate, 40);//read resolves path again
+	rate = 50;
+	TEST_CHECK(state("assert(config.limits.rate == 50)"));
+	TEST_EQUAL(rate, 50);
+
+	state("config = {limits={rate=60}}");
+	TEST_EQUAL(rate.get<int>(), 60);
+	std::stringstream out;
+	out << rate;
+	TEST_EQUAL(out.str(), "60");
+
+	//cached value is stale until refresh
+	TEST_CHECK(rate.isStale());
+	TEST_EQUAL(rate.getCached<int>(), 30);
+	TEST_CHECK(rate.refresh());
+	TEST_CHECK(!rate.isStale());
+	TEST_EQUAL(rate.getCached<int>(), 60);
+
+	kaguya::FieldPath clock = state.fieldPath("os.clock");
+	TEST_CHECK(clock.type() == LUA_TFUNCTION);
+	double t = clock();
+	TEST_CHECK(t >= 0);
+
+	state("handlers = {f=function() return 1 end}");
+	kaguya::FieldPath handler = state.fieldPath("handlers.f");
+	TEST_EQUAL(handler.call<int>(), 1);
+	state("handlers = {f=function() return 2 end}");
+	TEST_EQUAL(handler.call<int>(), 2);//call resolves path again
+
+	kaguya::FieldPath global = state.fieldPath("global_value");
+	global = 5;
+	TEST_EQUAL(state["global_value"], 5);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(field_path_not_exists)(kaguya::State& state)
+{
+	kaguya::FieldPath value = state.fieldPath("later.value");
+	TEST_CHECK(value.isNilref());
+	TEST_CHECK(!value.refresh());
+
+	state("later = {value='created'}");
+	TEST_CHECK(value.isStale());
+	TEST_EQUAL(value, "created");//resolved at access
+	TEST_EQUAL(value.getCached<std::string>(), "created");//nil cache is resolved
+	TEST_CHECK(!value.isStale());
+}
+
+int limit_error_status = 0;
+void limit_error_handler(int status, const char* message)
+{
+	limit_error_status = status;
+}
+KAGUYA_TEST_FUNCTION_DEF(execution_limit)(kaguya::State& state)
+{
+	state.setErrorHandler(limit_error_handler);
+	kaguya::ExecutionLimit limit;
+	limit.setInstructions(100000);
+
+	TEST_CHECK(state.dostringWithLimit("local x = 0 for i=1,100 do x = x + i end", limit));
+	TEST_EQUAL(limit_error_status, 0);
+
+	TEST_CHECK(!state.dostringWithLimit("while true do end", limit));
+	TEST_EQUAL(limit_error_status, KAGUYA_ERRLIMIT);
+
+	//pcall in the script can not catch the limit
+	limit_error_status = 0;
+	TEST_CHECK(!state.dostringWithLimit("count = 0 while true do pcall(function() while true do end end) count = count + 1 end", limit));
+	TEST_EQUAL(limit_error_status, KAGUYA_ERRLIMIT);
+	TEST_EQUAL(state["count"], 0);
+
+	//hook is removed after the scope
+	limit_error_status = 0;
+	TEST_CHECK(state("local x = 0 for i=1,1000000 do x = x + i end"));
+	TEST_EQUAL(limit_error_status, 0);
+
+	state("function spin(n) local x = 0 for i=1,n do x = x + 1 end return x end");
+	kaguya::LuaFunction spin = state["spin"];
+	{
+		kaguya::ScopedExecutionLimit scope(state.state(), limit);
+		TEST_EQUAL(spin.call<int>(100), 100);
+		TEST_CHECK(!scope.exceeded());
+		spin.call<int>(1000000);
+		TEST_CHECK(scope.exceeded());
+		TEST_EQUAL(limit_error_status, KAGUYA_ERRLIMIT);
+	}
+	limit_error_status = 0;
+	TEST_EQUAL(spin.call<int>(1000000), 1000000);
+	TEST_EQUAL(limit_error_status, 0);
+
+#if KAGUYA_USE_CPP11
+	kaguya::ExecutionLimit timeout;
+	timeout.setTimeout(std::chrono::milliseconds(10));
+	TEST_CHECK(!state.dostringWithLimit("while true do end", timeout));
+	TEST_EQUAL(limit_error_status, KAGUYA_ERRLIMIT);
+#endif
+}
+
+#if KAGUYA_USE_CPP11
+KAGUYA_TEST_FUNCTION_DEF(gc_driver)(kaguya::State& state)
+{
+	kaguya::GCDriver driver(state.state(), 16);
+	driver.setAutomatic(false);
+	state("garbage = {} for i=1,100000 do garbage[i] = {i} end garbage = nil");
+	size_t used = driver.usedBytes();
+
+	size_t steps = 0;
+	while (!driver.step(std::chrono::microseconds(100)))
+	{
+		steps++;
+	}
+	TEST_CHECK(steps > 0);
+	TEST_CHECK(driver.usedBytes() < used);
+	TEST_EQUAL(driver.stats().cycles, 1u);
+	TEST_EQUAL(driver.cycles().size(), 1u);
+	TEST_EQUAL(driver.cycles().back().steps, steps + 1);
+	TEST_CHECK(driver.cycles().back().freedBytes > 0);
+	TEST_EQUAL(driver.stats().pauses, steps + 1);
+	TEST_CHECK(driver.pauses().size() <= 16u);
+	TEST_CHECK(driver.pausePercentile(0.5) <= driver.stats().maxPause);
+
+	driver.collect();
+	TEST_EQUAL(driver.stats().cycles, 2u);
+	TEST_EQUAL(driver.cycles().back().steps, 1u);
+	driver.setAutomatic(true);
+	TEST_CHECK(state.gc().isenabled());
+}
+#endif
+
 KAGUYA_TEST_GROUP_END(test_06_state)
@@ -146,6 +146,166 @@ KAGUYA_TEST_FUNCTION_DEF(null_unique_ptr)(kaguya::State& state)
 	TEST_CHECK(state("assert(test==nil)"));
 }
 
+struct CopyCountClass
+{
+	static int copy_count;
+	static int move_count;
+	CopyCountClass(int i = 0) :member(i) {}
+	CopyCountClass(const CopyCountClass& src) :member(src.member) { copy_count++; }
+	CopyCountClass(CopyCountClass&& src) :member(src.member) { move_count++; }
+	int member;
+};
+int CopyCountClass::copy_count = 0;
+int CopyCountClass::move_count = 0;
+
+CopyCountClass make_copy_count_class(int i)
+{
+	return CopyCountClass(i);
+}
+std::vector<CopyCountClass> make_copy_count_classes(int size)
+{
+	std::vector<CopyCountClass> result;
+	result.reserve(size);
+	for (int i = 0; i < size; ++i)
+	{
+		result.push_back(CopyCountClass(i));
+	}
+	return result;
+}
+std::map<std::string, CopyCountClass> make_copy_count_map()
+{
+	std::map<std::string, CopyCountClass> result;
+	result["a"].member = 1;
+	result["b"].member = 2;
+	return result;
+}
+
+KAGUYA_TEST_FUNCTION_DEF(return_value_without_copy)(kaguya::State& state)
+{
+	state["CopyCountClass"].setClass(kaguya::UserdataMetatable<CopyCountClass>()
+		.addProperty("member", &CopyCountClass::member)
+		);
+	state["make"] = &make_copy_count_class;
+	state["make_vector"] = &make_copy_count_classes;
+	state["make_map"] = &make_copy_count_map;
+
+	CopyCountClass::copy_count = 0;
+	CopyCountClass::move_count = 0;
+	TEST_CHECK(state("obj = make(3) assert(obj.member == 3)"));
+	TEST_EQUAL(CopyCountClass::copy_count, 0);
+#if __cplusplus >= 201703L
+	TEST_EQUAL(CopyCountClass::move_count, 0);
+#endif
+
+	CopyCountClass::move_count = 0;
+	TEST_CHECK(state("objs = make_vector(4) assert(#objs == 4 and objs[4].member == 3)"));
+	TEST_EQUAL(CopyCountClass::copy_count, 0);
+
+	TEST_CHECK(state("objs = make_map() assert(objs.a.member == 1 and objs.b.member == 2)"));
+	TEST_EQUAL(CopyCountClass::copy_count, 0);
+}
+
+kaguya::LuaCallback<int(int)> stored_callback;
+void store_callback(kaguya::LuaCallback<int(int)> callback)
+{
+	stored_callback = callback;
+}
+void callback_error_fun(int status, const char* message)
+{
+}
+KAGUYA_TEST_FUNCTION_DEF(lua_callback)(kaguya::State& state)
+{
+	state("function add(a, b) return a + b end\n"
+		"function multi(a) return a, a * 2, 'ignored' end\n"
+		"function nothing() end");
+	kaguya::LuaCallback<int(int, int)> add = state["add"];
+	TEST_CHECK(!add.isNilref());
+	TEST_EQUAL(add(1, 2), 3);
+
+	int top = lua_gettop(state.state());
+	kaguya::LuaCallback<std::tuple<int, int>(int)> multi = state["multi"];
+	TEST_CHECK(multi(3) == std::make_tuple(3, 6));
+	kaguya::LuaCallback<int()> nothing = state["nothing"];
+	TEST_EQUAL(nothing(), 0);
+	kaguya::LuaCallback<void()> void_callback = state["nothing"];
+	void_callback();
+	TEST_EQUAL(lua_gettop(state.state()), top);
+
+	//adapt to std::function
+	std::function<int(int, int)> fn = add;
+	TEST_EQUAL(fn(4, 5), 9);
+	std::function<int(int, int)> converted = state["add"].get<std::function<int(int, int)> >();
+	TEST_EQUAL(converted(6, 7), 13);
+
+	//from argument of native function, and call after return
+	state["store_callback"] = &store_callback;
+	TEST_CHECK(state("store_callback(function(v) return v * 10 end)"));
+	state("collectgarbage()");
+	TEST_EQUAL(stored_callback(3), 30);
+	state["pushed"] = stored_callback;
+	TEST_CHECK(state("assert(pushed(4) == 40)"));
+	stored_callback = kaguya::LuaCallback<int(int)>();
+
+	kaguya::LuaCallback<int(int)> not_function = state["undefined_function"];
+	TEST_CHECK(not_function.isNilref());
+
+	state.setErrorHandler(callback_error_fun);
+	state("function raise() error('callback error') end");
+	kaguya::LuaCallback<int()> raise = state["raise"];
+	TEST_EQUAL(raise(), 0);
+	TEST_EQUAL(lua_gettop(state.state()), top);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(lua_callback_each)(kaguya::State& state)
+{
+	state.setErrorHandler(callback_error_fun);
+	state("function score(a, b) if a < 0 then error('negative') end return a * b end\n"
+		"count = 0 function counter(v) count = count + v end");
+	kaguya::LuaCallback<int(int, int)> score = state["score"];
+	int top = lua_gettop(state.state());
+
+	std::vector<std::tuple<int, int> > args;
+	for (int i = 0; i < 100; ++i)
+	{
+		args.push_back(std::make_tuple(i, 2));
+	}
+	std::vector<int> results;
+	kaguya::BatchResult batch = score.callEach(args.begin(), args.end(), std::back_inserter(results));
+	TEST_CHECK(batch.succeeded());
+	TEST_EQUAL(batch.calls, 100u);
+	TEST_EQUAL(results.size(), 100u);
+	TEST_EQUAL(results[99], 198);
+	TEST_EQUAL(lua_gettop(state.state()), top);
+
+	//continue on error
+	args[10] = std::make_tuple(-1, 2);
+	args[20] = std::make_tuple(-1, 2);
+	results.clear();
+	batch = score.callEach(args.begin(), args.end(), std::back_inserter(results));
+	TEST_EQUAL(batch.calls, 100u);
+	TEST_EQUAL(batch.failed.size(), 2u);
+	TEST_EQUAL(batch.failed[0], 10u);
+	TEST_EQUAL(batch.failed[1], 20u);
+	TEST_EQUAL(results.size(), 100u);
+	TEST_EQUAL(results[10], 0);
+	TEST_EQUAL(results[11], 22);
+
+	//stop on error
+	results.clear();
+	batch = score.callEach(args.begin(), args.end(), std::back_inserter(results), kaguya::BATCH_STOP_ON_ERROR);
+	TEST_EQUAL(batch.calls, 11u);
+	TEST_EQUAL(batch.failed.size(), 1u);
+	TEST_EQUAL(results.size(), 10u);
+	TEST_EQUAL(lua_gettop(state.state()), top);
+
+	//single argument and no result
+	std::vector<int> values(10, 3);
+	kaguya::LuaCallback<void(int)> counter = state["counter"];
+	batch = counter.callEach(values.begin(), values.end(), std::back_inserter(results));
+	TEST_EQUAL(batch.calls, 10u);
+	TEST_EQUAL(state["count"], 30);
+}
+
 KAGUYA_TEST_GROUP_END(test_11_cxx11_feature)
 
 #endif
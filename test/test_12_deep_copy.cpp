@@ -0,0 +1,126 @@
+#include "kaguya/kaguya.hpp"
+#include "test_util.hpp"
+
+KAGUYA_TEST_GROUP_START(test_12_deep_copy)
+
+using namespace kaguya_test_util;
+
+KAGUYA_TEST_FUNCTION_DEF(copy_primitive)(kaguya::State& state)
+{
+	kaguya::State other;
+	TEST_EQUAL(other.deepCopy(state.newRef(3)), 3);
+	TEST_EQUAL(other.deepCopy(state.newRef(3.5)), 3.5);
+	TEST_EQUAL(other.deepCopy(state.newRef(true)), true);
+	TEST_EQUAL(other.deepCopy(state.newRef(std::string("a\0b", 3))), std::string("a\0b", 3));
+	TEST_CHECK(other.deepCopy(kaguya::LuaRef(state.state())).isNilref());
+
+	other["value"] = other.deepCopy(state.newRef(5));
+	TEST_CHECK(other("assert(math.type(value) == 'integer')"));
+	other["value"] = other.deepCopy(state.newRef(5.0));
+	TEST_CHECK(other("assert(math.type(value) == 'float')"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(copy_table)(kaguya::State& state)
+{
+	state("config = {1,2,3,name='foo',limits={rate=10,burst=2.5},[{}]='tablekey',flag=false}");
+
+	kaguya::State other;
+	other["config"] = other.deepCopy(state["config"]);
+	TEST_CHECK(other("assert(#config == 3 and config[3] == 3)"));
+	TEST_CHECK(other("assert(config.name == 'foo')"));
+	TEST_CHECK(other("assert(config.limits.rate == 10 and config.limits.burst == 2.5)"));
+	TEST_CHECK(other("assert(config.flag == false)"));
+	TEST_CHECK(other("for k,v in pairs(config) do if type(k) == 'table' then assert(v == 'tablekey') return end end error('no table key')"));
+
+	//not shared with source
+	state("config.limits.rate = 20");
+	TEST_CHECK(other("assert(config.limits.rate == 10)"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(copy_cycle_and_shared)(kaguya::State& state)
+{
+	state("shared = {v=1} root = {a=shared,b=shared} root.self = root");
+
+	kaguya::State other;
+	other["root"] = other.deepCopy(state["root"]);
+	TEST_CHECK(other("assert(root.self == root)"));
+	TEST_CHECK(other("assert(root.a == root.b and root.a.v == 1)"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(copy_same_state)(kaguya::State& state)
+{
+	state("src = {x={y=1}}");
+	state["dst"] = state.deepCopy(state["src"]);
+	TEST_CHECK(state("assert(dst ~= src and dst.x ~= src.x and dst.x.y == 1)"));
+}
+
+struct CopyableObject
+{
+	CopyableObject() :value(0) {}
+	int value;
+};
+
+KAGUYA_TEST_FUNCTION_DEF(copy_userdata)(kaguya::State& state)
+{
+	state["CopyableObject"].setClass(kaguya::UserdataMetatable<CopyableObject>()
+		.setConstructors<CopyableObject()>()
+		.addProperty("value", &CopyableObject::value)
+		.setCopyFunction()
+	);
+	kaguya::State other;
+	other["CopyableObject"].setClass(kaguya::UserdataMetatable<CopyableObject>()
+		.setConstructors<CopyableObject()>()
+		.addProperty("value", &CopyableObject::value)
+	);
+
+	state("obj = CopyableObject.new() obj.value = 4 tbl = {obj,obj}");
+	other["tbl"] = other.deepCopy(state["tbl"]);
+	TEST_CHECK(other("assert(tbl[1].value == 4 and tbl[1] == tbl[2])"));
+
+	CopyableObject* copied = other["tbl"][1];
+	CopyableObject* source = state["obj"];
+	TEST_CHECK(copied && source && copied != source);
+}
+
+int deep_copy_error_count = 0;
+void deep_copy_error(int status, const char* message)
+{
+	deep_copy_error_count++;
+}
+KAGUYA_TEST_FUNCTION_DEF(copy_not_copyable)(kaguya::State& state)
+{
+	kaguya::State other;
+	deep_copy_error_count = 0;
+	other.setErrorHandler(deep_copy_error);
+
+	state("tbl = {f=function() end,v=1}");
+	other["tbl"] = other.deepCopy(state["tbl"]);
+	TEST_EQUAL(deep_copy_error_count, 1);
+	TEST_CHECK(other("assert(tbl.f == nil and tbl.v == 1)"));
+
+	state("tbl = {print=print}");
+	other["tbl"] = other.deepCopy(state["tbl"]);
+	TEST_EQUAL(deep_copy_error_count, 1);
+	TEST_CHECK(other("assert(type(tbl.print) == 'function')"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(copy_nesting_depth)(kaguya::State& state)
+{
+	kaguya::State other;
+	state("function nested(n) local t = {} local c = t for i=1,n do c.n = {} c = c.n end return t end");
+
+	other["tbl"] = other.deepCopy(state["nested"](100));
+	TEST_CHECK(other("local c = tbl for i=1,100 do c = c.n end assert(next(c) == nil)"));
+
+	deep_copy_error_count = 0;
+	other.setErrorHandler(deep_copy_error);
+	TEST_CHECK(other.deepCopy(state["nested"](KAGUYA_TABLE_MAX_DEPTH)).isNilref());
+	TEST_EQUAL(deep_copy_error_count, 1);
+	//deeper than C stack
+	TEST_CHECK(other.deepCopy(state["nested"](300000)).isNilref());
+	state.setErrorHandler(deep_copy_error);
+	TEST_CHECK(state.deepCopy(state["nested"](300000)).isNilref());
+	TEST_EQUAL(deep_copy_error_count, 3);
+}
+
+KAGUYA_TEST_GROUP_END(test_12_deep_copy)
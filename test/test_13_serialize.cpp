@@ -0,0 +1,172 @@
+#include "kaguya/kaguya.hpp"
+#include "test_util.hpp"
+
+#include <sstream>
+
+KAGUYA_TEST_GROUP_START(test_13_serialize)
+
+using namespace kaguya_test_util;
+
+namespace
+{
+	std::string serialized(const kaguya::LuaRef& value)
+	{
+		std::ostringstream os;
+		kaguya::serialize(os, value);
+		return os.str();
+	}
+}
+
+KAGUYA_TEST_FUNCTION_DEF(serialize_primitive)(kaguya::State& state)
+{
+	TEST_EQUAL(state.deserialize(serialized(state.newRef(3))), 3);
+	TEST_EQUAL(state.deserialize(serialized(state.newRef(-123456789))), -123456789);
+	TEST_EQUAL(state.deserialize(serialized(state.newRef(3.5))), 3.5);
+	TEST_EQUAL(state.deserialize(serialized(state.newRef(false))), false);
+	TEST_EQUAL(state.deserialize(serialized(state.newRef(std::string("a\0b", 3)))), std::string("a\0b", 3));
+	TEST_CHECK(state.deserialize(serialized(kaguya::LuaRef(state.state()))).isNilref());
+
+	state["value"] = state.deserialize(serialized(state.newRef(5)));
+	TEST_CHECK(state("assert(math.type(value) == 'integer')"));
+	state["value"] = state.deserialize(serialized(state.newRef(5.0)));
+	TEST_CHECK(state("assert(math.type(value) == 'float')"));
+	state["value"] = state.deserialize(serialized(state["math"]["mininteger"]));
+	TEST_CHECK(state("assert(value == math.mininteger)"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(serialize_table)(kaguya::State& state)
+{
+	state("config = {1,2,nil,4,name='foo',limits={rate=10,burst=2.5},[{}]='tablekey',flag=false,[1.5]='float key'}");
+	std::string data = serialized(state["config"]);
+
+	kaguya::State other;
+	other["config"] = other.deserialize(data);
+	TEST_CHECK(other("assert(config[1] == 1 and config[2] == 2 and config[3] == nil and config[4] == 4)"));
+	TEST_CHECK(other("assert(config.name == 'foo' and config[1.5] == 'float key')"));
+	TEST_CHECK(other("assert(config.limits.rate == 10 and config.limits.burst == 2.5)"));
+	TEST_CHECK(other("assert(config.flag == false)"));
+	TEST_CHECK(other("for k,v in pairs(config) do if type(k) == 'table' then assert(v == 'tablekey') return end end error('no table key')"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(serialize_shared_reference)(kaguya::State& state)
+{
+	state("shared = {v=1} root = {a=shared,b=shared,s1='long repeated string',s2='long repeated string'} root.self = root");
+	std::string data = serialized(state["root"]);
+	//repeated string is written once
+	TEST_CHECK(data.find("long repeated string") == data.rfind("long repeated string"));
+
+	state["copied"] = state.deserialize(data);
+	TEST_CHECK(state("assert(copied ~= root and copied.self == copied)"));
+	TEST_CHECK(state("assert(copied.a == copied.b and copied.a ~= shared and copied.a.v == 1)"));
+	TEST_CHECK(state("assert(copied.s1 == copied.s2)"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(serialize_stack_value)(kaguya::State& state)
+{
+	state("function values() return {x=1},'second' end");
+	kaguya::LuaFunction values = state["values"];
+	lua_State* L = state.state();
+	int top = lua_gettop(L);
+	values.push(L);
+	lua_call(L, 0, 2);
+	std::ostringstream os;
+	TEST_CHECK(kaguya::serialize(os, kaguya::LuaStackRef(L, top + 2)));
+	lua_settop(L, top);
+	TEST_EQUAL(state.deserialize(os.str()), "second");
+}
+
+struct SerializableObject
+{
+	SerializableObject() :value(0) {}
+	int value;
+};
+bool serializeObject(lua_State* l, int index, std::ostream& os)
+{
+	const SerializableObject* object = kaguya::get_const_pointer(l, index, kaguya::types::typetag<SerializableObject>());
+	if (!object)
+	{
+		return false;
+	}
+	os << object->value;
+	return true;
+}
+bool deserializeObject(lua_State* l, const char* data, size_t size)
+{
+	SerializableObject object;
+	object.value = std::atoi(std::string(data, size).c_str());
+	return kaguya::lua_type_traits<SerializableObject>::push(l, object) == 1;
+}
+
+KAGUYA_TEST_FUNCTION_DEF(serialize_userdata)(kaguya::State& state)
+{
+	state["SerializableObject"].setClass(kaguya::UserdataMetatable<SerializableObject>()
+		.setConstructors<SerializableObject()>()
+		.addProperty("value", &SerializableObject::value)
+		.setSerializeFunction(&serializeObject, &deserializeObject)
+	);
+	kaguya::State other;
+	other["SerializableObject"].setClass(kaguya::UserdataMetatable<SerializableObject>()
+		.setConstructors<SerializableObject()>()
+		.addProperty("value", &SerializableObject::value)
+		.setSerializeFunction(&serializeObject, &deserializeObject)
+	);
+
+	state("obj = SerializableObject.new() obj.value = 42 tbl = {obj,obj}");
+	other["tbl"] = other.deserialize(serialized(state["tbl"]));
+	TEST_CHECK(other("assert(tbl[1].value == 42 and tbl[1] == tbl[2])"));
+}
+
+int serialize_error_count = 0;
+void serialize_error_handler(int status, const char* message)
+{
+	serialize_error_count++;
+}
+KAGUYA_TEST_FUNCTION_DEF(serialize_error)(kaguya::State& state)
+{
+	serialize_error_count = 0;
+	state.setErrorHandler(serialize_error_handler);
+
+	state("tbl = {f=function() end,v=1}");
+	std::ostringstream os;
+	TEST_CHECK(!kaguya::serialize(os, state["tbl"]));
+	TEST_EQUAL(serialize_error_count, 1);
+	state["tbl"] = state.deserialize(os.str());
+	TEST_CHECK(state("assert(tbl.f == nil and tbl.v == 1)"));
+
+	std::string data = serialized(state.newRef(std::string("text")));
+	TEST_CHECK(state.deserialize(data.substr(0, data.size() - 1)).isNilref());
+	TEST_EQUAL(serialize_error_count, 2);
+	TEST_CHECK(state.deserialize("return {}").isNilref());
+	TEST_EQUAL(serialize_error_count, 3);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(serialize_nesting_depth)(kaguya::State& state)
+{
+	serialize_error_count = 0;
+	state.setErrorHandler(serialize_error_handler);
+
+	state("function nested(depth) local t = {} for i = 1, depth - 1 do t = {t} end return t end");
+	kaguya::LuaRef shallow = state["nested"](100);
+	TEST_CHECK(!state.deserialize(serialized(shallow)).isNilref());
+	TEST_EQUAL(serialize_error_count, 0);
+
+	std::ostringstream os;
+	TEST_CHECK(!kaguya::serialize(os, state["nested"](KAGUYA_SERIALIZE_MAX_DEPTH + 1)));
+	TEST_EQUAL(serialize_error_count, 1);
+
+	//crafted data: 200000 nested tables of one array element
+	std::string data("KGYB\x01", 5);
+	for (int i = 0; i < 200000; ++i)
+	{
+		data += "\x07\x01";
+	}
+	data += '\0';
+	for (int i = 0; i < 200000; ++i)
+	{
+		data += '\0';
+	}
+	TEST_CHECK(state.deserialize(data).isNilref());
+	TEST_EQUAL(serialize_error_count, 2);
+}
+
+KAGUYA_TEST_GROUP_END(test_13_serialize)
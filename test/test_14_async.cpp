@@ -0,0 +1,134 @@
+#include "kaguya/kaguya.hpp"
+#include "test_util.hpp"
+
+#if KAGUYA_USE_CPP11
+#include <thread>
+#include <map>
+
+KAGUYA_TEST_GROUP_START(test_14_async)
+
+using namespace kaguya_test_util;
+
+//! stand-in timer source. fired by test loop on the same thread.
+struct TestTimerQueue
+{
+	TestTimerQueue() :now(0) {}
+	int now;
+	std::multimap<int, kaguya::AsyncPromise<int> > timers;
+
+	kaguya::AsyncResult<int> sleep(int ticks)
+	{
+		kaguya::AsyncPromise<int> promise;
+		timers.insert(std::make_pair(now + ticks, promise));
+		return promise.result();
+	}
+	void tick()
+	{
+		now++;
+		while (!timers.empty() && timers.begin()->first <= now)
+		{
+			timers.begin()->second.setValue(now);
+			timers.erase(timers.begin());
+		}
+	}
+};
+
+KAGUYA_TEST_FUNCTION_DEF(async_timer)(kaguya::State& state)
+{
+	kaguya::AsyncScheduler scheduler(state.state());
+	TestTimerQueue timer;
+	state["sleep"] = kaguya::function([&timer](int ticks) { return timer.sleep(ticks); });
+	state("finished = 0 function task(i) local t = sleep(i % 7 + 1) assert(t == i % 7 + 1) finished = finished + 1 end");
+
+	kaguya::LuaFunction task = state["task"];
+	for (int i = 0; i < 3000; ++i)
+	{
+		scheduler.spawn(task, i);
+	}
+	TEST_EQUAL(scheduler.waitingCount(), 3000u);
+	TEST_EQUAL(state["finished"], 0);
+
+	while (scheduler.waitingCount() > 0)
+	{
+		timer.tick();
+		scheduler.poll();
+	}
+	TEST_EQUAL(state["finished"], 3000);
+}
+
+kaguya::AsyncResult<std::string> read_on_worker(const std::string& name, std::vector<std::thread>* workers)
+{
+	kaguya::AsyncPromise<std::string> promise;
+	workers->push_back(std::thread([promise, name]() mutable {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		if (name.empty())
+		{
+			promise.setError("no name");
+		}
+		else
+		{
+			promise.setValue("data of " + name);
+		}
+	}));
+	return promise.result();
+}
+
+KAGUYA_TEST_FUNCTION_DEF(async_worker_thread)(kaguya::State& state)
+{
+	kaguya::AsyncScheduler scheduler(state.state());
+	std::vector<std::thread> workers;
+	state["read"] = kaguya::function([&workers](const std::string& name) { return read_on_worker(name, &workers); });
+	state("results = {}\n"
+		"function reader(name) local data, err = read(name) results[name] = data or err end");
+
+	kaguya::LuaFunction reader = state["reader"];
+	scheduler.spawn(reader, "a");
+	scheduler.spawn(reader, "b");
+	scheduler.spawn(reader, "");
+	scheduler.run();
+	for (size_t i = 0; i < workers.size(); ++i)
+	{
+		workers[i].join();
+	}
+	TEST_CHECK(state("assert(results.a == 'data of a' and results.b == 'data of b' and results[''] == 'no name')"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(async_ready_result)(kaguya::State& state)
+{
+	state["ready"] = kaguya::function([](int v) {
+		kaguya::AsyncPromise<int> promise;
+		promise.setValue(v * 2);
+		return promise.result();
+	});
+	//completed result is returned without suspend. scheduler and coroutine are not required.
+	TEST_CHECK(state("assert(ready(4) == 8)"));
+
+	kaguya::AsyncScheduler scheduler(state.state());
+	state("count = 0 function loop() for i=1,3 do count = count + 1 coroutine.yield() end end");
+	scheduler.spawn(state["loop"]);
+	TEST_EQUAL(state["count"], 1);
+	TEST_EQUAL(scheduler.run(), 3u);
+	TEST_EQUAL(state["count"], 3);
+}
+
+int async_error_count = 0;
+void async_error_handler(int status, const char* message)
+{
+	async_error_count++;
+}
+KAGUYA_TEST_FUNCTION_DEF(async_outside_coroutine)(kaguya::State& state)
+{
+	kaguya::AsyncScheduler scheduler(state.state());
+	kaguya::AsyncPromise<void> promise;
+	state["wait"] = kaguya::function([&promise]() { return promise.result(); });
+
+	async_error_count = 0;
+	state.setErrorHandler(async_error_handler);
+	TEST_CHECK(state("local v, err = wait() assert(v == nil and err)"));
+	TEST_EQUAL(async_error_count, 1);
+	TEST_EQUAL(scheduler.waitingCount(), 0u);
+}
+
+KAGUYA_TEST_GROUP_END(test_14_async)
+
+#endif
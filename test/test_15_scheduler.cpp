@@ -0,0 +1,99 @@
+#include "kaguya/kaguya.hpp"
+#include "test_util.hpp"
+
+#if KAGUYA_USE_CPP11
+
+KAGUYA_TEST_GROUP_START(test_15_scheduler)
+
+using namespace kaguya_test_util;
+
+KAGUYA_TEST_FUNCTION_DEF(time_slice_preempt)(kaguya::State& state)
+{
+	kaguya::TimeSliceScheduler scheduler(state.state(), 1000);
+	state("finished = {}\n"
+		"function spin(name, n) return function() local x = 0 for i=1,n do x = x + i end finished[#finished + 1] = name end end");
+
+	kaguya::LuaFunction spin = state["spin"];
+	kaguya::TimeSliceScheduler::ThreadPtr heavy = scheduler.spawn(spin.call<kaguya::LuaFunction>("heavy", 1000000));
+	kaguya::TimeSliceScheduler::ThreadPtr light1 = scheduler.spawn(spin.call<kaguya::LuaFunction>("light1", 100));
+	kaguya::TimeSliceScheduler::ThreadPtr light2 = scheduler.spawn(spin.call<kaguya::LuaFunction>("light2", 100));
+	TEST_EQUAL(scheduler.threadCount(), 3u);
+
+	//light scripts finish while heavy script is running
+	for (int i = 0; i < 6; ++i)
+	{
+		scheduler.step();
+	}
+	TEST_CHECK(light1->finished() && light2->finished());
+	TEST_CHECK(!heavy->finished());
+	TEST_CHECK(state("assert(#finished == 2 and finished[1] == 'light1' and finished[2] == 'light2')"));
+
+	scheduler.run();
+	TEST_CHECK(heavy->finished());
+	TEST_EQUAL(scheduler.threadCount(), 0u);
+	TEST_CHECK(heavy->preemptCount() > 100);
+	TEST_EQUAL(heavy->resumeCount(), heavy->preemptCount() + 1);
+	TEST_EQUAL(light1->preemptCount(), 0u);
+	TEST_CHECK(heavy->cpuTime() > light1->cpuTime());
+}
+
+KAGUYA_TEST_FUNCTION_DEF(time_slice_priority)(kaguya::State& state)
+{
+	kaguya::TimeSliceScheduler scheduler(state.state());
+	state("order = ''\n"
+		"function task(name) return function() for i=1,2 do order = order .. name coroutine.yield() end end end");
+
+	kaguya::LuaFunction task = state["task"];
+	scheduler.spawn(task.call<kaguya::LuaFunction>("l"), 0);
+	scheduler.spawn(task.call<kaguya::LuaFunction>("h"), 10);
+	scheduler.spawn(task.call<kaguya::LuaFunction>("m"), 5);
+	scheduler.spawn(task.call<kaguya::LuaFunction>("H"), 10);
+	TEST_EQUAL(scheduler.run(), 12u);
+	TEST_EQUAL(state["order"], "hHhHmmll");
+}
+
+int call_lua_from_cpp(kaguya::LuaFunction f)
+{
+	return f.call<int>();
+}
+KAGUYA_TEST_FUNCTION_DEF(time_slice_not_yieldable)(kaguya::State& state)
+{
+	kaguya::TimeSliceScheduler scheduler(state.state(), 100);
+	state["call_lua_from_cpp"] = &call_lua_from_cpp;
+	state("result = 0\n"
+		"function task()\n"
+		" local n = call_lua_from_cpp(function() local x = 0 for i=1,10000 do x = x + 1 end return x end)\n"
+		" local ok, m = pcall(function() local x = 0 for i=1,10000 do x = x + 1 end return x end)\n"
+		" local co = coroutine.wrap(function() for i=1,10000 do end coroutine.yield(1) return 2 end)\n"
+		" result = n + m + co() + co()\n"
+		"end");
+	kaguya::TimeSliceScheduler::ThreadPtr scheduled = scheduler.spawn(state["task"]);
+	scheduler.run();
+	TEST_CHECK(scheduled->finished());
+	TEST_EQUAL(state["result"], 20003);
+}
+
+void ignore_scheduler_error(int, const char*)
+{
+}
+KAGUYA_TEST_FUNCTION_DEF(time_slice_with_execution_limit)(kaguya::State& state)
+{
+	state.setErrorHandler(ignore_scheduler_error);
+	kaguya::TimeSliceScheduler scheduler(state.state(), 100);
+	state("function forever() while true do end end");
+	kaguya::ExecutionLimit limit;
+	limit.setInstructions(100000);
+	{
+		kaguya::ScopedExecutionLimit scope(state.state(), limit);
+		//coroutine inherits limit hook, and it is called from slice hook
+		kaguya::TimeSliceScheduler::ThreadPtr scheduled = scheduler.spawn(state["forever"]);
+		scheduler.run();
+		TEST_CHECK(scheduled->finished());
+		TEST_CHECK(scheduled->preemptCount() > 100);
+		TEST_CHECK(scope.exceeded());
+	}
+}
+
+KAGUYA_TEST_GROUP_END(test_15_scheduler)
+
+#endif
@@ -0,0 +1,198 @@
+#include "kaguya/kaguya.hpp"
+#include "test_util.hpp"
+
+#if KAGUYA_USE_CPP11
+#include <sstream>
+
+KAGUYA_TEST_GROUP_START(test_16_profiler)
+
+using namespace kaguya_test_util;
+
+int profiled_native(int n)
+{
+	return n * 2;
+}
+struct ProfiledClass
+{
+	int value()const { return 1; }
+};
+
+KAGUYA_TEST_FUNCTION_DEF(profiler_samples)(kaguya::State& state)
+{
+	state("function inner(n) local x = 0 for i=1,n do x = x + i end return x end\n"
+		"function outer(n) local r = inner(n) return r end");
+
+	kaguya::Profiler profiler(state.state(), 100);
+	profiler.start();
+	TEST_CHECK(profiler.running());
+	state("outer(100000)");
+	profiler.stop();
+
+	TEST_CHECK(profiler.sampleCount() > 100);
+	const kaguya::Profiler::SampleCounts& stacks = profiler.stackSamples();
+	size_t inner_samples = 0;
+	for (kaguya::Profiler::SampleCounts::const_iterator it = stacks.begin(); it != stacks.end(); ++it)
+	{
+		if (it->first.find("outer (") != std::string::npos && it->first.find(";inner (") != std::string::npos)
+		{
+			inner_samples += it->second;
+		}
+	}
+	TEST_CHECK(inner_samples > profiler.sampleCount() / 2);
+
+	std::stringstream collapsed;
+	profiler.writeCollapsed(collapsed);
+	std::string line;
+	TEST_CHECK(std::getline(collapsed, line));
+	TEST_CHECK(line.find(' ') != std::string::npos);
+
+	size_t line_samples = 0;
+	const kaguya::Profiler::SampleCounts& lines = profiler.lineSamples();
+	for (kaguya::Profiler::SampleCounts::const_iterator it = lines.begin(); it != lines.end(); ++it)
+	{
+		line_samples += it->second;
+	}
+	TEST_EQUAL(line_samples, profiler.sampleCount());
+
+	//not sampled after stop
+	size_t count = profiler.sampleCount();
+	state("outer(100000)");
+	TEST_EQUAL(profiler.sampleCount(), count);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(profiler_native_calls)(kaguya::State& state)
+{
+	state["profiled_native"] = &profiled_native;
+	state["profiled_overload"] = kaguya::overload(&profiled_native, [](std::string s) { return s; });
+	state["ProfiledClass"].setClass(kaguya::UserdataMetatable<ProfiledClass>()
+		.setConstructors<ProfiledClass()>()
+		.addFunction("value", &ProfiledClass::value));
+
+	kaguya::Profiler profiler(state.state());
+	state("profiled_native(1)");
+	TEST_CHECK(profiler.nativeCalls().empty());
+
+	profiler.start();
+	TEST_CHECK(state("for i=1,10 do profiled_native(i) end"));
+	TEST_CHECK(state("for i=1,3 do profiled_overload('a') end"));
+	TEST_CHECK(state("local obj = ProfiledClass.new() assert(obj:value() == 1)"));
+	profiler.stop();
+
+	const kaguya::Profiler::NativeCalls& calls = profiler.nativeCalls();
+	TEST_CHECK(calls.count("profiled_native") == 1);
+	TEST_EQUAL(calls.find("profiled_native")->second.calls, 10u);
+	TEST_CHECK(calls.count("profiled_overload") == 1);
+	TEST_EQUAL(calls.find("profiled_overload")->second.calls, 3u);
+	TEST_CHECK(calls.count("value") == 1);
+	TEST_CHECK(calls.find("profiled_native")->second.total >= calls.find("profiled_native")->second.max);
+
+	state("profiled_native(1)");
+	TEST_EQUAL(calls.find("profiled_native")->second.calls, 10u);
+}
+
+void ignore_profiler_error(int, const char*)
+{
+}
+KAGUYA_TEST_FUNCTION_DEF(profiler_with_execution_limit)(kaguya::State& state)
+{
+	state.setErrorHandler(ignore_profiler_error);
+	kaguya::ExecutionLimit limit;
+	limit.setInstructions(100000);
+	kaguya::Profiler profiler(state.state(), 100);
+	{
+		kaguya::ScopedExecutionLimit scope(state.state(), limit);
+		profiler.start();
+		//limit hook is called from sampling hook
+		TEST_CHECK(!state("while true do end"));
+		TEST_CHECK(scope.exceeded());
+		profiler.stop();
+		//limit hook is restored
+		TEST_CHECK(lua_gethook(state.state()) != 0);
+	}
+	TEST_CHECK(profiler.sampleCount() > 100);
+	TEST_CHECK(lua_gethook(state.state()) == 0);
+}
+
+void metrics_throw(int)
+{
+	throw std::runtime_error("metrics_throw");
+}
+void ignore_metrics_error(int, const char*)
+{
+}
+KAGUYA_TEST_FUNCTION_DEF(binding_metrics)(kaguya::State& state)
+{
+	state.setErrorHandler(ignore_metrics_error);
+	state["profiled_native"] = &profiled_native;
+	state["profiled_overload"] = kaguya::overload(&profiled_native, [](std::string s) { return s; });
+	state["metrics_throw"] = &metrics_throw;
+	state["ProfiledClass"].setClass(kaguya::UserdataMetatable<ProfiledClass>()
+		.setConstructors<ProfiledClass()>()
+		.addFunction("value", &ProfiledClass::value));
+
+	kaguya::BindingMetrics metrics(state.state());
+	metrics.enable();
+	TEST_CHECK(state("for i=1,100 do profiled_native(i) end"));
+	TEST_CHECK(!state("ProfiledClass.value('not object')"));
+	TEST_CHECK(state("profiled_overload(1) profiled_overload('a')"));
+	TEST_CHECK(!state("profiled_overload({})"));
+	TEST_CHECK(!state("metrics_throw(1)"));
+	TEST_CHECK(state("for i=1,5 do ProfiledClass.new() end"));
+	state["binding_stats"] = kaguya::function([&metrics]() { return metrics.toTable(); });
+	TEST_CHECK(state("local s = binding_stats().profiled_native assert(s.calls == 100 and s.type_mismatches == 0 and #s.histogram == 32)"));
+	metrics.disable();
+
+	const kaguya::BindingMetrics::Stats* native = metrics.find("profiled_native");
+	TEST_CHECK(native != 0);
+	TEST_EQUAL(native->calls, 100u);
+	TEST_EQUAL(native->typeMismatches, 0u);
+	TEST_EQUAL(native->overloadMisses, 0u);
+	size_t histogram_total = 0;
+	for (size_t i = 0; i < native->histogram.size(); ++i)
+	{
+		histogram_total += native->histogram[i];
+	}
+	TEST_EQUAL(histogram_total, 100u);
+	TEST_CHECK(native->percentile(0.5) <= native->percentile(0.99));
+	TEST_CHECK(native->percentile(0.99) <= native->maxTime);
+
+	const kaguya::BindingMetrics::Stats* overloaded = metrics.find("profiled_overload");
+	TEST_CHECK(overloaded != 0);
+	TEST_EQUAL(overloaded->calls, 3u);
+	TEST_EQUAL(overloaded->overloadMisses, 1u);
+
+	TEST_EQUAL(metrics.find("metrics_throw")->exceptions, 1u);
+	TEST_EQUAL(metrics.find("new")->calls, 5u);
+	TEST_EQUAL(metrics.find("value")->typeMismatches, 1u);
+
+	//not counted after disable
+	state("profiled_native(1)");
+	TEST_EQUAL(native->calls, 100u);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(binding_metrics_with_profiler)(kaguya::State& state)
+{
+	state["profiled_native"] = &profiled_native;
+
+	kaguya::Profiler profiler(state.state());
+	kaguya::BindingMetrics metrics(state.state());
+	profiler.start();
+	metrics.enable();
+	TEST_CHECK(state("for i=1,10 do profiled_native(i) end"));
+	//profiler keeps observing after metrics is disabled
+	metrics.disable();
+	TEST_CHECK(state("for i=1,5 do profiled_native(i) end"));
+	metrics.enable();
+	profiler.stop();
+	//metrics keeps observing after profiler is stopped
+	TEST_CHECK(state("for i=1,3 do profiled_native(i) end"));
+	metrics.disable();
+	TEST_CHECK(state("profiled_native(1)"));
+
+	TEST_EQUAL(profiler.nativeCalls().find("profiled_native")->second.calls, 15u);
+	TEST_EQUAL(metrics.find("profiled_native")->calls, 13u);
+}
+
+KAGUYA_TEST_GROUP_END(test_16_profiler)
+
+#endif
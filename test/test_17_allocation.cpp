@@ -0,0 +1,156 @@
+#define KAGUYA_DEFINE_COUNTING_OPERATOR_NEW
+#include "kaguya/kaguya.hpp"
+#include "test_util.hpp"
+
+#if KAGUYA_USE_CPP11
+#include <thread>
+#endif
+
+KAGUYA_TEST_GROUP_START(test_17_allocation)
+
+using namespace kaguya_test_util;
+
+int add(int a, int b)
+{
+	return a + b;
+}
+struct Counter
+{
+	Counter() :value(0) {}
+	void set(double v) { value = v; }
+	double get()const { return value; }
+	double value;
+};
+
+KAGUYA_TEST_FUNCTION_DEF(count_allocations)(kaguya::State&)
+{
+	kaguya::State state(kaguya::standard::shared_ptr<kaguya::CountingAllocator>(new kaguya::CountingAllocator()));
+	kaguya::ScopedAllocationCount scope;
+	TEST_CHECK(state("t = {} for i=1,100 do t[i] = {} end"));
+	TEST_CHECK(scope.count().lua >= 100);
+	TEST_CHECK(scope.count().luaBytes > 0);
+
+	scope.reset();
+	std::vector<int>* v = new std::vector<int>(100);
+	TEST_EQUAL(scope.count().cxx, 2u);
+	TEST_CHECK(scope.count().cxxBytes >= sizeof(int) * 100);
+	delete v;
+	TEST_EQUAL(scope.count().lua, 0u);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(no_allocation_call_native_function)(kaguya::State& state)
+{
+	state["add"] = &add;
+	state["Counter"].setClass(kaguya::UserdataMetatable<Counter>()
+		.setConstructors<Counter()>()
+		.addFunction("set", &Counter::set)
+		.addFunction("get", &Counter::get)
+	);
+	state("function call_add(n) local r = 0 for i=1,n do r = add(r, 1) end return r end\n"
+		"counter = Counter.new()\n"
+		"function call_member(n) for i=1,n do counter:set(i) if counter:get() ~= i then error('') end end end");
+	kaguya::LuaFunction call_add = state["call_add"];
+	kaguya::LuaFunction call_member = state["call_member"];
+	call_add(1);//first call initializes metatable names
+	call_member(1);
+
+	kaguya::ScopedAllocationCount scope;
+	int r = call_add.call<int>(1000);
+	call_member.call<void>(1000);
+	TEST_EQUAL(scope.count().cxx, 0u);
+	TEST_EQUAL(r, 1000);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(no_allocation_property_read)(kaguya::State& state)
+{
+	state["Counter"].setClass(kaguya::UserdataMetatable<Counter>()
+		.setConstructors<Counter()>()
+		.addProperty("value", &Counter::value)
+	);
+	state("counter = Counter.new()\n"
+		"function read_property(n) local r = 0 for i=1,n do r = r + counter.value end return r end");
+	kaguya::LuaFunction read_property = state["read_property"];
+	Counter* counter = state["counter"];
+	counter->value = 2;
+	read_property(1);
+
+	kaguya::ScopedAllocationCount scope;
+	double r = read_property.call<double>(1000);
+	TEST_EQUAL(scope.count().cxx, 0u);
+	TEST_EQUAL(r, 2000);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(no_allocation_call_lua_function)(kaguya::State& state)
+{
+	state("function mul(a, b) return a * b end");
+	kaguya::LuaFunction mul = state["mul"];
+	mul(1, 2);
+
+	kaguya::ScopedAllocationCount scope;
+	double sum = 0;
+	for (int i = 0; i < 1000; ++i)
+	{
+		sum += mul.call<double>(i, 0.5);
+		int r = mul(i, 2);
+		sum += r;
+	}
+	TEST_EQUAL(scope.count().cxx, 0u);
+	TEST_EQUAL(sum, 999 * 1000 / 2 * 2.5);
+}
+
+double log_values[20];
+size_t log_count = 0;
+void log_variadic(const char* format, kaguya::VariadicArgView<double> args)
+{
+	log_count = args.copy(log_values, 20);
+}
+KAGUYA_TEST_FUNCTION_DEF(no_allocation_variadic_arg_view)(kaguya::State& state)
+{
+	state["log"] = &log_variadic;
+	state("function call_log(n) for i=1,n do log('%f', i, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20) end end");
+	kaguya::LuaFunction call_log = state["call_log"];
+	call_log(1);
+
+	kaguya::ScopedAllocationCount scope;
+	call_log.call<void>(100);
+	TEST_EQUAL(scope.count().cxx, 0u);
+	TEST_EQUAL(log_count, 20u);
+	TEST_EQUAL(log_values[0], 100);
+	TEST_EQUAL(log_values[19], 20);
+}
+
+#if KAGUYA_USE_CPP11
+KAGUYA_TEST_FUNCTION_DEF(binding_metrics_allocations)(kaguya::State& state)
+{
+	state["add"] = &add;
+	state["make_vector"] = kaguya::function([](int n) { return std::vector<int>(n); });
+	state("add(1, 2) make_vector(1)");
+
+	kaguya::BindingMetrics metrics(state.state());
+	metrics.enable();
+	TEST_CHECK(state("for i=1,10 do add(i, 1) make_vector(i) end"));
+	metrics.disable();
+	TEST_EQUAL(metrics.find("add")->cxxAllocations, 0u);
+	TEST_EQUAL(metrics.find("make_vector")->cxxAllocations, 10u);
+}
+
+void allocate_many()
+{
+	for (int i = 0; i < 10000; ++i)
+	{
+		delete new int(i);
+	}
+}
+KAGUYA_TEST_FUNCTION_DEF(count_allocations_from_threads)(kaguya::State&)
+{
+	kaguya::ScopedAllocationCount scope;
+	std::thread worker1(&allocate_many);
+	std::thread worker2(&allocate_many);
+	worker1.join();
+	worker2.join();
+	TEST_CHECK(scope.count().cxx >= 20000u);
+	TEST_CHECK(scope.count().cxxBytes >= 20000u * sizeof(int));
+}
+#endif
+
+KAGUYA_TEST_GROUP_END(test_17_allocation)